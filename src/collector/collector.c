@@ -48,6 +48,7 @@
 #include <unistd.h>
 
 #include "bookkeeper.h"
+#include "catalog.h"
 #include "conf/nfconf.h"
 #include "flist.h"
 #include "launch.h"
@@ -423,12 +424,18 @@ int RotateFlowFiles(time_t t_start, char *time_extension, FlowSource_t *fs, int
             // Update books
             stat(nfcapd_filename, &fstat);
             UpdateBooks(fs->bookkeeper, t_start, 512 * fstat.st_blocks);
+            // add file to the directory catalog
+            UpdateCatalog(nfcapd_filename);
         }
 
         // log stats
         LogInfo("Ident: '%s' Flows: %llu, Packets: %llu, Bytes: %llu, Sequence Errors: %u, Bad Packets: %u, Blocks: %u", fs->Ident,
                 (unsigned long long)nffile->stat_record->numflows, (unsigned long long)nffile->stat_record->numpackets,
                 (unsigned long long)nffile->stat_record->numbytes, nffile->stat_record->sequence_failure, fs->bad_packets, ReportBlocks());
+        blockPoolStat_t blockPoolStat;
+        ReportBlockPool(&blockPoolStat);
+        LogVerbose("Ident: '%s' Block pool: in use: %u, high water: %u, pooled: %u, hits: %llu, misses: %llu", fs->Ident, blockPoolStat.inUse,
+                   blockPoolStat.highWater, blockPoolStat.pooled, (unsigned long long)blockPoolStat.hits, (unsigned long long)blockPoolStat.misses);
 
         // reset stats
         fs->bad_packets = 0;
@@ -47,6 +47,7 @@
 #include "ja3/ja3.h"
 #include "ja4/ja4.h"
 #include "maxmind/maxmind.h"
+#include "nffile.h"
 #include "sgregex.h"
 #include "tor/tor.h"
 #include "util.h"
@@ -87,6 +88,7 @@ typedef struct filterElement {
 
 typedef struct FilterEngine_s {
     filterElement_t *filter;
+    uint32_t numElements;
     uint32_t StartNode;
     uint16_t Extended;
     int hasGeoDB;
@@ -838,6 +840,313 @@ static int RunExtendedFilter(const FilterEngine_t *engine, recordHandle_t *handl
     return invert ? !evaluate : evaluate;
 }  // End of RunFilter
 
+/*
+ * Block filter
+ * The filter tree is evaluated against the zone map of a data block. For each
+ * filter element, the zone map tells, if any record of the block may evaluate the
+ * element true and/or false. If no possible path through the filter tree ends in
+ * a match, no record of the block can match the filter.
+ * The Bloom filter of a block further tells, if an IP address may be in the block.
+ */
+
+// evaluate a filter element for a single value. Returns -1 if not supported
+static int TestValue(const filterElement_t *element, uint64_t inVal) {
+    uint64_t value = element->value;
+    switch (element->comp) {
+        case CMP_EQ:
+            return inVal == value;
+        case CMP_GT:
+            return inVal > value;
+        case CMP_LT:
+            return inVal < value;
+        case CMP_GE:
+            return inVal >= value;
+        case CMP_LE:
+            return inVal <= value;
+        case CMP_FLAGS:
+            return (inVal & value) == value;
+        case CMP_NET:
+            return (inVal & element->data.dataVal) == value;
+        case CMP_U64LIST: {
+            struct U64ListNode find = {.value = inVal};
+            return RB_FIND(U64tree, element->data.dataPtr, &find) != NULL;
+        }
+        default:
+            return -1;
+    }
+
+    // not reached
+}  // End of TestValue
+
+// evaluate a filter element for all values in the range min..max
+static void TestRange(const filterElement_t *element, uint64_t min, uint64_t max, uint64_t fieldMax, int allHave, int *canTrue, int *canFalse) {
+    uint64_t value = element->value;
+    uint64_t lo = 0;
+    uint64_t hi = fieldMax;
+    int exact = 1;
+    switch (element->comp) {
+        case CMP_EQ:
+            lo = hi = value;
+            break;
+        case CMP_GT:
+            if (value >= fieldMax) {
+                *canTrue = 0;
+                return;
+            }
+            lo = value + 1;
+            break;
+        case CMP_LT:
+            if (value == 0) {
+                *canTrue = 0;
+                return;
+            }
+            hi = value - 1;
+            break;
+        case CMP_GE:
+            lo = value;
+            break;
+        case CMP_LE:
+            hi = value;
+            break;
+        case CMP_NET: {
+            uint64_t mask = element->data.dataVal & fieldMax;
+            if (value & ~mask) {
+                // value outside mask never matches
+                *canTrue = 0;
+                return;
+            }
+            // non contiguous masks match a subset of lo..hi
+            uint64_t hostMask = ~mask & fieldMax;
+            exact = (hostMask & (hostMask + 1)) == 0;
+            lo = value;
+            hi = value | hostMask;
+        } break;
+        case CMP_U64LIST: {
+            struct U64ListNode *node;
+            *canTrue = 0;
+            RB_FOREACH(node, U64tree, element->data.dataPtr) {
+                if (node->value >= min && node->value <= max) {
+                    *canTrue = 1;
+                    break;
+                }
+            }
+            return;
+        }
+        default:
+            return;
+    }
+
+    *canTrue = hi >= min && lo <= max;
+    *canFalse = !allHave || !exact || min < lo || max > hi;
+
+}  // End of TestRange
+
+// test all addresses of an IP list against a Bloom filter. Returns 1, if any address may be in the block
+static int BloomTestList(const bloomFilter_t *bloomFilter, IPlist_t *IPlist) {
+    struct IPListNode *node;
+    RB_FOREACH(node, IPtree, IPlist) {
+        // networks can not be tested
+        if (node->mask[0] != 0xffffffffffffffffLL || node->mask[1] != 0xffffffffffffffffLL) return 1;
+    }
+    RB_FOREACH(node, IPtree, IPlist) {
+        if (BloomTest(bloomFilter, node->ip[0], node->ip[1])) return 1;
+    }
+    return 0;
+
+}  // End of BloomTestList
+
+// evaluate an IP filter element against the Bloom filter of a block
+static void BloomElement(const filterElement_t *element, const bloomFilter_t *bloomFilter, int *canTrue) {
+    if (element->function != NULL) return;
+
+    uint32_t offset = element->offset;
+    switch (element->extID) {
+        case EXipv4FlowID:
+            if ((offset != OFFsrc4Addr && offset != OFFdst4Addr) || element->length != SIZEsrc4Addr) return;
+            if (element->comp == CMP_EQ) {
+                *canTrue &= BloomTest(bloomFilter, 0, element->value);
+            } else if (element->comp == CMP_IPLIST) {
+                *canTrue &= BloomTestList(bloomFilter, element->data.dataPtr);
+            }
+            break;
+        case EXipv6FlowID:
+            if ((offset == OFFsrc6Addr || offset == OFFdst6Addr) && element->length == SIZEsrc6Addr && element->comp == CMP_IPLIST)
+                *canTrue &= BloomTestList(bloomFilter, element->data.dataPtr);
+            break;
+    }
+
+}  // End of BloomElement
+
+// IPv6 addresses are compared in two 64bit halfs. Returns the index of the lower half element,
+// if element is the upper half of an IPv6 address, which is not in the Bloom filter
+static uint32_t BloomIPv6(const FilterEngine_t *engine, const filterElement_t *element, const bloomFilter_t *bloomFilter) {
+    if (element->extID != EXipv6FlowID || element->function != NULL || element->comp != CMP_EQ || element->length != sizeof(uint64_t)) return 0;
+    if (element->offset != OFFsrc6Addr && element->offset != OFFdst6Addr) return 0;
+
+    uint32_t index = element->OnTrue;
+    if (index == 0) return 0;
+    const filterElement_t *lower = &engine->filter[index];
+    if (lower->extID != EXipv6FlowID || lower->function != NULL || lower->comp != CMP_EQ || lower->length != sizeof(uint64_t) ||
+        lower->offset != (element->offset + sizeof(uint64_t)))
+        return 0;
+
+    return BloomTest(bloomFilter, element->value, lower->value) ? 0 : index;
+
+}  // End of BloomIPv6
+
+// evaluate a filter element against a zone map
+static void ZoneTest(const filterElement_t *element, const zoneMap_t *zoneMap, int *canTrue, int *canFalse) {
+    *canTrue = *canFalse = 1;
+    if (element->function != NULL || zoneMap == NULL) return;
+
+    uint32_t count = 0;
+    switch (element->extID) {
+        case EXheader:
+            count = zoneMap->numRecords;
+            break;
+        case EXgenericFlowID:
+            count = zoneMap->numFlows;
+            break;
+        case EXipv4FlowID:
+            count = zoneMap->numIPv4;
+            break;
+        case EXipv6FlowID:
+            count = zoneMap->numIPv6;
+            break;
+        default:
+            return;
+    }
+
+    // records without the extension evaluate false
+    if (count == 0) {
+        *canTrue = 0;
+        return;
+    }
+    int allHave = count == zoneMap->numRecords;
+
+    uint32_t offset = element->offset;
+    uint32_t length = element->length;
+    if (length == 0) {
+        // no data compared - value is always 0
+        int result = TestValue(element, 0);
+        if (result < 0) return;
+        *canTrue = result;
+        *canFalse = !allHave || !result;
+        return;
+    }
+
+    switch (element->extID) {
+        case EXheader:
+            if (offset == OFFexporterID && length == SIZEexporterID)
+                TestRange(element, zoneMap->minExporterID, zoneMap->maxExporterID, 0xFFFF, allHave, canTrue, canFalse);
+            break;
+        case EXgenericFlowID:
+            if (offset == OFFproto && length == SIZEproto) {
+                int anyTrue = 0;
+                int anyFalse = !allHave;
+                for (int proto = 0; proto < 256; proto++) {
+                    if ((zoneMap->protoMap[proto >> 6] & (1LL << (proto & 0x3F))) == 0) continue;
+                    int result = TestValue(element, proto);
+                    if (result < 0) return;
+                    if (result)
+                        anyTrue = 1;
+                    else
+                        anyFalse = 1;
+                }
+                *canTrue = anyTrue;
+                *canFalse = anyFalse;
+            } else if (offset == OFFsrcPort && length == SIZEsrcPort) {
+                TestRange(element, zoneMap->minSrcPort, zoneMap->maxSrcPort, 0xFFFF, allHave, canTrue, canFalse);
+            } else if (offset == OFFdstPort && length == SIZEdstPort) {
+                TestRange(element, zoneMap->minDstPort, zoneMap->maxDstPort, 0xFFFF, allHave, canTrue, canFalse);
+            }
+            break;
+        case EXipv4FlowID:
+            if (offset == OFFsrc4Addr && length == SIZEsrc4Addr) {
+                TestRange(element, zoneMap->minSrc4Addr, zoneMap->maxSrc4Addr, 0xFFFFFFFF, allHave, canTrue, canFalse);
+            } else if (offset == OFFdst4Addr && length == SIZEdst4Addr) {
+                TestRange(element, zoneMap->minDst4Addr, zoneMap->maxDst4Addr, 0xFFFFFFFF, allHave, canTrue, canFalse);
+            }
+            break;
+        case EXipv6FlowID: {
+            // IPv6 addresses are compared in two 64bit halfs
+            // the lower half is only limited, if all upper halfs are equal
+            const uint64_t *minAddr = NULL;
+            const uint64_t *maxAddr = NULL;
+            if (offset == OFFsrc6Addr || offset == (OFFsrc6Addr + sizeof(uint64_t))) {
+                minAddr = zoneMap->minSrc6Addr;
+                maxAddr = zoneMap->maxSrc6Addr;
+            } else if (offset == OFFdst6Addr || offset == (OFFdst6Addr + sizeof(uint64_t))) {
+                minAddr = zoneMap->minDst6Addr;
+                maxAddr = zoneMap->maxDst6Addr;
+            }
+            if (minAddr == NULL || length != sizeof(uint64_t)) break;
+            if (offset == OFFsrc6Addr || offset == OFFdst6Addr) {
+                TestRange(element, minAddr[0], maxAddr[0], 0xFFFFFFFFFFFFFFFFLL, allHave, canTrue, canFalse);
+            } else if (minAddr[0] == maxAddr[0]) {
+                TestRange(element, minAddr[1], maxAddr[1], 0xFFFFFFFFFFFFFFFFLL, allHave, canTrue, canFalse);
+            } else {
+                TestRange(element, 0, 0xFFFFFFFFFFFFFFFFLL, 0xFFFFFFFFFFFFFFFFLL, allHave, canTrue, canFalse);
+            }
+        } break;
+    }
+
+}  // End of ZoneTest
+
+// returns 1, if any record may reach a match from node index
+static int BlockMatch(const FilterEngine_t *engine, const zoneMap_t *zoneMap, const bloomFilter_t *bloomFilter, uint32_t index,
+                      uint8_t *visited) {
+    // visited: 0 - not yet evaluated, 1 - no match, 2 - may match
+    if (visited[index]) return visited[index] - 1;
+
+    const filterElement_t *element = &engine->filter[index];
+    int canTrue, canFalse;
+    ZoneTest(element, zoneMap, &canTrue, &canFalse);
+
+    uint32_t lower = 0;
+    if (bloomFilter) {
+        BloomElement(element, bloomFilter, &canTrue);
+        lower = BloomIPv6(engine, element, bloomFilter);
+    }
+
+    // the result of the last element in the path is the filter result
+    int match = 0;
+    if (canTrue) {
+        if (lower) {
+            // the address is not in the block - the lower half element evaluates false
+            const filterElement_t *lowerElement = &engine->filter[lower];
+            match = lowerElement->OnFalse ? BlockMatch(engine, zoneMap, bloomFilter, lowerElement->OnFalse, visited) : lowerElement->invert;
+        } else {
+            match = element->OnTrue ? BlockMatch(engine, zoneMap, bloomFilter, element->OnTrue, visited) : !element->invert;
+        }
+    }
+    if (!match && canFalse) match = element->OnFalse ? BlockMatch(engine, zoneMap, bloomFilter, element->OnFalse, visited) : element->invert;
+
+    visited[index] = match + 1;
+    return match;
+
+}  // End of BlockMatch
+
+// check a data block by its zone map and Bloom filter. Either may be NULL.
+// Returns 0, if no record can match the filter
+int FilterBlock(const void *engine, const zoneMap_t *zoneMap, const bloomFilter_t *bloomFilter) {
+    const FilterEngine_t *filterEngine = (const FilterEngine_t *)engine;
+
+    if (filterEngine->StartNode == 0) return 0;
+    if (zoneMap && zoneMap->numRecords == 0) return 0;
+
+    uint8_t *visited = calloc(filterEngine->numElements, sizeof(uint8_t));
+    if (!visited) {
+        LogError("calloc() error in %s line %d: %s", __FILE__, __LINE__, strerror(errno));
+        return 1;
+    }
+    int match = BlockMatch(filterEngine, zoneMap, bloomFilter, filterEngine->StartNode, visited);
+    free(visited);
+
+    return match;
+
+}  // End of FilterBlock
+
 char *ReadFilter(char *filename) {
     struct stat stat_buff;
     if (stat(filename, &stat_buff)) {
@@ -886,6 +1195,7 @@ void *CompileFilter(char *FilterSyntax) {
     *engine = (FilterEngine_t){
         .label = NULL,
         .StartNode = StartNode,
+        .numElements = NumBlocks,
         .Extended = Extended,
         .filter = FilterTree,
         .hasGeoDB = 0,
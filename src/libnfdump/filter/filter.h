@@ -35,6 +35,7 @@
 #include <stdio.h>
 
 #include "nfdump.h"
+#include "nffileV2.h"
 #include "nfxV3.h"
 #include "rbtree.h"
 
@@ -171,6 +172,8 @@ void FilterSetParam(void *engine, const char *ident, const int hasGeoDB);
 
 int FilterRecord(const void *engine, recordHandle_t *handle);
 
+int FilterBlock(const void *engine, const zoneMap_t *zoneMap, const bloomFilter_t *bloomFilter);
+
 void DumpEngine(void *arg);
 
 void lex_init(char *buf);
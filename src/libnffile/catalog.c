@@ -0,0 +1,392 @@
+/*
+ *  Copyright (c) 2025, Peter Haag
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *   * Neither the name of the author nor the names of its contributors may be
+ *     used to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "catalog.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/param.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "nfdump.h"
+#include "nffile.h"
+#include "util.h"
+
+// catalog of the last directory looked up. Files are mostly processed directory by directory
+typedef struct catalogCache_s {
+    char dirName[MAXPATHLEN];  // directory of the cached catalog
+    ino_t inode;               // inode, size and mtime of the catalog file at load
+    off_t size;
+    time_t mtime;
+    catalogEntry_t *entries;  // all entries of the catalog
+    uint32_t numEntries;
+    uint32_t *hashTable;  // index + 1 of the last entry of a file name. 0: empty slot
+    uint32_t hashMask;
+} catalogCache_t;
+
+static catalogCache_t catalogCache = {0};
+static pthread_mutex_t catalogLock = PTHREAD_MUTEX_INITIALIZER;
+
+// FNV-1a hash of a file name
+static uint32_t NameHash(const char *name) {
+    uint32_t hash = 2166136261U;
+    while (*name) {
+        hash ^= (uint8_t)*name++;
+        hash *= 16777619U;
+    }
+    return hash;
+
+}  // End of NameHash
+
+// returns the slot of name in hashTable or the empty slot to insert it
+static uint32_t HashSlot(catalogEntry_t *entries, uint32_t *hashTable, uint32_t mask, char *name) {
+    uint32_t slot = NameHash(name) & mask;
+    while (hashTable[slot] && strcmp(entries[hashTable[slot] - 1].fileName, name) != 0) slot = (slot + 1) & mask;
+    return slot;
+
+}  // End of HashSlot
+
+// build the name hash of all entries. Later entries replace earlier entries of the same file
+// Returns the hash table or NULL on error
+static uint32_t *BuildHash(catalogEntry_t *entries, uint32_t numEntries, uint32_t *mask) {
+    uint32_t hashSize = 16;
+    while (hashSize < (2 * numEntries)) hashSize <<= 1;
+    uint32_t *hashTable = calloc(hashSize, sizeof(uint32_t));
+    if (!hashTable) {
+        LogError("calloc() error in %s line %d: %s", __FILE__, __LINE__, strerror(errno));
+        return NULL;
+    }
+
+    *mask = hashSize - 1;
+    for (uint32_t i = 0; i < numEntries; i++) {
+        hashTable[HashSlot(entries, hashTable, *mask, entries[i].fileName)] = i + 1;
+    }
+    return hashTable;
+
+}  // End of BuildHash
+
+// open and exclusively lock the catalog catalogName. The lock serializes appending
+// and compacting the catalog of several processes. Returns the fd or -1 on error
+static int LockCatalog(char *catalogName, int flags) {
+    for (;;) {
+        int fd = open(catalogName, flags, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+        if (fd < 0) {
+            if (errno != ENOENT) LogError("open() catalog %s failed: %s", catalogName, strerror(errno));
+            return -1;
+        }
+        if (flock(fd, LOCK_EX) < 0) {
+            LogError("flock() catalog %s failed: %s", catalogName, strerror(errno));
+            close(fd);
+            return -1;
+        }
+
+        // the catalog may have been replaced by a compact, while waiting for the lock
+        struct stat fdStat, nameStat;
+        if (fstat(fd, &fdStat) == 0 && stat(catalogName, &nameStat) == 0 && fdStat.st_ino == nameStat.st_ino && fdStat.st_dev == nameStat.st_dev)
+            return fd;
+        close(fd);
+    }
+
+}  // End of LockCatalog
+
+// split fileName into directory and file name. Returns the file name
+static char *SplitPath(char *fileName, char *dirName) {
+    char *name = strrchr(fileName, '/');
+    if (name) {
+        size_t len = name - fileName;
+        if (len == 0) len = 1;  // file in root dir
+        if (len >= MAXPATHLEN) len = MAXPATHLEN - 1;
+        memcpy(dirName, fileName, len);
+        dirName[len] = '\0';
+        name++;
+    } else {
+        strcpy(dirName, ".");
+        name = fileName;
+    }
+    return name;
+
+}  // End of SplitPath
+
+// read all entries of the catalog in dirName. Returns the number of entries
+// read or 0, if no valid catalog exists
+static uint32_t ReadCatalog(char *dirName, struct stat *catalogStat, catalogEntry_t **entries) {
+    char catalogName[MAXPATHLEN];
+    snprintf(catalogName, MAXPATHLEN, "%s/%s", dirName, CATALOGFILE);
+
+    *entries = NULL;
+    int fd = open(catalogName, O_RDONLY);
+    if (fd < 0) return 0;
+
+    catalogHeader_t catalogHeader;
+    if (fstat(fd, catalogStat) < 0 || read(fd, (void *)&catalogHeader, sizeof(catalogHeader_t)) != sizeof(catalogHeader_t) ||
+        catalogHeader.magic != CATALOGMAGIC || catalogHeader.version != CATALOGVERSION || catalogHeader.entrySize != sizeof(catalogEntry_t)) {
+        close(fd);
+        return 0;
+    }
+
+    // a partially appended entry at the end is ignored
+    uint32_t numEntries = (catalogStat->st_size - sizeof(catalogHeader_t)) / sizeof(catalogEntry_t);
+    if (numEntries == 0) {
+        close(fd);
+        return 0;
+    }
+
+    size_t size = numEntries * sizeof(catalogEntry_t);
+    *entries = malloc(size);
+    if (!*entries) {
+        LogError("malloc() error in %s line %d: %s", __FILE__, __LINE__, strerror(errno));
+        close(fd);
+        return 0;
+    }
+
+    ssize_t ret = read(fd, (void *)*entries, size);
+    close(fd);
+    if (ret < 0 || (size_t)ret < sizeof(catalogEntry_t)) {
+        free(*entries);
+        *entries = NULL;
+        return 0;
+    }
+    numEntries = ret / sizeof(catalogEntry_t);
+    for (uint32_t i = 0; i < numEntries; i++) (*entries)[i].fileName[CATALOGNAMELEN - 1] = '\0';
+
+    return numEntries;
+
+}  // End of ReadCatalog
+
+// (re)load the catalog of dirName into the cache, if not yet done or changed
+// Called with catalogLock held. Returns 0, if no catalog is available
+static int LoadCatalog(char *dirName) {
+    char catalogName[MAXPATHLEN];
+    snprintf(catalogName, MAXPATHLEN, "%s/%s", dirName, CATALOGFILE);
+
+    struct stat catalogStat;
+    if (stat(catalogName, &catalogStat) < 0) catalogStat.st_ino = 0;
+
+    if (strcmp(catalogCache.dirName, dirName) == 0 && catalogCache.inode == catalogStat.st_ino && catalogCache.size == catalogStat.st_size &&
+        catalogCache.mtime == catalogStat.st_mtime)
+        return catalogCache.numEntries != 0;
+
+    // drop old catalog
+    free(catalogCache.entries);
+    free(catalogCache.hashTable);
+    memset((void *)&catalogCache, 0, sizeof(catalogCache_t));
+    snprintf(catalogCache.dirName, MAXPATHLEN, "%s", dirName);
+    if (catalogStat.st_ino == 0) return 0;
+
+    catalogEntry_t *entries;
+    uint32_t numEntries = ReadCatalog(dirName, &catalogStat, &entries);
+    // remember the state also for a missing or invalid catalog
+    catalogCache.inode = catalogStat.st_ino;
+    catalogCache.size = catalogStat.st_size;
+    catalogCache.mtime = catalogStat.st_mtime;
+    if (numEntries == 0) return 0;
+
+    uint32_t mask;
+    uint32_t *hashTable = BuildHash(entries, numEntries, &mask);
+    if (!hashTable) {
+        free(entries);
+        return 0;
+    }
+
+    catalogCache.entries = entries;
+    catalogCache.numEntries = numEntries;
+    catalogCache.hashTable = hashTable;
+    catalogCache.hashMask = mask;
+
+    return 1;
+
+}  // End of LoadCatalog
+
+// find the entry of name in the cached catalog. Called with catalogLock held
+static catalogEntry_t *FindEntry(char *name) {
+    if (catalogCache.numEntries == 0) return NULL;
+
+    uint32_t slot = HashSlot(catalogCache.entries, catalogCache.hashTable, catalogCache.hashMask, name);
+    return catalogCache.hashTable[slot] ? &catalogCache.entries[catalogCache.hashTable[slot] - 1] : NULL;
+
+}  // End of FindEntry
+
+// look up fileName in the catalog of its directory. fstat is the stat of fileName
+// if already available, otherwise NULL. Returns 1 and fills catalogEntry, if a valid
+// entry exists, 0 otherwise
+int CatalogLookup(char *fileName, struct stat *fstat, catalogEntry_t *catalogEntry) {
+    char dirName[MAXPATHLEN];
+    char *name = SplitPath(fileName, dirName);
+    if (strlen(name) >= CATALOGNAMELEN) return 0;
+
+    struct stat stat_buf;
+    if (fstat == NULL) {
+        if (stat(fileName, &stat_buf) < 0) return 0;
+        fstat = &stat_buf;
+    }
+
+    pthread_mutex_lock(&catalogLock);
+    // the cached catalog may miss recently added files - reload it then
+    catalogEntry_t *entry = strcmp(catalogCache.dirName, dirName) == 0 ? FindEntry(name) : NULL;
+    if (entry == NULL || entry->size != (uint64_t)fstat->st_size || entry->mtime != fstat->st_mtime) {
+        entry = LoadCatalog(dirName) ? FindEntry(name) : NULL;
+    }
+
+    int found = 0;
+    if (entry && entry->size == (uint64_t)fstat->st_size && entry->mtime == fstat->st_mtime) {
+        memcpy((void *)catalogEntry, (void *)entry, sizeof(catalogEntry_t));
+        found = 1;
+    }
+    pthread_mutex_unlock(&catalogLock);
+
+    return found;
+
+}  // End of CatalogLookup
+
+// rewrite the catalog of dirName with the last entry of each existing and unmodified file
+static void CompactCatalog(char *dirName) {
+    char catalogName[MAXPATHLEN];
+    snprintf(catalogName, MAXPATHLEN, "%s/%s", dirName, CATALOGFILE);
+
+    // hold the lock until the compacted catalog replaces the current one
+    int lockFd = LockCatalog(catalogName, O_RDONLY);
+    if (lockFd < 0) return;
+
+    catalogEntry_t *entries;
+    struct stat catalogStat;
+    uint32_t numEntries = ReadCatalog(dirName, &catalogStat, &entries);
+    uint32_t mask;
+    uint32_t *hashTable = numEntries ? BuildHash(entries, numEntries, &mask) : NULL;
+    if (hashTable == NULL) {
+        free(entries);
+        close(lockFd);
+        return;
+    }
+
+    char tmpName[MAXPATHLEN];
+    snprintf(tmpName, MAXPATHLEN, "%s/%s.%d.tmp", dirName, CATALOGFILE, (int)getpid());
+    int fd = open(tmpName, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+    if (fd < 0) {
+        LogError("open() catalog %s failed: %s", tmpName, strerror(errno));
+        free(hashTable);
+        free(entries);
+        close(lockFd);
+        return;
+    }
+
+    catalogHeader_t catalogHeader = {.magic = CATALOGMAGIC, .version = CATALOGVERSION, .entrySize = sizeof(catalogEntry_t)};
+    int ok = write(fd, (void *)&catalogHeader, sizeof(catalogHeader_t)) == sizeof(catalogHeader_t);
+    uint32_t numKept = 0;
+    for (uint32_t i = 0; ok && i < numEntries; i++) {
+        catalogEntry_t *entry = &entries[i];
+        // skip entry, if a later one exists
+        if (hashTable[HashSlot(entries, hashTable, mask, entry->fileName)] != (i + 1)) continue;
+
+        char fileName[MAXPATHLEN];
+        snprintf(fileName, MAXPATHLEN, "%s/%s", dirName, entry->fileName);
+        struct stat fileStat;
+        if (stat(fileName, &fileStat) < 0 || entry->size != (uint64_t)fileStat.st_size || entry->mtime != fileStat.st_mtime) continue;
+
+        ok = write(fd, (void *)entry, sizeof(catalogEntry_t)) == sizeof(catalogEntry_t);
+        numKept++;
+    }
+    close(fd);
+    free(hashTable);
+    free(entries);
+
+    if (!ok || rename(tmpName, catalogName) < 0) {
+        LogError("Failed to compact catalog %s: %s", catalogName, strerror(errno));
+        unlink(tmpName);
+    } else {
+        dbg_printf("Compacted catalog %s: %u of %u entries\n", catalogName, numKept, numEntries);
+    }
+    close(lockFd);
+
+}  // End of CompactCatalog
+
+// add fileName to the catalog of its directory. Called by the collectors after
+// a file is rotated. Returns 1 on success, 0 otherwise
+int UpdateCatalog(char *fileName) {
+    char dirName[MAXPATHLEN];
+    char *name = SplitPath(fileName, dirName);
+    if (strlen(name) >= CATALOGNAMELEN) return 0;
+
+    catalogEntry_t catalogEntry;
+    memset((void *)&catalogEntry, 0, sizeof(catalogEntry_t));
+    strcpy(catalogEntry.fileName, name);
+    if (!ReadStatRecord(fileName, &catalogEntry.stat_record, catalogEntry.ident, IDENTLEN)) return 0;
+
+    struct stat fileStat;
+    if (stat(fileName, &fileStat) < 0) {
+        LogError("stat() %s failed: %s", fileName, strerror(errno));
+        return 0;
+    }
+    catalogEntry.size = fileStat.st_size;
+    catalogEntry.mtime = fileStat.st_mtime;
+
+    char catalogName[MAXPATHLEN];
+    snprintf(catalogName, MAXPATHLEN, "%s/%s", dirName, CATALOGFILE);
+    int fd = LockCatalog(catalogName, O_WRONLY | O_APPEND | O_CREAT);
+    if (fd < 0) return 0;
+
+    struct stat catalogStat;
+    if (fstat(fd, &catalogStat) < 0) {
+        LogError("fstat() catalog %s failed: %s", catalogName, strerror(errno));
+        close(fd);
+        return 0;
+    }
+
+    if (catalogStat.st_size == 0) {
+        catalogHeader_t catalogHeader = {.magic = CATALOGMAGIC, .version = CATALOGVERSION, .entrySize = sizeof(catalogEntry_t)};
+        if (write(fd, (void *)&catalogHeader, sizeof(catalogHeader_t)) != sizeof(catalogHeader_t)) {
+            LogError("write() catalog %s failed: %s", catalogName, strerror(errno));
+            close(fd);
+            return 0;
+        }
+        catalogStat.st_size = sizeof(catalogHeader_t);
+    }
+
+    if (write(fd, (void *)&catalogEntry, sizeof(catalogEntry_t)) != sizeof(catalogEntry_t)) {
+        LogError("write() catalog %s failed: %s", catalogName, strerror(errno));
+        close(fd);
+        return 0;
+    }
+    close(fd);
+
+    // drop entries of expired or replaced files from time to time
+    uint32_t numEntries = (catalogStat.st_size - sizeof(catalogHeader_t)) / sizeof(catalogEntry_t) + 1;
+    if ((numEntries % CATALOGCOMPACT) == 0) CompactCatalog(dirName);
+
+    return 1;
+
+}  // End of UpdateCatalog
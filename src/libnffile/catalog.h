@@ -0,0 +1,81 @@
+/*
+ *  Copyright (c) 2025, Peter Haag
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *   * Neither the name of the author nor the names of its contributors may be
+ *     used to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef _CATALOG_H
+#define _CATALOG_H 1
+
+#include <stdint.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "nfdump.h"
+#include "nffile.h"
+
+/*
+ * Directory catalog
+ * =================
+ * Each data directory may contain a catalog file with the stat record, ident and size
+ * of the nfdump files in this directory. The collectors append an entry at each file
+ * rotation. Readers take the stat record from the catalog instead of opening the file.
+ * An entry is valid, as long as size and modification time match the file. The last
+ * entry of a file name wins. The catalog is compacted from time to time.
+ *   +---------------+---------+---------+-----+---------+
+ *   |catalog header | entry 0 | entry 1 | ... | entry n |
+ *   +---------------+---------+---------+-----+---------+
+ */
+
+#define CATALOGFILE ".nfcatalog"
+
+typedef struct catalogHeader_s {
+    uint32_t magic;  // catalog magic
+#define CATALOGMAGIC 0x4E464354
+    uint16_t version;  // catalog version
+#define CATALOGVERSION 1
+    uint16_t entrySize;  // size of an entry
+} catalogHeader_t;
+
+#define CATALOGNAMELEN 64
+
+typedef struct catalogEntry_s {
+    char fileName[CATALOGNAMELEN];  // file name without directory
+    uint64_t size;                  // file size in bytes
+    int64_t mtime;                  // file modification time
+    stat_record_t stat_record;      // stat record of the file
+    char ident[IDENTLEN];           // ident of the file
+} catalogEntry_t;
+
+// compact the catalog after this number of appended entries
+#define CATALOGCOMPACT 256
+
+int CatalogLookup(char *fileName, struct stat *fstat, catalogEntry_t *catalogEntry);
+
+int UpdateCatalog(char *fileName);
+
+#endif  //_CATALOG_H
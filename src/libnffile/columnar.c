@@ -0,0 +1,318 @@
+/*
+ *  Copyright (c) 2025, Peter Haag
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *   * Neither the name of the author nor the names of its contributors may be
+ *     used to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "columnar.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+#include "id.h"
+#include "nfdump.h"
+#include "nffile.h"
+#include "nfxV3.h"
+#include "util.h"
+
+// a field of a hot extension, stored as an array in its own column
+typedef struct columnField_s {
+    uint16_t offset;
+    uint16_t size;
+} columnField_t;
+
+typedef struct columnExtension_s {
+    uint16_t size;  // size of the extension without element header
+    uint16_t numFields;
+    const columnField_t *field;
+} columnExtension_t;
+
+// the fields of each extension cover all bytes of the extension
+static const columnField_t genericFlowFields[] = {
+    {OFFmsecFirst, SIZEmsecFirst}, {OFFmsecLast, SIZEmsecLast}, {OFFmsecReceived, SIZEmsecReceived}, {OFFinPackets, SIZEinPackets},
+    {OFFinBytes, SIZEinBytes},     {OFFsrcPort, SIZEsrcPort},   {OFFdstPort, SIZEdstPort},           {OFFproto, SIZEproto},
+    {OFFtcpFlags, SIZEtcpFlags},   {OFFfwdStatus, SIZEfwdStatus}, {OFFsrcTos, SIZEsrcTos}};
+
+static const columnField_t ipv4FlowFields[] = {{OFFsrc4Addr, SIZEsrc4Addr}, {OFFdst4Addr, SIZEdst4Addr}};
+
+static const columnField_t ipv6FlowFields[] = {{OFFsrc6Addr, SIZEsrc6Addr}, {OFFdst6Addr, SIZEdst6Addr}};
+
+static const columnField_t flowMiscFields[] = {{OFFinput, SIZEinput},
+                                               {OFFoutput, SIZEoutput},
+                                               {OFFsrcMask, SIZEsrcMask},
+                                               {OFFdstMask, SIZEdstMask},
+                                               {OFFdir, SIZEdir},
+                                               {OFFdstTos, SIZEdstTos},
+                                               {OFFbiFlowDir, SIZEbiFlowDir},
+                                               {OFFflowEndReason, SIZEflowEndReason},
+                                               {offsetof(EXflowMisc_t, align), MemberSize(EXflowMisc_t, align)}};
+
+static const columnField_t cntFlowFields[] = {{OFFflows, SIZEflows}, {OFFoutPackets, SIZEoutPackets}, {OFFoutBytes, SIZEoutBytes}};
+
+#define NumFields(f) (sizeof(f) / sizeof(columnField_t))
+
+static const columnExtension_t columnExtension[COLUMNEXTENSIONS] = {
+    {sizeof(EXgenericFlow_t), NumFields(genericFlowFields), genericFlowFields},
+    {sizeof(EXipv4Flow_t), NumFields(ipv4FlowFields), ipv4FlowFields},
+    {sizeof(EXipv6Flow_t), NumFields(ipv6FlowFields), ipv6FlowFields},
+    {sizeof(EXflowMisc_t), NumFields(flowMiscFields), flowMiscFields},
+    {sizeof(EXcntFlow_t), NumFields(cntFlowFields), cntFlowFields}};
+
+#define ALIGN8(x) (((x) + 7) & ~7)
+
+// max number of fields of all extensions
+#define MAXFIELDS 16
+
+// returns the column index of an element, which is stored in the columns, otherwise -1
+static inline int ColumnIndex(const elementHeader_t *elementHeader) {
+    int index = (int)elementHeader->type - 1;
+    if (index < 0 || index >= COLUMNEXTENSIONS) return -1;
+    if (elementHeader->length != (columnExtension[index].size + sizeof(elementHeader_t))) return -1;
+    return index;
+
+}  // End of ColumnIndex
+
+// calculate the offsets of all field arrays relative to the start of the columns.
+// Returns the size of all columns
+static size_t ColumnLayout(const uint32_t *numValues, size_t fieldOffset[COLUMNEXTENSIONS][MAXFIELDS]) {
+    size_t offset = 0;
+    for (int i = 0; i < COLUMNEXTENSIONS; i++) {
+        const columnExtension_t *extension = &columnExtension[i];
+        for (int j = 0; j < extension->numFields; j++) {
+            fieldOffset[i][j] = offset;
+            offset = ALIGN8(offset + (size_t)numValues[i] * extension->field[j].size);
+        }
+    }
+    return offset;
+
+}  // End of ColumnLayout
+
+// check a V3 record and count its column elements. Returns 0 for a malformed record
+// or a record with data beyond its elements, which could not be restored
+static int CountRecord(recordHeaderV3_t *recordHeader, uint32_t *numValues) {
+    size_t size = sizeof(recordHeaderV3_t);
+    elementHeader_t *elementHeader = (elementHeader_t *)((void *)recordHeader + sizeof(recordHeaderV3_t));
+    for (int i = 0; i < recordHeader->numElements; i++) {
+        if (elementHeader->length < sizeof(elementHeader_t) || (size + elementHeader->length) > recordHeader->size) return 0;
+        int index = ColumnIndex(elementHeader);
+        if (index >= 0) numValues[index]++;
+        size += elementHeader->length;
+        elementHeader = (elementHeader_t *)((void *)elementHeader + elementHeader->length);
+    }
+    return size == recordHeader->size;
+
+}  // End of CountRecord
+
+// convert a type 3 row block into a type 5 column block. columnBlock must hold blockSize bytes.
+// Returns 0, if the block can not be converted - the row block is unchanged
+int ColumnBlock(dataBlock_t *rowBlock, dataBlock_t *columnBlock, size_t blockSize) {
+    if (rowBlock->type != DATA_BLOCK_TYPE_3) return 0;
+
+    // pass 1 - verify records and count the column values
+    uint32_t numValues[COLUMNEXTENSIONS] = {0};
+    recordHeader_t *recordHeader = (recordHeader_t *)GetCursor(rowBlock);
+    uint32_t sumSize = 0;
+    for (int i = 0; i < rowBlock->NumRecords; i++) {
+        if (recordHeader->size < sizeof(recordHeader_t) || (sumSize + recordHeader->size) > rowBlock->size) return 0;
+        if (recordHeader->type == V3Record) {
+            if (recordHeader->size < sizeof(recordHeaderV3_t) || !CountRecord((recordHeaderV3_t *)recordHeader, numValues)) return 0;
+        }
+        sumSize += recordHeader->size;
+        recordHeader = (recordHeader_t *)((void *)recordHeader + recordHeader->size);
+    }
+    if (sumSize != rowBlock->size) return 0;
+
+    size_t fieldOffset[COLUMNEXTENSIONS][MAXFIELDS];
+    size_t columnSize = ColumnLayout(numValues, fieldOffset);
+
+    // the row records shrink by the size of the column values
+    size_t rowSize = rowBlock->size;
+    for (int i = 0; i < COLUMNEXTENSIONS; i++) rowSize -= (size_t)numValues[i] * columnExtension[i].size;
+    size_t columnStart = ALIGN8(sizeof(columnHeader_t) + rowSize);
+    if ((sizeof(dataBlock_t) + columnStart + columnSize) > blockSize) return 0;
+
+    columnHeader_t *columnHeader = (columnHeader_t *)GetCursor(columnBlock);
+    memset((void *)columnHeader, 0, sizeof(columnHeader_t));
+    columnHeader->rowSize = rowSize;
+    columnHeader->numColumns = COLUMNEXTENSIONS;
+    memcpy((void *)columnHeader->numValues, (void *)numValues, sizeof(numValues));
+
+    // pass 2 - copy the rows and move the column elements into the columns
+    void *rowPtr = (void *)columnHeader + sizeof(columnHeader_t);
+    void *columns = (void *)columnHeader + columnStart;
+    uint32_t valueIndex[COLUMNEXTENSIONS] = {0};
+    recordHeader = (recordHeader_t *)GetCursor(rowBlock);
+    for (int i = 0; i < rowBlock->NumRecords; i++) {
+        if (recordHeader->type != V3Record) {
+            memcpy(rowPtr, (void *)recordHeader, recordHeader->size);
+            rowPtr += recordHeader->size;
+        } else {
+            recordHeaderV3_t *rowRecord = (recordHeaderV3_t *)rowPtr;
+            memcpy(rowPtr, (void *)recordHeader, sizeof(recordHeaderV3_t));
+            rowPtr += sizeof(recordHeaderV3_t);
+
+            elementHeader_t *elementHeader = (elementHeader_t *)((void *)recordHeader + sizeof(recordHeaderV3_t));
+            for (int j = 0; j < rowRecord->numElements; j++) {
+                int index = ColumnIndex(elementHeader);
+                if (index < 0) {
+                    memcpy(rowPtr, (void *)elementHeader, elementHeader->length);
+                    rowPtr += elementHeader->length;
+                } else {
+                    // element header only - the data goes into the columns
+                    elementHeader_t *stub = (elementHeader_t *)rowPtr;
+                    stub->type = elementHeader->type;
+                    stub->length = sizeof(elementHeader_t);
+                    rowPtr += sizeof(elementHeader_t);
+
+                    const columnExtension_t *extension = &columnExtension[index];
+                    void *data = (void *)elementHeader + sizeof(elementHeader_t);
+                    uint32_t v = valueIndex[index]++;
+                    for (int k = 0; k < extension->numFields; k++) {
+                        const columnField_t *field = &extension->field[k];
+                        memcpy(columns + fieldOffset[index][k] + (size_t)v * field->size, data + field->offset, field->size);
+                    }
+                }
+                elementHeader = (elementHeader_t *)((void *)elementHeader + elementHeader->length);
+            }
+            rowRecord->size = (uint16_t)(rowPtr - (void *)rowRecord);
+        }
+        recordHeader = (recordHeader_t *)((void *)recordHeader + recordHeader->size);
+    }
+
+    // clear alignment padding
+    size_t used = rowPtr - (void *)columnHeader;
+    if (used < columnStart) memset(rowPtr, 0, columnStart - used);
+
+    columnBlock->NumRecords = rowBlock->NumRecords;
+    columnBlock->size = columnStart + columnSize;
+    columnBlock->type = DATA_BLOCK_TYPE_5;
+    columnBlock->flags = rowBlock->flags;
+
+    return 1;
+
+}  // End of ColumnBlock
+
+// convert a type 5 column block back into a type 3 row block. rowBlock must hold blockSize bytes.
+// Returns 0 for a corrupt column block
+int RowBlock(dataBlock_t *columnBlock, dataBlock_t *rowBlock, size_t blockSize) {
+    if (columnBlock->type != DATA_BLOCK_TYPE_5 || columnBlock->size < sizeof(columnHeader_t)) return 0;
+
+    columnHeader_t *columnHeader = (columnHeader_t *)GetCursor(columnBlock);
+    if (columnHeader->numColumns != COLUMNEXTENSIONS) return 0;
+
+    size_t rowSize = columnHeader->rowSize;
+    size_t columnStart = ALIGN8(sizeof(columnHeader_t) + rowSize);
+    size_t fieldOffset[COLUMNEXTENSIONS][MAXFIELDS];
+    // values are limited by the block size - avoids overflows in the layout
+    for (int i = 0; i < COLUMNEXTENSIONS; i++) {
+        if (columnHeader->numValues[i] > columnBlock->size) return 0;
+    }
+    size_t columnSize = ColumnLayout(columnHeader->numValues, fieldOffset);
+    if (rowSize > columnBlock->size || (columnStart + columnSize) > columnBlock->size) return 0;
+
+    void *rowPtr = (void *)columnHeader + sizeof(columnHeader_t);
+    void *rowEnd = rowPtr + rowSize;
+    void *columns = (void *)columnHeader + columnStart;
+    void *outPtr = GetCursor(rowBlock);
+    void *outEnd = (void *)rowBlock + blockSize;
+    uint32_t valueIndex[COLUMNEXTENSIONS] = {0};
+
+    for (int i = 0; i < columnBlock->NumRecords; i++) {
+        recordHeader_t *recordHeader = (recordHeader_t *)rowPtr;
+        if ((rowPtr + sizeof(recordHeader_t)) > rowEnd || recordHeader->size < sizeof(recordHeader_t) || (rowPtr + recordHeader->size) > rowEnd)
+            return 0;
+
+        if (recordHeader->type != V3Record) {
+            if ((outPtr + recordHeader->size) > outEnd) return 0;
+            memcpy(outPtr, rowPtr, recordHeader->size);
+            outPtr += recordHeader->size;
+            rowPtr += recordHeader->size;
+            continue;
+        }
+
+        recordHeaderV3_t *rowRecord = (recordHeaderV3_t *)rowPtr;
+        if (rowRecord->size < sizeof(recordHeaderV3_t) || (outPtr + sizeof(recordHeaderV3_t)) > outEnd) return 0;
+        recordHeaderV3_t *outRecord = (recordHeaderV3_t *)outPtr;
+        memcpy(outPtr, rowPtr, sizeof(recordHeaderV3_t));
+        outPtr += sizeof(recordHeaderV3_t);
+
+        size_t size = sizeof(recordHeaderV3_t);
+        elementHeader_t *elementHeader = (elementHeader_t *)(rowPtr + sizeof(recordHeaderV3_t));
+        for (int j = 0; j < rowRecord->numElements; j++) {
+            if ((size + sizeof(elementHeader_t)) > rowRecord->size || elementHeader->length < sizeof(elementHeader_t) ||
+                (size + elementHeader->length) > rowRecord->size)
+                return 0;
+
+            int index = (int)elementHeader->type - 1;
+            if (index >= 0 && index < COLUMNEXTENSIONS && elementHeader->length == sizeof(elementHeader_t)) {
+                // restore element from the columns
+                const columnExtension_t *extension = &columnExtension[index];
+                uint32_t v = valueIndex[index]++;
+                if (v >= columnHeader->numValues[index] || (outPtr + sizeof(elementHeader_t) + extension->size) > outEnd) return 0;
+
+                elementHeader_t *outElement = (elementHeader_t *)outPtr;
+                outElement->type = elementHeader->type;
+                outElement->length = sizeof(elementHeader_t) + extension->size;
+                void *data = outPtr + sizeof(elementHeader_t);
+                for (int k = 0; k < extension->numFields; k++) {
+                    const columnField_t *field = &extension->field[k];
+                    memcpy(data + field->offset, columns + fieldOffset[index][k] + (size_t)v * field->size, field->size);
+                }
+                outPtr += outElement->length;
+            } else {
+                if ((outPtr + elementHeader->length) > outEnd) return 0;
+                memcpy(outPtr, (void *)elementHeader, elementHeader->length);
+                outPtr += elementHeader->length;
+            }
+            size += elementHeader->length;
+            elementHeader = (elementHeader_t *)((void *)elementHeader + elementHeader->length);
+        }
+        if (size != rowRecord->size) return 0;
+
+        size_t outSize = outPtr - (void *)outRecord;
+        if (outSize > UINT16_MAX) return 0;
+        outRecord->size = (uint16_t)outSize;
+        rowPtr += rowRecord->size;
+    }
+
+    // all rows and column values must be consumed
+    if (rowPtr != rowEnd) return 0;
+    for (int i = 0; i < COLUMNEXTENSIONS; i++) {
+        if (valueIndex[i] != columnHeader->numValues[i]) return 0;
+    }
+
+    rowBlock->NumRecords = columnBlock->NumRecords;
+    rowBlock->size = outPtr - GetCursor(rowBlock);
+    rowBlock->type = DATA_BLOCK_TYPE_3;
+    rowBlock->flags = columnBlock->flags;
+
+    return 1;
+
+}  // End of RowBlock
@@ -0,0 +1,65 @@
+/*
+ *  Copyright (c) 2025, Peter Haag
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *   * Neither the name of the author nor the names of its contributors may be
+ *     used to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef _COLUMNAR_H
+#define _COLUMNAR_H 1
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "nffileV2.h"
+
+/*
+ * Columnar data block - DATA_BLOCK_TYPE_5
+ * =======================================
+ * The hot extensions EXgenericFlow, EXipv4Flow, EXipv6Flow, EXflowMisc and EXcntFlow
+ * of all V3 records in a block are stored as struct of arrays: for each extension
+ * field an array with the values of all records in record order. In the row records,
+ * each hot extension is reduced to its element header with length sizeof(elementHeader_t).
+ * All other records and extensions remain unmodified in the row records.
+ * The row records start after the column header, the columns follow the row records.
+ * Each field array is 8 byte aligned.
+ */
+
+// hot extensions are EXgenericFlowID .. EXcntFlowID - column index is extension ID - 1
+#define COLUMNEXTENSIONS 5
+
+typedef struct columnHeader_s {
+    uint32_t rowSize;                       // size of all row records
+    uint16_t numColumns;                    // number of extension columns
+    uint16_t fill;                          // unused
+    uint32_t numValues[COLUMNEXTENSIONS];  // number of values of each extension
+} columnHeader_t;
+
+int ColumnBlock(dataBlock_t *rowBlock, dataBlock_t *columnBlock, size_t blockSize);
+
+int RowBlock(dataBlock_t *columnBlock, dataBlock_t *rowBlock, size_t blockSize);
+
+#endif  //_COLUMNAR_H
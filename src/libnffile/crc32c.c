@@ -0,0 +1,147 @@
+/*
+ *  Copyright (c) 2025, Peter Haag
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *   * Neither the name of the author nor the names of its contributors may be
+ *     used to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "crc32c.h"
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <nmmintrin.h>
+#define CRC32C_SSE42 1
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#define CRC32C_ARM 1
+#endif
+
+// reflected Castagnoli polynomial
+#define CRC32C_POLY 0x82F63B78
+
+typedef uint32_t (*crcFunc_t)(uint32_t crc, const uint8_t *p, size_t len);
+
+static uint32_t crcTable[8][256];
+static crcFunc_t crcFunc = NULL;
+static pthread_once_t crcOnce = PTHREAD_ONCE_INIT;
+
+// software CRC - slicing by 8
+static uint32_t Crc32cSoft(uint32_t crc, const uint8_t *p, size_t len) {
+    while (len && ((uintptr_t)p & 0x7)) {
+        crc = crcTable[0][(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+        len--;
+    }
+
+    while (len >= 8) {
+        uint32_t lo = crc ^ ((uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24);
+        uint32_t hi = (uint32_t)p[4] | (uint32_t)p[5] << 8 | (uint32_t)p[6] << 16 | (uint32_t)p[7] << 24;
+        crc = crcTable[7][lo & 0xFF] ^ crcTable[6][(lo >> 8) & 0xFF] ^ crcTable[5][(lo >> 16) & 0xFF] ^ crcTable[4][lo >> 24] ^
+              crcTable[3][hi & 0xFF] ^ crcTable[2][(hi >> 8) & 0xFF] ^ crcTable[1][(hi >> 16) & 0xFF] ^ crcTable[0][hi >> 24];
+        p += 8;
+        len -= 8;
+    }
+
+    while (len--) crc = crcTable[0][(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+
+    return crc;
+
+}  // End of Crc32cSoft
+
+#ifdef CRC32C_SSE42
+__attribute__((target("sse4.2"))) static uint32_t Crc32cSSE42(uint32_t crc, const uint8_t *p, size_t len) {
+    while (len && ((uintptr_t)p & 0x7)) {
+        crc = _mm_crc32_u8(crc, *p++);
+        len--;
+    }
+
+    uint64_t crc64 = crc;
+    while (len >= 8) {
+        uint64_t word;
+        memcpy((void *)&word, (void *)p, 8);
+        crc64 = _mm_crc32_u64(crc64, word);
+        p += 8;
+        len -= 8;
+    }
+    crc = (uint32_t)crc64;
+
+    while (len--) crc = _mm_crc32_u8(crc, *p++);
+
+    return crc;
+
+}  // End of Crc32cSSE42
+#endif
+
+#ifdef CRC32C_ARM
+static uint32_t Crc32cARM(uint32_t crc, const uint8_t *p, size_t len) {
+    while (len && ((uintptr_t)p & 0x7)) {
+        crc = __crc32cb(crc, *p++);
+        len--;
+    }
+
+    while (len >= 8) {
+        uint64_t word;
+        memcpy((void *)&word, (void *)p, 8);
+        crc = __crc32cd(crc, word);
+        p += 8;
+        len -= 8;
+    }
+
+    while (len--) crc = __crc32cb(crc, *p++);
+
+    return crc;
+
+}  // End of Crc32cARM
+#endif
+
+static void InitCrc32c(void) {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t crc = i;
+        for (int j = 0; j < 8; j++) crc = (crc & 1) ? (crc >> 1) ^ CRC32C_POLY : crc >> 1;
+        crcTable[0][i] = crc;
+    }
+    for (uint32_t i = 0; i < 256; i++) {
+        for (int t = 1; t < 8; t++) crcTable[t][i] = (crcTable[t - 1][i] >> 8) ^ crcTable[0][crcTable[t - 1][i] & 0xFF];
+    }
+
+    crcFunc = Crc32cSoft;
+#ifdef CRC32C_SSE42
+    if (__builtin_cpu_supports("sse4.2")) crcFunc = Crc32cSSE42;
+#endif
+#ifdef CRC32C_ARM
+    crcFunc = Crc32cARM;
+#endif
+
+}  // End of InitCrc32c
+
+uint32_t Crc32c(uint32_t crc, const void *data, size_t len) {
+    pthread_once(&crcOnce, InitCrc32c);
+    return ~crcFunc(~crc, (const uint8_t *)data, len);
+
+}  // End of Crc32c
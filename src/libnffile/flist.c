@@ -58,6 +58,7 @@
 #define fts_set fts_set_compat
 #endif
 
+#include "catalog.h"
 #include "flist.h"
 #include "nfdump.h"
 #include "nffile.h"
@@ -231,7 +232,7 @@ static char *VerifyFileRange(char *path, char *last_file);
 
 static void *FileLister_thr(void *arg);
 
-static int CheckTimeWindow(char *filename, timeWindow_t *searchWindow);
+static int CheckTimeWindow(char *filename, struct stat *fstat, timeWindow_t *searchWindow);
 
 /* Functions */
 
@@ -814,6 +815,8 @@ static int GetFileList(char *path, timeWindow_t *timeWindow) {
 
                 // skip stat file
                 if (strcmp(ftsent->fts_name, ".nfstat") == 0 || strncmp(ftsent->fts_name, NF_DUMPFILE, strlen(NF_DUMPFILE)) == 0) continue;
+                // skip directory catalog
+                if (strncmp(ftsent->fts_name, CATALOGFILE, strlen(CATALOGFILE)) == 0) continue;
                 if (strstr(ftsent->fts_name, ".stat") != NULL) continue;
                 // skip OSX DS_Store files
                 if (strstr(ftsent->fts_name, ".DS_Store") != NULL) continue;
@@ -826,7 +829,7 @@ static int GetFileList(char *path, timeWindow_t *timeWindow) {
                      (dir_entry_filter[fts_level].last_entry && (strcmp(ftsent->fts_name, dir_entry_filter[fts_level].last_entry) > 0))))
                     continue;
 
-                if (CheckTimeWindow(ftsent->fts_path, timeWindow)) {
+                if (CheckTimeWindow(ftsent->fts_path, ftsent->fts_statp, timeWindow)) {
                     queue_push(file_queue, strdup(ftsent->fts_path));
                 }
                 break;
@@ -957,7 +960,7 @@ static void *FileLister_thr(void *arg) {
 
         if (source_dirs.num_strings == 0) {
             // single file -r
-            if (CheckTimeWindow(single_file, flist->timeWindow)) {
+            if (CheckTimeWindow(single_file, NULL, flist->timeWindow)) {
                 queue_push(file_queue, strdup(single_file));
             }
         } else {
@@ -984,7 +987,7 @@ static void *FileLister_thr(void *arg) {
                         if (sub_dir) {  // subdir found
                             snprintf(s, MAXPATHLEN - 1, "%s/%s/%s", source_dirs.list[i], sub_dir, single_file);
                             s[MAXPATHLEN - 1] = '\0';
-                            if (CheckTimeWindow(s, flist->timeWindow)) {
+                            if (CheckTimeWindow(s, NULL, flist->timeWindow)) {
                                 queue_push(file_queue, strdup(s));
                             }
                         } else {  // no subdir found
@@ -999,7 +1002,7 @@ static void *FileLister_thr(void *arg) {
                     if (!S_ISREG(stat_buf.st_mode)) {
                         LogError("Skip non file entry: '%s'", s);
                     } else {
-                        if (CheckTimeWindow(s, flist->timeWindow)) {
+                        if (CheckTimeWindow(s, NULL, flist->timeWindow)) {
                             queue_push(file_queue, strdup(s));
                         }
                     }
@@ -1210,17 +1213,24 @@ static int mkpath(char *path, char *p, mode_t mode, mode_t dir_mode, char *error
 
 }  // End of mkpath
 
-static int CheckTimeWindow(char *filename, timeWindow_t *searchWindow) {
+static int CheckTimeWindow(char *filename, struct stat *fstat, timeWindow_t *searchWindow) {
     // no time search window set
     if (!searchWindow) return 1;
 
-    stat_record_t stat_record;
-    if (!GetStatRecord(filename, &stat_record)) {
+    // prefer the directory catalog over opening each file
+    stat_record_t *stat_record;
+    catalogEntry_t catalogEntry;
+    stat_record_t file_stat_record;
+    if (CatalogLookup(filename, fstat, &catalogEntry)) {
+        stat_record = &catalogEntry.stat_record;
+    } else if (ReadStatRecord(filename, &file_stat_record, NULL, 0)) {
+        stat_record = &file_stat_record;
+    } else {
         return 0;
     }
 
-    if (searchWindow->msecLast && searchWindow->msecLast < stat_record.firstseen) return 0;
-    if (searchWindow->msecFirst && searchWindow->msecFirst > stat_record.lastseen) return 0;
+    if (searchWindow->msecLast && searchWindow->msecLast < stat_record->firstseen) return 0;
+    if (searchWindow->msecFirst && searchWindow->msecFirst > stat_record->lastseen) return 0;
 
     return 1;
 
@@ -28,6 +28,9 @@
  *
  */
 
+// sync_file_range()
+#define _GNU_SOURCE
+
 #ifdef HAVE_CONFIG_H
 #include "config.h"
 #endif
@@ -42,6 +45,7 @@
 #endif
 
 #ifdef HAVE_ZSTD
+#include <zdict.h>
 #include <zstd.h>
 #endif
 
@@ -54,6 +58,7 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <inttypes.h>
+#include <limits.h>
 #include <netinet/in.h>
 #include <pthread.h>
 #include <signal.h>
@@ -62,6 +67,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
 #include <sys/param.h>
 #include <sys/socket.h>
 #include <sys/stat.h>
@@ -76,7 +82,11 @@
 #include "lz4hc.h"
 #endif
 #include "barrier.h"
+#include "catalog.h"
+#include "columnar.h"
+#include "crc32c.h"
 #include "minilzo.h"
+#include "nfconf.h"
 #include "nfdump.h"
 #include "nffileV2.h"
 #include "util.h"
@@ -94,10 +104,42 @@
 #define COMPRESSION_LEVEL(c) (((c) >> 16) & 0xFFFF)
 
 static const char *nf_creator[MAX_CREATOR] = {"unknown", "nfcapd",    "nfpcapd",   "sfcapd",    "nfdump",
-                                              "nfanon",  "nfprofile", "geolookup", "ft2nfdump", "torlookup"};
+                                              "nfanon",  "nfprofile", "geolookup", "ft2nfdump", "torlookup",
+                                              "nfcompact"};
 
 static unsigned NumWorkers = DEFAULTWORKERS;
 
+#define DICT_SAMPLEBUFF (1024 * 1024)
+#define DICT_SAMPLESIZE (16 * 1024)
+#define DICT_MAXSAMPLES 1024
+#define DICT_MINSIZE 1024
+
+// compression dictionary of a file, loaded once, when the file is opened
+typedef struct compressDict_s {
+    dictionary_t *dictionary;  // dictionary as stored in the appendix
+#ifdef HAVE_ZSTD
+    ZSTD_CDict *cdict;  // compression dictionary - writing files only
+    ZSTD_DDict *ddict;  // decompression dictionary
+#endif
+} compressDict_t;
+
+// data of written blocks to train a dictionary for the next file
+typedef struct dictSamples_s {
+    size_t size;               // sample data collected
+    uint32_t numSamples;       // number of samples
+    size_t sampleSize[DICT_MAXSAMPLES];  // size of each sample
+    uint8_t data[DICT_SAMPLEBUFF];       // sample data
+} dictSamples_t;
+
+static int trainDictionary = 0;
+
+// adaptive compression level of data blocks
+static int adaptiveCompression = 0;
+#define ADAPT_STORE -1  // store block uncompressed
+
+// drop written data blocks from the page cache
+static int dropCache = 0;
+
 /* function prototypes */
 static int LZO_initialize(void);
 
@@ -111,21 +153,68 @@ static int Compress_Block_LZO(dataBlock_t *in_block, dataBlock_t *out_block, siz
 
 static int Uncompress_Block_LZO(dataBlock_t *in_block, dataBlock_t *out_block, size_t block_size);
 
-static int Compress_Block_LZ4(dataBlock_t *in_block, dataBlock_t *out_block, size_t block_size, int level);
+static int Compress_Block_LZ4(dataBlock_t *in_block, dataBlock_t *out_block, size_t block_size, int level, compressDict_t *dict);
 
-static int Uncompress_Block_LZ4(dataBlock_t *in_block, dataBlock_t *out_block, size_t block_size);
+static int Uncompress_Block_LZ4(dataBlock_t *in_block, dataBlock_t *out_block, size_t block_size, compressDict_t *dict);
 
 static int Compress_Block_BZ2(dataBlock_t *in_block, dataBlock_t *out_block, size_t block_size);
 
-static int Compress_Block_ZSTD(dataBlock_t *in_block, dataBlock_t *out_block, size_t block_size, int level);
+static int Compress_Block_ZSTD(dataBlock_t *in_block, dataBlock_t *out_block, size_t block_size, int level, compressDict_t *dict);
 
-static int Uncompress_Block_ZSTD(dataBlock_t *in_block, dataBlock_t *out_block, size_t block_size);
+static int Uncompress_Block_ZSTD(dataBlock_t *in_block, dataBlock_t *out_block, size_t block_size, compressDict_t *dict);
 
 static int Uncompress_Block_BZ2(dataBlock_t *in_block, dataBlock_t *out_block, size_t block_size);
 
 static dataBlock_t *nfread(nffile_t *nffile);
 
-static int nfwrite(nffile_t *nffile, dataBlock_t *block_header);
+static dataBlock_t *nfreadRaw(nffile_t *nffile);
+
+static dataBlock_t *nfreadMap(nffile_t *nffile);
+
+static dataBlock_t *ExpandBlock(dataBlock_t *columnBlock);
+
+static dataBlock_t *nfuncompress(nffile_t *nffile, dataBlock_t *buff);
+
+static int VerifyBlock(nffile_t *nffile, int64_t blockNum, dataBlock_t *buff);
+
+// summary of a data block, collected by the writer
+typedef struct blockSummary_s {
+    blockInfo_t blockInfo;
+    zoneMap_t zoneMap;
+    bloomFilter_t *bloomFilter;
+    uint32_t checksum;  // CRC32C of the block on disk
+} blockSummary_t;
+
+// data block compressed by a nfwriter thread, waiting to be written in sequence
+typedef struct writeJob_s {
+    dataBlock_t *dataBlock;        // uncompressed data block
+    dataBlock_t *buff;             // buffer of the compressed block, NULL if not compressed
+    dataBlock_t *wptr;             // block to write
+    int compression;               // compression of the written block
+    blockSummary_t *blockSummary;  // summary for the block directory. NULL for appendix blocks
+    blockSummary_t summary;
+} writeJob_t;
+
+// marks a block in the write ring, which failed to compress
+#define WRITE_FAILED (writeJob_t *)-1
+
+static int nfwrite(nffile_t *nffile, dataBlock_t *block_header, blockSummary_t *blockSummary);
+
+static void FreeWriteJob(writeJob_t *job);
+
+static void ScanBlock(dataBlock_t *dataBlock, blockSummary_t *blockSummary);
+
+static void FreeBloomFilters(nffile_t *nffile);
+
+static compressDict_t *NewDictionary(int compression, void *data, uint32_t size);
+
+static void FreeDictionary(nffile_t *nffile);
+
+static void SampleBlock(nffile_t *nffile, dataBlock_t *dataBlock);
+
+static void TrainDictionary(nffile_t *nffile);
+
+static void PrepareDictionary(nffile_t *nffile);
 
 static int ReadAppendix(nffile_t *nffile);
 
@@ -141,14 +230,85 @@ static void UpdateStat(stat_record_t *s, stat_recordV1_t *sv1);
 
 static queue_t *fileQueue = NULL;
 
+// cross file readahead
+static queue_t *fileSource = NULL;  // file list queue, which feeds the prefetch thread
+#define PREFETCHFILES 2
+#define PREFETCHSIZE (2 * BUFFSIZE)
+
+static void *nfprefetch(void *arg);
+
+static blockCheck_t blockCheck = NULL;
+static void *blockCheckArg = NULL;
+
+// raw data block read from file, tagged with its sequence number
+typedef struct blockJob_s {
+    uint32_t seq;
+    dataBlock_t *dataBlock;
+} blockJob_t;
+
+// marks a block in the reorder ring, which failed to decompress
+#define BLOCK_FAILED (dataBlock_t *)-1
+
 /* function definitions */
 
 #define QueueSize 4
 
 static _Atomic unsigned blocksInUse;
 
+// recycling pool of data block buffers. Freed buffers are parked in one of the
+// BLOCKPOOLSIZE slots and handed out again by NewDataBlock(). Slots are taken and
+// filled with atomic exchange/compare and swap, so the pool is lock free.
+// Buffers are pre-faulted on allocation and optionally backed by huge pages
+#define BLOCKPOOLSIZE 16
+#define HUGEPAGESIZE (2 * ONEMB)
+static _Atomic(dataBlock_t *) blockPool[BLOCKPOOLSIZE];
+static _Atomic unsigned blocksHighWater;
+static _Atomic unsigned blocksPooled;
+static _Atomic uint64_t poolHits;
+static _Atomic uint64_t poolMisses;
+static int useHugePages = 0;
+
+// memory mapped uncompressed file. Blocks read from the map point into the map
+// and are not copied. The map is private and writable, so blocks may still be
+// modified in place. A map is released, when the file is closed and all its blocks are freed
+typedef struct fileMap_s {
+    struct fileMap_s *next;
+    void *addr;       // start of map
+    size_t size;      // size of map
+    size_t advised;   // end of the madvise() prefetch window
+    uint32_t refCnt;  // open file + blocks in use
+} fileMap_t;
+
+#define MMAP_PREFETCH (4 * BUFFSIZE)
+
+static pthread_mutex_t mapLock = PTHREAD_MUTEX_INITIALIZER;
+static fileMap_t *fileMapList = NULL;
+static _Atomic unsigned numFileMaps;
+
 int Init_nffile(int workers, queue_t *fileList) {
     fileQueue = fileList;
+
+    // files from the file list are prefetched by the nfprefetch thread, which feeds
+    // the fileQueue. readahead < 0 in the config file disables prefetching
+    int readahead = ConfGetValue("readahead");
+    if (readahead == 0) readahead = PREFETCHFILES;
+    if (fileList && fileList != fileSource && readahead > 0) {
+        // queue length must be a power of 2
+        size_t queueLength = 1;
+        while (queueLength < readahead && queueLength < 64) queueLength <<= 1;
+        queue_t *prefetchQueue = queue_init(queueLength);
+        pthread_t tid;
+        fileSource = fileList;
+        if (prefetchQueue && pthread_create(&tid, NULL, nfprefetch, (void *)prefetchQueue) == 0) {
+            pthread_detach(tid);
+            fileQueue = prefetchQueue;
+        } else {
+            fileSource = NULL;
+            LogError("Failed to start file prefetch thread. Continue without readahead");
+            if (prefetchQueue) queue_free(prefetchQueue);
+        }
+    }
+
     if (!LZO_initialize()) {
         LogError("Failed to initialize LZO");
         return 0;
@@ -167,12 +327,24 @@ int Init_nffile(int workers, queue_t *fileList) {
     }
 
     atomic_init(&blocksInUse, 0);
+    useHugePages = ConfGetValue("hugepages") > 0;
+    trainDictionary = ConfGetValue("dictionary") > 0;
+    adaptiveCompression = ConfGetValue("adaptive") > 0;
+    dropCache = ConfGetValue("dropcache") > 0;
 
     NumWorkers = GetNumWorkers(workers);
     return 1;
 
 }  // End of Init_nffile
 
+// install a callback to check, if a data block described in the block directory
+// needs to be read. NULL removes the check.
+void SetBlockCheck(blockCheck_t check, void *arg) {
+    blockCheck = check;
+    blockCheckArg = arg;
+
+}  // End of SetBlockCheck
+
 int ParseCompression(char *arg) {
     if (arg == NULL) {
         return LZO_COMPRESSED;
@@ -251,6 +423,14 @@ unsigned ReportBlocks(void) {
     return inUse;
 }
 
+void ReportBlockPool(blockPoolStat_t *blockPoolStat) {
+    blockPoolStat->inUse = atomic_load(&blocksInUse);
+    blockPoolStat->highWater = atomic_load(&blocksHighWater);
+    blockPoolStat->pooled = atomic_load(&blocksPooled);
+    blockPoolStat->hits = atomic_load(&poolHits);
+    blockPoolStat->misses = atomic_load(&poolMisses);
+}  // End of ReportBlockPool
+
 static int LZO_initialize(void) {
     if (lzo_init() != LZO_E_OK) {
         // this usually indicates a compiler bug - try recompiling
@@ -344,16 +524,41 @@ static int Uncompress_Block_LZO(dataBlock_t *in_block, dataBlock_t *out_block, s
 
 }  // End of Uncompress_Block_LZO
 
-static int Compress_Block_LZ4(dataBlock_t *in_block, dataBlock_t *out_block, size_t block_size, int level) {
+static int Compress_Block_LZ4(dataBlock_t *in_block, dataBlock_t *out_block, size_t block_size, int level, compressDict_t *dict) {
     const char *in = (const char *)((void *)in_block + sizeof(dataBlock_t));
     char *out = (char *)((void *)out_block + sizeof(dataBlock_t));
     int in_len = in_block->size;
 
     int out_len;
-    if (level > LZ4HC_CLEVEL_MIN)
+    if (dict) {
+        // compress as continuation of the dictionary
+        const char *dictData = (const char *)dict->dictionary->data;
+        int dictSize = dict->dictionary->size;
+        if (level > LZ4HC_CLEVEL_MIN) {
+            LZ4_streamHC_t *streamHC = LZ4_createStreamHC();
+            if (!streamHC) {
+                LogError("LZ4_createStreamHC() error in %s line %d", __FILE__, __LINE__);
+                return -1;
+            }
+            LZ4_resetStreamHC(streamHC, level);
+            LZ4_loadDictHC(streamHC, dictData, dictSize);
+            out_len = LZ4_compress_HC_continue(streamHC, in, out, in_len, block_size);
+            LZ4_freeStreamHC(streamHC);
+        } else {
+            LZ4_stream_t *stream = LZ4_createStream();
+            if (!stream) {
+                LogError("LZ4_createStream() error in %s line %d", __FILE__, __LINE__);
+                return -1;
+            }
+            LZ4_loadDict(stream, dictData, dictSize);
+            out_len = LZ4_compress_fast_continue(stream, in, out, in_len, block_size, 1);
+            LZ4_freeStream(stream);
+        }
+    } else if (level > LZ4HC_CLEVEL_MIN) {
         out_len = LZ4_compress_HC(in, out, in_len, block_size, level);
-    else
+    } else {
         out_len = LZ4_compress_default(in, out, in_len, block_size);
+    }
 
     if (out_len == 0) {
         LogError("Compress_Block_LZ4() error compression aborted in %s line %d: LZ4 : buffer too small", __FILE__, __LINE__);
@@ -372,12 +577,16 @@ static int Compress_Block_LZ4(dataBlock_t *in_block, dataBlock_t *out_block, siz
 
 }  // End of Compress_Block_LZ4
 
-static int Uncompress_Block_LZ4(dataBlock_t *in_block, dataBlock_t *out_block, size_t block_size) {
+static int Uncompress_Block_LZ4(dataBlock_t *in_block, dataBlock_t *out_block, size_t block_size, compressDict_t *dict) {
     const char *in = (const char *)((void *)in_block + sizeof(dataBlock_t));
     char *out = (char *)((void *)out_block + sizeof(dataBlock_t));
     int in_len = in_block->size;
 
-    int out_len = LZ4_decompress_safe(in, out, in_len, block_size);
+    int out_len;
+    if (dict)
+        out_len = LZ4_decompress_safe_usingDict(in, out, in_len, block_size, (const char *)dict->dictionary->data, dict->dictionary->size);
+    else
+        out_len = LZ4_decompress_safe(in, out, in_len, block_size);
     if (out_len == 0) {
         LogError("LZ4_decompress_safe() error compression aborted in %s line %d: LZ4 : buffer too small", __FILE__, __LINE__);
         return -1;
@@ -464,14 +673,26 @@ static int Uncompress_Block_BZ2(dataBlock_t *in_block, dataBlock_t *out_block, s
 
 }  // End of Uncompress_Block_BZ2
 
-static int Compress_Block_ZSTD(dataBlock_t *in_block, dataBlock_t *out_block, size_t block_size, int level) {
+static int Compress_Block_ZSTD(dataBlock_t *in_block, dataBlock_t *out_block, size_t block_size, int level, compressDict_t *dict) {
 #ifdef HAVE_ZSTD
     const char *in = (const char *)((void *)in_block + sizeof(dataBlock_t));
     char *out = (char *)((void *)out_block + sizeof(dataBlock_t));
     int in_len = in_block->size;
 
-    if (level == 0) level = ZSTD_CLEVEL_DEFAULT;
-    int out_len = ZSTD_compress(out, block_size, in, in_len, level);
+    size_t out_len;
+    if (dict) {
+        // the compression level is part of the dictionary
+        ZSTD_CCtx *cctx = ZSTD_createCCtx();
+        if (!cctx) {
+            LogError("ZSTD_createCCtx() error in %s line %d", __FILE__, __LINE__);
+            return -1;
+        }
+        out_len = ZSTD_compress_usingCDict(cctx, out, block_size, in, in_len, dict->cdict);
+        ZSTD_freeCCtx(cctx);
+    } else {
+        if (level == 0) level = ZSTD_CLEVEL_DEFAULT;
+        out_len = ZSTD_compress(out, block_size, in, in_len, level);
+    }
 
     if (ZSTD_isError(out_len)) {
         LogError("Compress_Block_ZSTD() error compression aborted in %s line %d: LZ4 : buffer too small", __FILE__, __LINE__);
@@ -489,13 +710,24 @@ static int Compress_Block_ZSTD(dataBlock_t *in_block, dataBlock_t *out_block, si
 
 }  // End of Compress_Block_ZSTD
 
-static int Uncompress_Block_ZSTD(dataBlock_t *in_block, dataBlock_t *out_block, size_t block_size) {
+static int Uncompress_Block_ZSTD(dataBlock_t *in_block, dataBlock_t *out_block, size_t block_size, compressDict_t *dict) {
 #ifdef HAVE_ZSTD
     const char *in = (const char *)((void *)in_block + sizeof(dataBlock_t));
     char *out = (char *)((void *)out_block + sizeof(dataBlock_t));
     int in_len = in_block->size;
 
-    size_t out_len = ZSTD_decompress(out, block_size, in, in_len);
+    size_t out_len;
+    if (dict) {
+        ZSTD_DCtx *dctx = ZSTD_createDCtx();
+        if (!dctx) {
+            LogError("ZSTD_createDCtx() error in %s line %d", __FILE__, __LINE__);
+            return -1;
+        }
+        out_len = ZSTD_decompress_usingDDict(dctx, out, block_size, in, in_len, dict->ddict);
+        ZSTD_freeDCtx(dctx);
+    } else {
+        out_len = ZSTD_decompress(out, block_size, in, in_len);
+    }
     if (ZSTD_isError(out_len)) {
         LogError("LZ4_decompress_safe() error compression aborted in %s line %d: LZ4 : buffer too small", __FILE__, __LINE__);
         return -1;
@@ -511,26 +743,149 @@ static int Uncompress_Block_ZSTD(dataBlock_t *in_block, dataBlock_t *out_block,
 #endif
 }  // End of Uncompress_Block_ZSTD
 
-dataBlock_t *NewDataBlock(void) {
-    dataBlock_t *dataBlock = malloc(BUFFSIZE);
-    if (!dataBlock) {
-        LogError("malloc() error in %s line %d: %s", __FILE__, __LINE__, strerror(errno));
+// allocate a new data block buffer for the pool
+static dataBlock_t *AllocBlockBuffer(void) {
+    void *buffer = NULL;
+    int err = posix_memalign(&buffer, useHugePages ? HUGEPAGESIZE : sysconf(_SC_PAGESIZE), BUFFSIZE);
+    if (err) {
+        LogError("posix_memalign() error in %s line %d: %s", __FILE__, __LINE__, strerror(err));
         return NULL;
     }
+#ifdef MADV_HUGEPAGE
+    if (useHugePages) madvise(buffer, BUFFSIZE, MADV_HUGEPAGE);
+#endif
+
+    // pre-fault all pages
+    long pageSize = sysconf(_SC_PAGESIZE);
+    for (size_t offset = 0; offset < BUFFSIZE; offset += pageSize) ((volatile char *)buffer)[offset] = 0;
+
+    return (dataBlock_t *)buffer;
+
+}  // End of AllocBlockBuffer
+
+dataBlock_t *NewDataBlock(void) {
+    dataBlock_t *dataBlock = NULL;
+    for (int i = 0; i < BLOCKPOOLSIZE && dataBlock == NULL; i++) {
+        if (atomic_load_explicit(&blockPool[i], memory_order_relaxed)) dataBlock = atomic_exchange(&blockPool[i], NULL);
+    }
+
+    if (dataBlock) {
+        atomic_fetch_sub(&blocksPooled, 1);
+        atomic_fetch_add(&poolHits, 1);
+    } else {
+        dataBlock = AllocBlockBuffer();
+        if (!dataBlock) return NULL;
+        atomic_fetch_add(&poolMisses, 1);
+    }
     InitDataBlock(dataBlock);
-    atomic_fetch_add(&blocksInUse, 1);
+
+    unsigned inUse = atomic_fetch_add(&blocksInUse, 1) + 1;
+    unsigned highWater = atomic_load(&blocksHighWater);
+    while (inUse > highWater && !atomic_compare_exchange_weak(&blocksHighWater, &highWater, inUse))
+        ;
     return dataBlock;
 
 }  // End of NewDataBlock
 
+// return a buffer to the pool. Buffers exceeding the pool are freed
+static void PoolBlockBuffer(dataBlock_t *dataBlock) {
+    for (int i = 0; i < BLOCKPOOLSIZE; i++) {
+        dataBlock_t *expected = NULL;
+        if (atomic_load_explicit(&blockPool[i], memory_order_relaxed) == NULL && atomic_compare_exchange_strong(&blockPool[i], &expected, dataBlock)) {
+            atomic_fetch_add(&blocksPooled, 1);
+            return;
+        }
+    }
+    free((void *)dataBlock);
+
+}  // End of PoolBlockBuffer
+
+// drop a reference of a file map. The last reference unmaps the file
+// Called with mapLock held
+static void ReleaseMap(fileMap_t *fileMap) {
+    if (--fileMap->refCnt) return;
+
+    fileMap_t **p = &fileMapList;
+    while (*p && *p != fileMap) p = &(*p)->next;
+    if (*p) *p = fileMap->next;
+
+    if (munmap(fileMap->addr, fileMap->size) < 0) {
+        LogError("munmap() error in %s line %d: %s", __FILE__, __LINE__, strerror(errno));
+    }
+    free(fileMap);
+    atomic_fetch_sub(&numFileMaps, 1);
+
+}  // End of ReleaseMap
+
+// release a data block, which points into a file map. Returns 0, if the block is not mapped
+static int FreeMapBlock(dataBlock_t *dataBlock) {
+    int found = 0;
+    pthread_mutex_lock(&mapLock);
+    for (fileMap_t *fileMap = fileMapList; fileMap; fileMap = fileMap->next) {
+        if ((void *)dataBlock >= fileMap->addr && (void *)dataBlock < (fileMap->addr + fileMap->size)) {
+            ReleaseMap(fileMap);
+            found = 1;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&mapLock);
+
+    return found;
+
+}  // End of FreeMapBlock
+
 void FreeDataBlock(dataBlock_t *dataBlock) {
     // Release block
     if (dataBlock) {
-        free((void *)dataBlock);
+        if (atomic_load(&numFileMaps) == 0 || FreeMapBlock(dataBlock) == 0) PoolBlockBuffer(dataBlock);
         atomic_fetch_sub(&blocksInUse, 1);
     }
 }  // End of FreeDataBlock
 
+// map an uncompressed file for reading. If the file can not be mapped
+// blocks are read with read() as usual
+static void MapFile(nffile_t *nffile) {
+    struct stat stat_buf;
+    if (fstat(nffile->fd, &stat_buf) < 0 || stat_buf.st_size == 0) return;
+
+    void *addr = mmap(NULL, stat_buf.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, nffile->fd, 0);
+    if (addr == MAP_FAILED) {
+        dbg_printf("mmap() failed: %s\n", strerror(errno));
+        return;
+    }
+    madvise(addr, stat_buf.st_size, MADV_SEQUENTIAL);
+
+    fileMap_t *fileMap = calloc(1, sizeof(fileMap_t));
+    if (!fileMap) {
+        LogError("calloc() error in %s line %d: %s", __FILE__, __LINE__, strerror(errno));
+        munmap(addr, stat_buf.st_size);
+        return;
+    }
+    fileMap->addr = addr;
+    fileMap->size = stat_buf.st_size;
+    fileMap->refCnt = 1;
+
+    pthread_mutex_lock(&mapLock);
+    fileMap->next = fileMapList;
+    fileMapList = fileMap;
+    atomic_fetch_add(&numFileMaps, 1);
+    pthread_mutex_unlock(&mapLock);
+
+    nffile->fileMap = fileMap;
+
+}  // End of MapFile
+
+// release the file map of nffile. Blocks still in use keep the map alive
+static void UnmapFile(nffile_t *nffile) {
+    if (nffile->fileMap == NULL) return;
+
+    pthread_mutex_lock(&mapLock);
+    ReleaseMap(nffile->fileMap);
+    pthread_mutex_unlock(&mapLock);
+    nffile->fileMap = NULL;
+
+}  // End of UnmapFile
+
 static int ReadAppendix(nffile_t *nffile) {
     dbg_printf("Process appendix ..\n");
     off_t currentPos = lseek(nffile->fd, 0, SEEK_CUR);
@@ -545,6 +900,10 @@ static int ReadAppendix(nffile_t *nffile) {
         return 0;
     }
 
+    nffile->numBlockInfo = 0;
+    nffile->numZoneMap = 0;
+    nffile->numChecksum = 0;
+    FreeBloomFilters(nffile);
     dbg_printf("Num of appendix records: %u\n", nffile->file_header->appendixBlocks);
     for (int i = 0; i < nffile->file_header->appendixBlocks; i++) {
         size_t processed = 0;
@@ -552,6 +911,7 @@ static int ReadAppendix(nffile_t *nffile) {
         if (!block_header) {
             LogError("Unable to read appendix block of file: %s", nffile->fileName);
             lseek(nffile->fd, currentPos, SEEK_SET);
+            nffile->numBlockInfo = 0;
             return 0;
         }
         void *buff_ptr = (void *)((void *)block_header + sizeof(dataBlock_t));
@@ -580,20 +940,148 @@ static int ReadAppendix(nffile_t *nffile) {
                         LogError("Error processing appendix stat record");
                     }
                     break;
+                case TYPE_BLOCKDIR: {
+                    dbg_printf("Read block directory from appendix block\n");
+                    blockDir_t *blockDir = (blockDir_t *)data;
+                    if (dataSize < sizeof(blockDir_t) || dataSize != (sizeof(blockDir_t) + blockDir->numEntries * sizeof(blockInfo_t)) ||
+                        blockDir->firstBlock != nffile->numBlockInfo) {
+                        LogError("Error processing appendix block directory");
+                        break;
+                    }
+                    uint32_t numBlockInfo = nffile->numBlockInfo + blockDir->numEntries;
+                    if (numBlockInfo > nffile->maxBlockInfo) {
+                        blockInfo_t *blockInfo = realloc(nffile->blockInfo, numBlockInfo * sizeof(blockInfo_t));
+                        if (!blockInfo) {
+                            LogError("realloc() error in %s line %d: %s", __FILE__, __LINE__, strerror(errno));
+                            break;
+                        }
+                        nffile->blockInfo = blockInfo;
+                        nffile->maxBlockInfo = numBlockInfo;
+                    }
+                    memcpy((void *)&nffile->blockInfo[nffile->numBlockInfo], (void *)blockDir->entry, blockDir->numEntries * sizeof(blockInfo_t));
+                    nffile->numBlockInfo = numBlockInfo;
+                } break;
+                case TYPE_ZONEMAP: {
+                    dbg_printf("Read zone maps from appendix block\n");
+                    zoneMapDir_t *zoneMapDir = (zoneMapDir_t *)data;
+                    if (dataSize < sizeof(zoneMapDir_t) || dataSize != (sizeof(zoneMapDir_t) + zoneMapDir->numEntries * sizeof(zoneMap_t)) ||
+                        zoneMapDir->firstBlock != nffile->numZoneMap) {
+                        LogError("Error processing appendix zone maps");
+                        break;
+                    }
+                    uint32_t numZoneMap = nffile->numZoneMap + zoneMapDir->numEntries;
+                    if (numZoneMap > nffile->maxZoneMap) {
+                        zoneMap_t *zoneMap = realloc(nffile->zoneMap, numZoneMap * sizeof(zoneMap_t));
+                        if (!zoneMap) {
+                            LogError("realloc() error in %s line %d: %s", __FILE__, __LINE__, strerror(errno));
+                            break;
+                        }
+                        nffile->zoneMap = zoneMap;
+                        nffile->maxZoneMap = numZoneMap;
+                    }
+                    memcpy((void *)&nffile->zoneMap[nffile->numZoneMap], (void *)zoneMapDir->entry, zoneMapDir->numEntries * sizeof(zoneMap_t));
+                    nffile->numZoneMap = numZoneMap;
+                } break;
+                case TYPE_CHECKSUM: {
+                    dbg_printf("Read block checksums from appendix block\n");
+                    checksumDir_t *checksumDir = (checksumDir_t *)data;
+                    if (dataSize < sizeof(checksumDir_t) || dataSize != (sizeof(checksumDir_t) + checksumDir->numEntries * sizeof(uint32_t)) ||
+                        checksumDir->firstBlock != nffile->numChecksum) {
+                        LogError("Error processing appendix block checksums");
+                        break;
+                    }
+                    uint32_t numChecksum = nffile->numChecksum + checksumDir->numEntries;
+                    if (numChecksum > nffile->maxChecksum) {
+                        uint32_t *checksum = realloc(nffile->checksum, numChecksum * sizeof(uint32_t));
+                        if (!checksum) {
+                            LogError("realloc() error in %s line %d: %s", __FILE__, __LINE__, strerror(errno));
+                            break;
+                        }
+                        nffile->checksum = checksum;
+                        nffile->maxChecksum = numChecksum;
+                    }
+                    memcpy((void *)&nffile->checksum[nffile->numChecksum], (void *)checksumDir->entry, checksumDir->numEntries * sizeof(uint32_t));
+                    nffile->numChecksum = numChecksum;
+                } break;
+                case TYPE_BLOOMFILTER: {
+                    dbg_printf("Read Bloom filter from appendix block\n");
+                    bloomFilter_t *bloomFilter = (bloomFilter_t *)data;
+                    uint32_t numBits = bloomFilter->numBits;
+                    uint32_t numBlocks = nffile->file_header->NumBlocks;
+                    if (dataSize < sizeof(bloomFilter_t) || numBits < 64 || (numBits & (numBits - 1)) || dataSize != (sizeof(bloomFilter_t) + numBits / 8) ||
+                        bloomFilter->numHash == 0 || bloomFilter->numHash > 16 || bloomFilter->blockNum >= numBlocks) {
+                        LogError("Error processing appendix Bloom filter");
+                        break;
+                    }
+                    if (numBlocks > nffile->maxBloomFilter) {
+                        bloomFilter_t **p = realloc(nffile->bloomFilter, numBlocks * sizeof(bloomFilter_t *));
+                        if (!p) {
+                            LogError("realloc() error in %s line %d: %s", __FILE__, __LINE__, strerror(errno));
+                            break;
+                        }
+                        nffile->bloomFilter = p;
+                        nffile->maxBloomFilter = numBlocks;
+                    }
+                    // blocks without Bloom filter are NULL
+                    for (; nffile->numBloomFilter < numBlocks; nffile->numBloomFilter++) nffile->bloomFilter[nffile->numBloomFilter] = NULL;
+                    bloomFilter_t *copy = malloc(dataSize);
+                    if (!copy) {
+                        LogError("malloc() error in %s line %d: %s", __FILE__, __LINE__, strerror(errno));
+                        break;
+                    }
+                    memcpy((void *)copy, data, dataSize);
+                    if (nffile->bloomFilter[copy->blockNum]) free(nffile->bloomFilter[copy->blockNum]);
+                    nffile->bloomFilter[copy->blockNum] = copy;
+                } break;
+                case TYPE_DICTIONARY: {
+                    dbg_printf("Read compression dictionary from appendix block\n");
+                    dictionary_t *dictionary = (dictionary_t *)data;
+                    if (dataSize < sizeof(dictionary_t) || dataSize != (sizeof(dictionary_t) + dictionary->size) ||
+                        dictionary->size > DICTIONARY_SIZE || dictionary->compression != nffile->file_header->compression) {
+                        LogError("Error processing appendix compression dictionary");
+                        break;
+                    }
+                    FreeDictionary(nffile);
+                    nffile->dictionary = NewDictionary(dictionary->compression, (void *)dictionary->data, dictionary->size);
+                } break;
                 default:
-                    LogError("Error process appendix record type: %u", record_header->type);
+                    // appendix records of newer versions are optional - skip them
+                    LogVerbose("Skip unknown appendix record type: %u", record_header->type);
             }
             processed += record_header->size;
             buff_ptr += record_header->size;
             if (processed > block_header->size) {
                 LogError("Error processing appendix records: processed %u > block size %u", processed, block_header->size);
                 FreeDataBlock(block_header);
+                nffile->numBlockInfo = 0;
                 return 0;
             }
         }
         FreeDataBlock(block_header);
     }
 
+    // the block directory is only usable, if it describes all data blocks
+    if (nffile->numZoneMap != nffile->file_header->NumBlocks) nffile->numZoneMap = 0;
+    if (nffile->numChecksum != nffile->file_header->NumBlocks) nffile->numChecksum = 0;
+    if (nffile->numBloomFilter != nffile->file_header->NumBlocks) FreeBloomFilters(nffile);
+    if (nffile->numBlockInfo != nffile->file_header->NumBlocks) {
+        nffile->numBlockInfo = 0;
+    } else {
+        off_t offset = sizeof(fileHeaderV2_t);
+        for (uint32_t i = 0; i < nffile->numBlockInfo; i++) {
+            blockInfo_t *blockInfo = &nffile->blockInfo[i];
+            if (blockInfo->offset < offset || (blockInfo->offset + sizeof(dataBlock_t) + blockInfo->size) > nffile->file_header->offAppendix) {
+                LogError("Corrupt block directory in file: %s", nffile->fileName);
+                nffile->numBlockInfo = 0;
+                nffile->numZoneMap = 0;
+                nffile->numChecksum = 0;
+                FreeBloomFilters(nffile);
+                break;
+            }
+            offset = blockInfo->offset + sizeof(dataBlock_t) + blockInfo->size;
+        }
+    }
+
     // seek back to currentPos
     off_t backPosition = lseek(nffile->fd, currentPos, SEEK_SET);
     dbg_printf("Reset position to %lld -> %lld\n", (long long)currentPos, (long long)backPosition);
@@ -605,6 +1093,27 @@ static int ReadAppendix(nffile_t *nffile) {
 
 }  // End of ReadAppendix
 
+// reserve an appendix record with dataSize bytes of data in the appendix block
+// if the block is full, it gets written and a new appendix block is started
+static recordHeader_t *AppendixRecord(nffile_t *nffile, dataBlock_t *dataBlock, uint16_t type, size_t dataSize) {
+    size_t required = sizeof(recordHeader_t) + dataSize;
+    if (!IsAvailable(dataBlock, required)) {
+        if (!nfwrite(nffile, dataBlock, NULL)) return NULL;
+        InitDataBlock(dataBlock);
+        nffile->file_header->appendixBlocks++;
+    }
+
+    recordHeader_t *recordHeader = (recordHeader_t *)GetCurrentCursor(dataBlock);
+    recordHeader->type = type;
+    recordHeader->size = required;
+
+    dataBlock->NumRecords++;
+    dataBlock->size += required;
+
+    return recordHeader;
+
+}  // End of AppendixRecord
+
 // Write appendix - assume current file pos is end of data blocks
 static int WriteAppendix(nffile_t *nffile) {
     dbg_printf("Write Appendix\n");
@@ -618,43 +1127,101 @@ static int WriteAppendix(nffile_t *nffile) {
     // set appendx info
     nffile->file_header->offAppendix = currentPos;
     nffile->file_header->appendixBlocks = 1;
+    uint32_t numBlocks = nffile->file_header->NumBlocks;
 
     // make sure ident is set
     if (nffile->ident == NULL) nffile->ident = strdup("none");
 
     dataBlock_t *block_header = NewDataBlock();
-    void *buff_ptr = (void *)((void *)block_header + sizeof(dataBlock_t));
 
     // write ident
-    recordHeader_t *recordHeader = (recordHeader_t *)buff_ptr;
+    recordHeader_t *recordHeader = AppendixRecord(nffile, block_header, TYPE_IDENT, strlen(nffile->ident) + 1);
     void *data = (void *)recordHeader + sizeof(recordHeader_t);
-
-    recordHeader->type = TYPE_IDENT;
-    recordHeader->size = sizeof(recordHeader_t) + strlen(nffile->ident) + 1;
     strcpy(data, nffile->ident);
 
-    block_header->NumRecords++;
-    block_header->size += recordHeader->size;
-    buff_ptr += recordHeader->size;
-
     // write stat record
-    recordHeader = (recordHeader_t *)buff_ptr;
+    recordHeader = AppendixRecord(nffile, block_header, TYPE_STAT, sizeof(stat_record_t));
     data = (void *)recordHeader + sizeof(recordHeader_t);
-
-    recordHeader->type = TYPE_STAT;
-    recordHeader->size = sizeof(recordHeader_t) + sizeof(stat_record_t);
     // in case of an empty stat record
     if (nffile->stat_record->firstseen == 0x7fffffffffffffffLL) nffile->stat_record->firstseen = 0;
     memcpy(data, nffile->stat_record, sizeof(stat_record_t));
 
-    block_header->NumRecords++;
-    block_header->size += recordHeader->size;
-    buff_ptr += recordHeader->size;
+    // write compression dictionary
+    if (nffile->dictionary) {
+        dictionary_t *dictionary = nffile->dictionary->dictionary;
+        size_t dictSize = sizeof(dictionary_t) + dictionary->size;
+        recordHeader = AppendixRecord(nffile, block_header, TYPE_DICTIONARY, dictSize);
+        if (!recordHeader) {
+            FreeDataBlock(block_header);
+            return 0;
+        }
+        memcpy((void *)recordHeader + sizeof(recordHeader_t), (void *)dictionary, dictSize);
+    }
+
+    // write block directory, if all data blocks are described
+    if (nffile->numBlockInfo && nffile->numBlockInfo == numBlocks) {
+        for (uint32_t i = 0; i < nffile->numBlockInfo; i += BLOCKDIR_CHUNK) {
+            uint32_t numEntries = nffile->numBlockInfo - i;
+            if (numEntries > BLOCKDIR_CHUNK) numEntries = BLOCKDIR_CHUNK;
+            recordHeader = AppendixRecord(nffile, block_header, TYPE_BLOCKDIR, sizeof(blockDir_t) + numEntries * sizeof(blockInfo_t));
+            if (!recordHeader) {
+                FreeDataBlock(block_header);
+                return 0;
+            }
+            blockDir_t *blockDir = (blockDir_t *)((void *)recordHeader + sizeof(recordHeader_t));
+            blockDir->firstBlock = i;
+            blockDir->numEntries = numEntries;
+            memcpy((void *)blockDir->entry, (void *)&nffile->blockInfo[i], numEntries * sizeof(blockInfo_t));
+        }
+
+        // write zone maps, if all blocks have one
+        for (uint32_t i = 0; nffile->numZoneMap == numBlocks && i < nffile->numZoneMap; i += ZONEMAP_CHUNK) {
+            uint32_t numEntries = nffile->numZoneMap - i;
+            if (numEntries > ZONEMAP_CHUNK) numEntries = ZONEMAP_CHUNK;
+            recordHeader = AppendixRecord(nffile, block_header, TYPE_ZONEMAP, sizeof(zoneMapDir_t) + numEntries * sizeof(zoneMap_t));
+            if (!recordHeader) {
+                FreeDataBlock(block_header);
+                return 0;
+            }
+            zoneMapDir_t *zoneMapDir = (zoneMapDir_t *)((void *)recordHeader + sizeof(recordHeader_t));
+            zoneMapDir->firstBlock = i;
+            zoneMapDir->numEntries = numEntries;
+            memcpy((void *)zoneMapDir->entry, (void *)&nffile->zoneMap[i], numEntries * sizeof(zoneMap_t));
+        }
+
+        // write block checksums, if all blocks have one
+        for (uint32_t i = 0; nffile->numChecksum == numBlocks && i < nffile->numChecksum; i += CHECKSUM_CHUNK) {
+            uint32_t numEntries = nffile->numChecksum - i;
+            if (numEntries > CHECKSUM_CHUNK) numEntries = CHECKSUM_CHUNK;
+            recordHeader = AppendixRecord(nffile, block_header, TYPE_CHECKSUM, sizeof(checksumDir_t) + numEntries * sizeof(uint32_t));
+            if (!recordHeader) {
+                FreeDataBlock(block_header);
+                return 0;
+            }
+            checksumDir_t *checksumDir = (checksumDir_t *)((void *)recordHeader + sizeof(recordHeader_t));
+            checksumDir->firstBlock = i;
+            checksumDir->numEntries = numEntries;
+            memcpy((void *)checksumDir->entry, (void *)&nffile->checksum[i], numEntries * sizeof(uint32_t));
+        }
+
+        // write Bloom filters
+        for (uint32_t i = 0; nffile->numBloomFilter == numBlocks && i < nffile->numBloomFilter; i++) {
+            bloomFilter_t *bloomFilter = nffile->bloomFilter[i];
+            if (bloomFilter == NULL) continue;
+            size_t bloomSize = sizeof(bloomFilter_t) + bloomFilter->numBits / 8;
+            recordHeader = AppendixRecord(nffile, block_header, TYPE_BLOOMFILTER, bloomSize);
+            if (!recordHeader) {
+                FreeDataBlock(block_header);
+                return 0;
+            }
+            memcpy((void *)recordHeader + sizeof(recordHeader_t), (void *)bloomFilter, bloomSize);
+        }
+    }
 
-    nfwrite(nffile, block_header);
+    int ok = nfwrite(nffile, block_header, NULL);
     FreeDataBlock(block_header);
 
-    return 1;
+    return ok;
 
 }  // End of WriteAppendix
 
@@ -691,6 +1258,18 @@ nffile_t *NewFile(nffile_t *nffile) {
             return NULL;
         }
         queue_close(nffile->processQueue);
+
+        // raw blocks for decompress workers
+        nffile->blockQueue = queue_init(QueueSize);
+        if (!nffile->blockQueue) {
+            return NULL;
+        }
+        queue_close(nffile->blockQueue);
+        pthread_mutex_init(&nffile->rlock, NULL);
+        pthread_cond_init(&nffile->rcond, NULL);
+
+        // adaptive compression starts with the max level of the file
+        atomic_init(&nffile->adaptLevel, INT_MAX);
     } else {
         compression = nffile->file_header->compression;
         encryption = nffile->file_header->encryption;
@@ -704,6 +1283,7 @@ nffile_t *NewFile(nffile_t *nffile) {
 
     nffile->fd = 0;
     nffile->compat16 = 0;
+    nffile->columnar = 0;
 
     if (nffile->fileName) {
         free(nffile->fileName);
@@ -716,6 +1296,13 @@ nffile_t *NewFile(nffile_t *nffile) {
     memset((void *)nffile->stat_record, 0, sizeof(stat_record_t));
     nffile->stat_record->firstseen = 0x7fffffffffffffff;
 
+    nffile->numBlockInfo = 0;
+    nffile->numZoneMap = 0;
+    nffile->numChecksum = 0;
+    FreeBloomFilters(nffile);
+    nffile->skippedBlocks = 0;
+    nffile->corruptBlocks = 0;
+
     for (int i = 0; i < MAXWORKERS; i++) nffile->worker[i] = 0;
     atomic_store(&nffile->terminate, 0);
     pthread_mutex_init(&nffile->wlock, NULL);
@@ -866,6 +1453,8 @@ static nffile_t *OpenFileStatic(char *filename, nffile_t *nffile) {
     }
 #endif
 
+    // a dictionary of a previous file is invalid
+    FreeDictionary(nffile);
     if (nffile->file_header->appendixBlocks) {
         if (nffile->file_header->offAppendix < stat_buf.st_size) {
             ReadAppendix(nffile);
@@ -886,11 +1475,38 @@ nffile_t *OpenFile(char *filename, nffile_t *nffile) {
         return NULL;
     }
 
+    // uncompressed blocks are read zero copy from the mapped file
+    if (nffile->file_header->compression == NOT_COMPRESSED && nffile->file_header->NumBlocks) MapFile(nffile);
+
+    // compressed files get decompressed by NumWorkers in parallel
+    // the reader thread reads the raw blocks and feeds the workers
+    unsigned numDecompressors = 0;
+    if (nffile->file_header->compression != NOT_COMPRESSED) {
+        numDecompressors = NumWorkers;
+        if (numDecompressors > nffile->file_header->NumBlocks) numDecompressors = nffile->file_header->NumBlocks;
+        if (numDecompressors > (MAXWORKERS - 1)) numDecompressors = MAXWORKERS - 1;
+    }
+
+    // reset reorder ring
+    nffile->nextBlock = 0;
+    nffile->blockFailed = 0;
+    nffile->ringSize = 2 * numDecompressors + QueueSize;
+    if (nffile->ringSize > BLOCKRING) nffile->ringSize = BLOCKRING;
+    for (int i = 0; i < BLOCKRING; i++) nffile->blockRing[i] = NULL;
+
+    // set before any thread is started - nfreader selects its mode by numDecompressors
+    nffile->numDecompressors = numDecompressors;
+    atomic_store(&nffile->terminate, 0);
+    queue_open(nffile->processQueue);
+    queue_producers(nffile->processQueue, numDecompressors ? numDecompressors : 1);
+    if (numDecompressors) {
+        queue_open(nffile->blockQueue);
+        queue_producers(nffile->blockQueue, 1);
+    }
+
     // kick off nfreader
     // there is only 1 reader thread -> slot 0
     pthread_t tid;
-    atomic_store(&nffile->terminate, 0);
-    queue_open(nffile->processQueue);
     int err = pthread_create(&tid, NULL, nfreader, (void *)nffile);
     if (err) {
         nffile->worker[0] = 0;
@@ -898,10 +1514,184 @@ nffile_t *OpenFile(char *filename, nffile_t *nffile) {
         return NULL;
     }
     nffile->worker[0] = tid;
+
+    // decompress workers -> slot 1 .. numDecompressors
+    for (unsigned i = 1; i <= numDecompressors; i++) {
+        err = pthread_create(&tid, NULL, nfdecompressor, (void *)nffile);
+        if (err) {
+            nffile->worker[i] = 0;
+            LogError("pthread_create() error in %s line %d: %s", __FILE__, __LINE__, strerror(errno));
+            return NULL;
+        }
+        nffile->worker[i] = tid;
+    }
+
     return nffile;
 
 }  // End of OpenFile
 
+// build the block directory of a file without directory in the appendix from the block headers.
+// Blocks are flagged BLOCKINFO_META, so they are never skipped by a block check
+static int ScanBlockDirectory(nffile_t *nffile) {
+    off_t offset = lseek(nffile->fd, 0, SEEK_CUR);
+    if (offset < 0) {
+        LogError("lseek() error in %s line %d: %s", __FILE__, __LINE__, strerror(errno));
+        return 0;
+    }
+
+    uint32_t numBlocks = nffile->file_header->NumBlocks;
+    if (numBlocks > nffile->maxBlockInfo) {
+        blockInfo_t *p = realloc(nffile->blockInfo, numBlocks * sizeof(blockInfo_t));
+        if (!p) {
+            LogError("realloc() error in %s line %d: %s", __FILE__, __LINE__, strerror(errno));
+            return 0;
+        }
+        nffile->blockInfo = p;
+        nffile->maxBlockInfo = numBlocks;
+    }
+
+    // zone maps, Bloom filters and checksums do not match the new directory
+    nffile->numZoneMap = 0;
+    nffile->numChecksum = 0;
+    FreeBloomFilters(nffile);
+    nffile->numBlockInfo = 0;
+    for (uint32_t i = 0; i < numBlocks; i++) {
+        dataBlock_t dataBlock;
+        if (pread(nffile->fd, (void *)&dataBlock, sizeof(dataBlock_t), offset) != sizeof(dataBlock_t)) {
+            LogError("Corrupt data file %s: Unexpected EOF in block %u", nffile->fileName, i);
+            return 0;
+        }
+        blockInfo_t *blockInfo = &nffile->blockInfo[i];
+        memset((void *)blockInfo, 0, sizeof(blockInfo_t));
+        blockInfo->offset = offset;
+        blockInfo->size = dataBlock.size;
+        blockInfo->NumRecords = dataBlock.NumRecords;
+        blockInfo->type = dataBlock.type;
+        blockInfo->flags = BLOCKINFO_META;
+        offset += sizeof(dataBlock_t) + dataBlock.size;
+    }
+    nffile->numBlockInfo = numBlocks;
+
+    return 1;
+
+}  // End of ScanBlockDirectory
+
+// open a file for random block access with ReadBlockAt() or a block iterator.
+// No reader thread is started - blocks are read and uncompressed on the caller's thread.
+// Files without block directory get the directory built from the block headers
+nffile_t *OpenFileBlocks(char *filename, nffile_t *nffile) {
+    nffile = OpenFileStatic(filename, nffile);
+    if (!nffile) return NULL;
+
+    if (nffile->numBlockInfo != nffile->file_header->NumBlocks && !ScanBlockDirectory(nffile)) {
+        CloseFile(nffile);
+        return NULL;
+    }
+
+    return nffile;
+
+}  // End of OpenFileBlocks
+
+// return the number of data blocks, which may be read with ReadBlockAt()
+uint32_t NumDataBlocks(nffile_t *nffile) {
+    return nffile->numBlockInfo == nffile->file_header->NumBlocks ? nffile->numBlockInfo : 0;
+
+}  // End of NumDataBlocks
+
+// read and uncompress data block blockNum on the caller's thread. The file position
+// is not changed, so several threads may read blocks of the same file concurrently.
+// Returns NULL, if the block does not exist or can not be read
+dataBlock_t *ReadBlockAt(nffile_t *nffile, uint32_t blockNum) {
+    if (blockNum >= NumDataBlocks(nffile)) return NULL;
+
+    blockInfo_t *blockInfo = &nffile->blockInfo[blockNum];
+    if (blockInfo->size == 0 || blockInfo->size > (BUFFSIZE - sizeof(dataBlock_t))) {
+        LogError("Corrupt data file %s: Error buffer size %u in block %u", nffile->fileName, blockInfo->size, blockNum);
+        return NULL;
+    }
+
+    dataBlock_t *buff = NewDataBlock();
+    if (!buff) return NULL;
+
+    size_t size = sizeof(dataBlock_t) + blockInfo->size;
+    ssize_t ret = pread(nffile->fd, (void *)buff, size, blockInfo->offset);
+    if (ret < 0) {
+        LogError("pread() error in %s line %d: %s", __FILE__, __LINE__, strerror(errno));
+        FreeDataBlock(buff);
+        return NULL;
+    }
+    if ((size_t)ret != size || buff->size != blockInfo->size || buff->NumRecords == 0) {
+        LogError("Corrupt data file %s: Error reading block %u", nffile->fileName, blockNum);
+        FreeDataBlock(buff);
+        return NULL;
+    }
+    if (!VerifyBlock(nffile, blockNum, buff)) {
+        LogError("Corrupt data file %s: Checksum error in block %u", nffile->fileName, blockNum);
+        FreeDataBlock(buff);
+        return NULL;
+    }
+
+    return nfuncompress(nffile, buff);
+
+}  // End of ReadBlockAt
+
+// check block blockNum against the block check installed with SetBlockCheck().
+// Returns 1, if the block can be skipped without reading it
+int SkipBlock(nffile_t *nffile, uint32_t blockNum) {
+    if (blockCheck == NULL || blockNum >= NumDataBlocks(nffile)) return 0;
+
+    blockInfo_t *blockInfo = &nffile->blockInfo[blockNum];
+    if (blockInfo->flags & BLOCKINFO_META) return 0;
+
+    zoneMap_t *zoneMap = nffile->numZoneMap == nffile->numBlockInfo ? &nffile->zoneMap[blockNum] : NULL;
+    bloomFilter_t *bloomFilter = nffile->numBloomFilter == nffile->numBlockInfo ? nffile->bloomFilter[blockNum] : NULL;
+    return blockCheck(blockInfo, zoneMap, bloomFilter, blockCheckArg) == 0;
+
+}  // End of SkipBlock
+
+// iterate over the blocks [first, last) of a file opened with OpenFileBlocks().
+// Each iterator reads on its own, so different ranges may be processed in parallel
+void InitBlockIterator(blockIterator_t *blockIterator, nffile_t *nffile, uint32_t first, uint32_t last) {
+    uint32_t numBlocks = NumDataBlocks(nffile);
+    if (last > numBlocks) last = numBlocks;
+    if (first > last) first = last;
+
+    blockIterator->nffile = nffile;
+    blockIterator->next = first;
+    blockIterator->end = last;
+
+}  // End of InitBlockIterator
+
+// set the next block of the iterator. Returns 0, if blockNum is out of range
+int SeekBlock(blockIterator_t *blockIterator, uint32_t blockNum) {
+    if (blockNum > blockIterator->end) return 0;
+    blockIterator->next = blockNum;
+    return 1;
+
+}  // End of SeekBlock
+
+// return the next block of the iterator. Same as ReadBlock(), dataBlock is freed
+// Returns NULL at the end of the range or on error
+dataBlock_t *NextBlock(blockIterator_t *blockIterator, dataBlock_t *dataBlock) {
+    if (dataBlock) FreeDataBlock(dataBlock);
+    if (blockIterator->next >= blockIterator->end) return NULL;
+
+    return ReadBlockAt(blockIterator->nffile, blockIterator->next++);
+
+}  // End of NextBlock
+
+// reset the ordered block commit for numWriters nfwriter threads
+static void ResetWriteRing(nffile_t *nffile, unsigned numWriters) {
+    // blocks are numbered by their position in the processQueue
+    nffile->writeBase = queue_position(nffile->processQueue);
+    nffile->nextBlock = 0;
+    nffile->committing = 0;
+    nffile->ringSize = 2 * numWriters + QueueSize;
+    if (nffile->ringSize > BLOCKRING) nffile->ringSize = BLOCKRING;
+    for (int i = 0; i < BLOCKRING; i++) nffile->writeRing[i] = NULL;
+
+}  // End of ResetWriteRing
+
 // Create a new nffile
 //  filename   : full path of file to create
 //  nffile     : Use nffile handle and initialize it accordingly. If NULL a new handle is alocated
@@ -954,6 +1744,13 @@ nffile_t *OpenNewFile(char *filename, nffile_t *nffile, int creator, int compres
         nffile->file_header->encryption = encryption;
     }
 
+    // a reused handle compresses the new file with a dictionary trained from the previous file
+    if (trainDictionary)
+        TrainDictionary(nffile);
+    else
+        FreeDictionary(nffile);
+    PrepareDictionary(nffile);
+
     dbg_printf("OpenNewFile compression: %d, level: %d\n", nffile->file_header->compression, nffile->compression_level);
 
     if (write(nffile->fd, (void *)nffile->file_header, sizeof(fileHeaderV2_t)) < sizeof(fileHeaderV2_t)) {
@@ -969,6 +1766,8 @@ nffile_t *OpenNewFile(char *filename, nffile_t *nffile, int creator, int compres
 
     // if file is not compressed, 2 workers are fine.
     unsigned NumThreads = nffile->file_header->compression == 0 ? 2 : NumWorkers;
+    ResetWriteRing(nffile, NumThreads);
+    nffile->cacheOffset = 0;
     for (unsigned i = 0; i < NumThreads; i++) {
         pthread_t tid;
         int err = pthread_create(&tid, NULL, nfwriter, (void *)nffile);
@@ -1022,11 +1821,16 @@ nffile_t *AppendFile(char *filename) {
         }
     }
 
+    // new blocks are compressed with the dictionary of the file, if any
+    PrepareDictionary(nffile);
+
     // kick off NumWorkers nfwriter threads
     atomic_store(&nffile->terminate, 0);
     queue_open(nffile->processQueue);
 
     unsigned NumThreads = nffile->file_header->compression == 0 ? 1 : NumWorkers;
+    ResetWriteRing(nffile, NumThreads);
+    nffile->cacheOffset = 0;
     for (unsigned i = 0; i < NumThreads; i++) {
         pthread_t tid;
         int err = pthread_create(&tid, NULL, nfwriter, (void *)nffile);
@@ -1113,14 +1917,16 @@ void CloseFile(nffile_t *nffile) {
     if (!nffile || nffile->fd == 0) return;
 
     // make sure all workers are gone
-    for (unsigned i = 0; i < NumWorkers; i++) {
+    for (unsigned i = 0; i < MAXWORKERS; i++) {
         if (nffile->worker[i]) {
             SignalTerminate(nffile);
+            break;
         }
     }
 
     close(nffile->fd);
     nffile->fd = 0;
+    UnmapFile(nffile);
 
     if (nffile->fileName) {
         free(nffile->fileName);
@@ -1132,12 +1938,24 @@ void CloseFile(nffile_t *nffile) {
         nffile->ident = NULL;
     }
 
-    // clean queue
+    // clean queues
     queue_close(nffile->processQueue);
     while (queue_length(nffile->processQueue)) {
         dataBlock_t *block_header = queue_pop(nffile->processQueue);
         FreeDataBlock(block_header);
     }
+    queue_close(nffile->blockQueue);
+    while (queue_length(nffile->blockQueue)) {
+        blockJob_t *job = queue_pop(nffile->blockQueue);
+        FreeDataBlock(job->dataBlock);
+        free(job);
+    }
+    for (int i = 0; i < BLOCKRING; i++) {
+        if (nffile->blockRing[i] && nffile->blockRing[i] != BLOCK_FAILED) FreeDataBlock(nffile->blockRing[i]);
+        nffile->blockRing[i] = NULL;
+        FreeWriteJob(nffile->writeRing[i]);
+        nffile->writeRing[i] = NULL;
+    }
 
     nffile->file_header->NumBlocks = 0;
 }  // End of CloseFile
@@ -1170,6 +1988,10 @@ int CloseUpdateFile(nffile_t *nffile) {
         return 0;
     }
     fsync(nffile->fd);
+#ifdef HAVE_POSIX_FADVISE
+    // drop the rest of the file - header and appendix
+    if (dropCache) posix_fadvise(nffile->fd, 0, 0, POSIX_FADV_DONTNEED);
+#endif
     CloseFile(nffile);
 
     return 1;
@@ -1185,6 +2007,13 @@ void DisposeFile(nffile_t *nffile) {
     if (nffile->stat_record) free(nffile->stat_record);
     if (nffile->ident) free(nffile->ident);
     if (nffile->fileName) free(nffile->fileName);
+    if (nffile->blockInfo) free(nffile->blockInfo);
+    if (nffile->zoneMap) free(nffile->zoneMap);
+    if (nffile->checksum) free(nffile->checksum);
+    FreeBloomFilters(nffile);
+    if (nffile->bloomFilter) free(nffile->bloomFilter);
+    FreeDictionary(nffile);
+    if (nffile->dictSamples) free(nffile->dictSamples);
 
     queue_close(nffile->processQueue);
     for (size_t queueLen = queue_length(nffile->processQueue); queueLen > 0; queueLen--) {
@@ -1193,16 +2022,65 @@ void DisposeFile(nffile_t *nffile) {
     }
 
     queue_free(nffile->processQueue);
+    queue_close(nffile->blockQueue);
+    queue_free(nffile->blockQueue);
+    pthread_mutex_destroy(&nffile->rlock);
+    pthread_cond_destroy(&nffile->rcond);
     free(nffile);
 
 }  // End of DisposeFile
 
-nffile_t *GetNextFile(nffile_t *nffile) {
-    // close current file before open the next one
-    if (nffile) {
-        CloseFile(nffile);
-    } else {
-        nffile = NewFile(NULL);
+// ask the kernel to read ahead the parts of a file, which are read synchronously
+// on open: the file header, the first data blocks and the appendix
+static void PrefetchFile(char *filename) {
+#ifdef HAVE_POSIX_FADVISE
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) return;  // OpenFile() reports the error
+
+    posix_fadvise(fd, 0, PREFETCHSIZE, POSIX_FADV_WILLNEED);
+    fileHeaderV2_t fileHeader;
+    if (read(fd, (void *)&fileHeader, sizeof(fileHeaderV2_t)) == sizeof(fileHeaderV2_t) && fileHeader.magic == MAGIC &&
+        fileHeader.version == LAYOUT_VERSION_2 && fileHeader.appendixBlocks && fileHeader.offAppendix > 0) {
+        posix_fadvise(fd, fileHeader.offAppendix, 0, POSIX_FADV_WILLNEED);
+    }
+    close(fd);
+#endif
+}  // End of PrefetchFile
+
+// prefetch thread - takes the files from the file list and passes them to
+// GetNextFile() through the prefetch queue. The queue length limits the files in flight
+static void *nfprefetch(void *arg) {
+    queue_t *prefetchQueue = (queue_t *)arg;
+    queue_t *fileList = fileSource;
+
+    /* Signal handling */
+    sigset_t set = {0};
+    sigfillset(&set);
+    pthread_sigmask(SIG_SETMASK, &set, NULL);
+
+    while (1) {
+        char *nextFile = queue_pop(fileList);
+        if (nextFile == QUEUE_CLOSED) break;
+
+        PrefetchFile(nextFile);
+        if (queue_push(prefetchQueue, nextFile) == QUEUE_CLOSED) {
+            free(nextFile);
+            break;
+        }
+    }
+    queue_close(prefetchQueue);
+
+    dbg_printf("nfprefetch exit\n");
+    return NULL;
+
+}  // End of nfprefetch
+
+nffile_t *GetNextFile(nffile_t *nffile) {
+    // close current file before open the next one
+    if (nffile) {
+        CloseFile(nffile);
+    } else {
+        nffile = NewFile(NULL);
     }
 
     if (!fileQueue) {
@@ -1242,6 +2120,45 @@ dataBlock_t *ReadBlock(nffile_t *nffile, dataBlock_t *dataBlock) {
 
 // generic read und uncompress a data block from current position
 static dataBlock_t *nfread(nffile_t *nffile) {
+    if (nffile->fileMap) {
+        dataBlock_t *dataBlock = nfreadMap(nffile);
+        if (dataBlock) return dataBlock->type == DATA_BLOCK_TYPE_5 ? ExpandBlock(dataBlock) : dataBlock;
+    }
+
+    dataBlock_t *buff = nfreadRaw(nffile);
+    if (buff == NULL) return NULL;
+
+    return nfuncompress(nffile, buff);
+
+}  // End of nfread
+
+// return the number of the data block at offset from the block directory. -1 if not found
+static int64_t BlockNumber(nffile_t *nffile, off_t offset) {
+    uint32_t lo = 0;
+    uint32_t hi = nffile->numBlockInfo;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (nffile->blockInfo[mid].offset < (uint64_t)offset)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return (lo < nffile->numBlockInfo && nffile->blockInfo[lo].offset == (uint64_t)offset) ? lo : -1;
+
+}  // End of BlockNumber
+
+// verify the checksum of the raw data block blockNum. Blocks without checksum pass
+static int VerifyBlock(nffile_t *nffile, int64_t blockNum, dataBlock_t *buff) {
+    if (blockNum < 0 || blockNum >= nffile->numChecksum || nffile->numChecksum != nffile->numBlockInfo) return 1;
+    return Crc32c(0, (void *)buff, sizeof(dataBlock_t) + buff->size) == nffile->checksum[blockNum];
+
+}  // End of VerifyBlock
+
+// read a raw data block from current position
+static dataBlock_t *nfreadRaw(nffile_t *nffile) {
+    // the block number is needed to verify the checksum
+    off_t offset = nffile->numChecksum ? lseek(nffile->fd, 0, SEEK_CUR) : -1;
+
     dataBlock_t *buff = NewDataBlock();
     ssize_t ret = read(nffile->fd, buff, sizeof(dataBlock_t));
     if (ret == 0) {  // EOF
@@ -1272,48 +2189,17 @@ static dataBlock_t *nfread(nffile_t *nffile) {
         return NULL;
     }
 
-    int compression = nffile->file_header->compression;
-
     void *p = (void *)((void *)buff + sizeof(dataBlock_t));
     dbg_printf("ReadBlock - read: %u\n", buff->size);
     ret = read(nffile->fd, p, buff->size);
     if (ret == buff->size) {
-        dataBlock_t *block_header = NULL;
-        int failed = 0;
         // we have the whole record and are done for now
-        switch (compression) {
-            case NOT_COMPRESSED:
-                block_header = buff;
-                break;
-            case LZO_COMPRESSED:
-                block_header = NewDataBlock();
-                if (Uncompress_Block_LZO(buff, block_header, nffile->buff_size) < 0) failed = 1;
-                FreeDataBlock(buff);
-                break;
-            case LZ4_COMPRESSED:
-                block_header = NewDataBlock();
-                if (Uncompress_Block_LZ4(buff, block_header, nffile->buff_size) < 0) failed = 1;
-                FreeDataBlock(buff);
-                break;
-            case BZ2_COMPRESSED:
-                block_header = NewDataBlock();
-                if (Uncompress_Block_BZ2(buff, block_header, nffile->buff_size) < 0) failed = 1;
-                FreeDataBlock(buff);
-                break;
-            case ZSTD_COMPRESSED:
-                block_header = NewDataBlock();
-                if (Uncompress_Block_ZSTD(buff, block_header, nffile->buff_size) < 0) failed = 1;
-                FreeDataBlock(buff);
-                break;
-        }
-
-        if (failed) {
-            FreeDataBlock(block_header);
+        if (offset >= 0 && !VerifyBlock(nffile, BlockNumber(nffile, offset), buff)) {
+            LogError("Corrupt data file %s: Checksum error in block at offset %lld", nffile->fileName, (long long)offset);
+            FreeDataBlock(buff);
             return NULL;
         }
-        // success - done
-        return block_header;
-
+        return buff;
     } else if (ret == 0) {
         LogError("ReadBlock() Corrupt data file: Unexpected EOF while reading data block");
     } else if (ret == -1) {  // ERROR
@@ -1325,7 +2211,176 @@ static dataBlock_t *nfread(nffile_t *nffile) {
     FreeDataBlock(buff);
     return NULL;
 
-}  // End of nfread
+}  // End of nfreadRaw
+
+// return the data block at the current position from the file map without copying it.
+// Returns NULL, if the block is not available in the map. nfreadRaw() handles it then
+static dataBlock_t *nfreadMap(nffile_t *nffile) {
+    fileMap_t *fileMap = nffile->fileMap;
+    off_t offset = lseek(nffile->fd, 0, SEEK_CUR);
+    // records are expected to be 32bit aligned
+    if (offset < 0 || (offset & 0x3) || (offset + sizeof(dataBlock_t)) > fileMap->size) return NULL;
+
+    dataBlock_t *dataBlock = (dataBlock_t *)(fileMap->addr + offset);
+    size_t blockEnd = offset + sizeof(dataBlock_t) + dataBlock->size;
+    if (dataBlock->size > (BUFFSIZE - sizeof(dataBlock_t)) || dataBlock->size == 0 || dataBlock->NumRecords == 0 || blockEnd > fileMap->size)
+        return NULL;
+
+    // a corrupt block is reported by nfreadRaw()
+    if (nffile->numChecksum && !VerifyBlock(nffile, BlockNumber(nffile, offset), dataBlock)) return NULL;
+
+    if (lseek(nffile->fd, blockEnd, SEEK_SET) < 0) {
+        LogError("lseek() error in %s line %d: %s", __FILE__, __LINE__, strerror(errno));
+        return NULL;
+    }
+
+    // keep the prefetch window ahead of the reader
+    if ((blockEnd + MMAP_PREFETCH / 2) > fileMap->advised) {
+        size_t pageSize = sysconf(_SC_PAGESIZE);
+        size_t start = offset & ~(pageSize - 1);
+        size_t end = blockEnd + MMAP_PREFETCH;
+        if (end > fileMap->size) end = fileMap->size;
+        madvise(fileMap->addr + start, end - start, MADV_WILLNEED);
+        fileMap->advised = end;
+    }
+
+    pthread_mutex_lock(&mapLock);
+    fileMap->refCnt++;
+    pthread_mutex_unlock(&mapLock);
+    atomic_fetch_add(&blocksInUse, 1);
+
+    dbg_printf("ReadBlock - mapped: %u\n", dataBlock->size);
+    return dataBlock;
+
+}  // End of nfreadMap
+
+// convert a columnar block back into a row block. The columnar block is consumed
+static dataBlock_t *ExpandBlock(dataBlock_t *columnBlock) {
+    dataBlock_t *rowBlock = NewDataBlock();
+    if (rowBlock && RowBlock(columnBlock, rowBlock, BUFFSIZE) == 0) {
+        LogError("Corrupt data file: Error expanding columnar data block");
+        FreeDataBlock(rowBlock);
+        rowBlock = NULL;
+    }
+    FreeDataBlock(columnBlock);
+    return rowBlock;
+
+}  // End of ExpandBlock
+
+// uncompress a raw data block according to the file compression
+// the raw block is consumed. Returns the uncompressed block or NULL on error
+static dataBlock_t *nfuncompress(nffile_t *nffile, dataBlock_t *buff) {
+    compressDict_t *dict = NULL;
+    if (TestFlag(buff->flags, FLAG_BLOCK_DICTIONARY)) {
+        dict = nffile->dictionary;
+        if (!dict) {
+            LogError("Missing compression dictionary for data block in file: %s", nffile->fileName);
+            FreeDataBlock(buff);
+            return NULL;
+        }
+    }
+
+    // blocks may be stored uncompressed in a compressed file
+    int compression = nffile->file_header->compression;
+    if (TestFlag(buff->flags, FLAG_BLOCK_UNCOMPRESSED)) compression = NOT_COMPRESSED;
+
+    dataBlock_t *block_header = NULL;
+    int failed = 0;
+    switch (compression) {
+        case NOT_COMPRESSED:
+            block_header = buff;
+            break;
+        case LZO_COMPRESSED:
+            block_header = NewDataBlock();
+            if (Uncompress_Block_LZO(buff, block_header, nffile->buff_size) < 0) failed = 1;
+            FreeDataBlock(buff);
+            break;
+        case LZ4_COMPRESSED:
+            block_header = NewDataBlock();
+            if (Uncompress_Block_LZ4(buff, block_header, nffile->buff_size, dict) < 0) failed = 1;
+            FreeDataBlock(buff);
+            break;
+        case BZ2_COMPRESSED:
+            block_header = NewDataBlock();
+            if (Uncompress_Block_BZ2(buff, block_header, nffile->buff_size) < 0) failed = 1;
+            FreeDataBlock(buff);
+            break;
+        case ZSTD_COMPRESSED:
+            block_header = NewDataBlock();
+            if (Uncompress_Block_ZSTD(buff, block_header, nffile->buff_size, dict) < 0) failed = 1;
+            FreeDataBlock(buff);
+            break;
+        default:
+            LogError("Unknown compression ID: %d", compression);
+            FreeDataBlock(buff);
+            failed = 1;
+    }
+
+    if (failed) {
+        FreeDataBlock(block_header);
+        return NULL;
+    }
+    ClearFlag(block_header->flags, FLAG_BLOCK_DICTIONARY);
+    ClearFlag(block_header->flags, FLAG_BLOCK_UNCOMPRESSED);
+
+    if (block_header->type == DATA_BLOCK_TYPE_5) return ExpandBlock(block_header);
+
+    // success - done
+    return block_header;
+
+}  // End of nfuncompress
+
+// deliver decompressed blocks in file order to the processQueue.
+// Workers may finish in any order - blocks are parked in the reorder ring
+// until all preceding blocks are delivered
+static void CommitBlock(nffile_t *nffile, uint32_t seq, dataBlock_t *dataBlock) {
+    pthread_mutex_lock(&nffile->rlock);
+    // wait for a free slot in the ring
+    while ((seq - nffile->nextBlock) >= nffile->ringSize && atomic_load(&nffile->terminate) != 1) {
+        pthread_cond_wait(&nffile->rcond, &nffile->rlock);
+    }
+    if (atomic_load(&nffile->terminate) == 1) {
+        pthread_mutex_unlock(&nffile->rlock);
+        FreeDataBlock(dataBlock);
+        return;
+    }
+
+    nffile->blockRing[seq % nffile->ringSize] = dataBlock ? dataBlock : BLOCK_FAILED;
+
+    // push all blocks in sequence
+    uint32_t slot = nffile->nextBlock % nffile->ringSize;
+    while (nffile->blockRing[slot]) {
+        dataBlock_t *block = nffile->blockRing[slot];
+        nffile->blockRing[slot] = NULL;
+        nffile->nextBlock++;
+        if (block == BLOCK_FAILED) {
+            // stop delivering blocks - same as a read error
+            nffile->blockFailed = 1;
+        } else if (nffile->blockFailed || queue_push(nffile->processQueue, (void *)block) == QUEUE_CLOSED) {
+            FreeDataBlock(block);
+        }
+        slot = nffile->nextBlock % nffile->ringSize;
+    }
+    pthread_cond_broadcast(&nffile->rcond);
+    pthread_mutex_unlock(&nffile->rlock);
+
+}  // End of CommitBlock
+
+// skip the corrupt block blockNum and continue with the next block. Needs the block
+// directory to find the next block. Returns 0, if reading can not be continued
+static int ResyncBlock(nffile_t *nffile, uint32_t blockNum) {
+    uint32_t numBlocks = nffile->file_header->NumBlocks;
+    if (nffile->numBlockInfo != numBlocks || blockNum >= numBlocks) return 0;
+
+    LogError("Skip corrupt block %u in file %s", blockNum, nffile->fileName);
+    nffile->corruptBlocks++;
+    if ((blockNum + 1) < numBlocks && lseek(nffile->fd, nffile->blockInfo[blockNum + 1].offset, SEEK_SET) < 0) {
+        LogError("lseek() error in %s line %d: %s", __FILE__, __LINE__, strerror(errno));
+        return 0;
+    }
+    return 1;
+
+}  // End of ResyncBlock
 
 __attribute__((noreturn)) void *nfreader(void *arg) {
     nffile_t *nffile = (nffile_t *)arg;
@@ -1335,22 +2390,65 @@ __attribute__((noreturn)) void *nfreader(void *arg) {
     sigfillset(&set);
     pthread_sigmask(SIG_SETMASK, &set, NULL);
 
+    // blocks are decompressed by nfdecompressor workers, if any
+    int parallel = nffile->numDecompressors != 0;
+
+    // blocks described in the block directory may be skipped by the block check
+    int checkBlocks = blockCheck != NULL && nffile->numBlockInfo == nffile->file_header->NumBlocks;
+
     int terminate = atomic_load(&nffile->terminate);
-    int blockCount = 0;
+    uint32_t blockCount = 0;
+    uint32_t seq = 0;
     dataBlock_t *block_header = NULL;
     while (!terminate && blockCount < nffile->file_header->NumBlocks) {
-        block_header = nfread(nffile);
+        if (checkBlocks && SkipBlock(nffile, blockCount)) {
+            // skip block without reading it
+            blockInfo_t *blockInfo = &nffile->blockInfo[blockCount];
+            if (lseek(nffile->fd, blockInfo->offset + sizeof(dataBlock_t) + blockInfo->size, SEEK_SET) < 0) {
+                LogError("lseek() error in %s line %d: %s", __FILE__, __LINE__, strerror(errno));
+                break;
+            }
+            nffile->skippedBlocks++;
+            blockCount++;
+            continue;
+        }
+
+        if (parallel) {
+            block_header = nfreadRaw(nffile);
+        } else {
+            block_header = nfread(nffile);
+        }
         if (!block_header) {
             dbg_printf("block_header == NULL\n");
-            break;
+            // the block is corrupt, truncated or failed to uncompress
+            if (!ResyncBlock(nffile, blockCount)) break;
+            blockCount++;
+            continue;
         }
 
-        if (queue_push(nffile->processQueue, (void *)block_header) == QUEUE_CLOSED) {
+        void *closed = NULL;
+        if (parallel) {
+            blockJob_t *job = malloc(sizeof(blockJob_t));
+            if (!job) {
+                LogError("malloc() error in %s line %d: %s", __FILE__, __LINE__, strerror(errno));
+                FreeDataBlock(block_header);
+                break;
+            }
+            job->seq = seq;
+            job->dataBlock = block_header;
+            closed = queue_push(nffile->blockQueue, (void *)job);
+            if (closed == QUEUE_CLOSED) free(job);
+        } else {
+            closed = queue_push(nffile->processQueue, (void *)block_header);
+        }
+
+        if (closed == QUEUE_CLOSED) {
             FreeDataBlock(block_header);
             dbg_printf("nfreader - processQueue closed\n");
             terminate = 1;
         } else {
             blockCount++;
+            seq++;
             terminate = atomic_load(&nffile->terminate);
             dbg_printf("ReadBlock - expanded: %u\n", block_header->size);
             dbg_printf("Blocks: %u\n", blockCount);
@@ -1364,7 +2462,11 @@ __attribute__((noreturn)) void *nfreader(void *arg) {
     }
 
     // eof or error ends processing
-    queue_close(nffile->processQueue);
+    // with workers, the last worker closes the processQueue
+    if (parallel)
+        queue_close(nffile->blockQueue);
+    else
+        queue_close(nffile->processQueue);
 
     dbg_printf("nfreader done - read %u blocks\n", blockCount);
     dbg_printf("nfreader exit\n");
@@ -1374,6 +2476,38 @@ __attribute__((noreturn)) void *nfreader(void *arg) {
 
 }  // End of nfreader
 
+// decompress worker - takes raw blocks from the blockQueue and
+// commits the uncompressed blocks in file order
+__attribute__((noreturn)) void *nfdecompressor(void *arg) {
+    nffile_t *nffile = (nffile_t *)arg;
+
+    /* Signal handling */
+    sigset_t set = {0};
+    sigfillset(&set);
+    pthread_sigmask(SIG_SETMASK, &set, NULL);
+
+    while (1) {
+        blockJob_t *job = queue_pop(nffile->blockQueue);
+        if (job == QUEUE_CLOSED) break;
+
+        dataBlock_t *dataBlock = NULL;
+        if (atomic_load(&nffile->terminate) == 1) {
+            FreeDataBlock(job->dataBlock);
+        } else {
+            dataBlock = nfuncompress(nffile, job->dataBlock);
+        }
+        CommitBlock(nffile, job->seq, dataBlock);
+        free(job);
+    }
+
+    // last worker closes the queue
+    queue_close(nffile->processQueue);
+
+    dbg_printf("nfdecompressor exit\n");
+    pthread_exit(NULL);
+
+}  // End of nfdecompressor
+
 dataBlock_t *WriteBlock(nffile_t *nffile, dataBlock_t *dataBlock) {
     if (dataBlock == NULL) {
         dataBlock = NewDataBlock();
@@ -1400,11 +2534,482 @@ void FlushBlock(nffile_t *nffile, dataBlock_t *dataBlock) {
     }
 }  // End of FlushBlock
 
-static int nfwrite(nffile_t *nffile, dataBlock_t *block_header) {
-    if (block_header->size == 0) {
-        return 1;
+// update min/max of an IPv6 address in the zone map
+static inline void ZoneMapIPv6(uint64_t *minAddr, uint64_t *maxAddr, uint64_t *addr) {
+    if (addr[0] < minAddr[0] || (addr[0] == minAddr[0] && addr[1] < minAddr[1])) {
+        minAddr[0] = addr[0];
+        minAddr[1] = addr[1];
+    }
+    if (addr[0] > maxAddr[0] || (addr[0] == maxAddr[0] && addr[1] > maxAddr[1])) {
+        maxAddr[0] = addr[0];
+        maxAddr[1] = addr[1];
+    }
+}  // End of ZoneMapIPv6
+
+// Bloom filter hash of an IP address. IPv4 addresses are passed as ip0 = 0, ip1 = IPv4
+static inline uint64_t BloomHash(uint64_t ip0, uint64_t ip1) {
+    uint64_t h = (ip0 * 0x9E3779B97F4A7C15LL) ^ ip1;
+    // murmur3 finalizer
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdLL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53LL;
+    h ^= h >> 33;
+    return h;
+}  // End of BloomHash
+
+static inline void BloomAdd(bloomFilter_t *bloomFilter, uint64_t ip0, uint64_t ip1) {
+    uint64_t h = BloomHash(ip0, ip1);
+    uint32_t h1 = h & 0xFFFFFFFF;
+    uint32_t h2 = (h >> 32) | 1;
+    uint32_t mask = bloomFilter->numBits - 1;
+    for (int i = 0; i < bloomFilter->numHash; i++) {
+        uint32_t bit = (h1 + i * h2) & mask;
+        bloomFilter->bits[bit >> 6] |= 1LL << (bit & 0x3F);
+    }
+}  // End of BloomAdd
+
+// test an IP address against a Bloom filter. Returns 0, if the address is not in the block
+int BloomTest(const bloomFilter_t *bloomFilter, uint64_t ip0, uint64_t ip1) {
+    uint64_t h = BloomHash(ip0, ip1);
+    uint32_t h1 = h & 0xFFFFFFFF;
+    uint32_t h2 = (h >> 32) | 1;
+    uint32_t mask = bloomFilter->numBits - 1;
+    for (int i = 0; i < bloomFilter->numHash; i++) {
+        uint32_t bit = (h1 + i * h2) & mask;
+        if ((bloomFilter->bits[bit >> 6] & (1LL << (bit & 0x3F))) == 0) return 0;
+    }
+    return 1;
+}  // End of BloomTest
+
+// allocate an empty Bloom filter, sized for max 2 addresses per record
+static bloomFilter_t *NewBloomFilter(uint32_t numRecords) {
+    uint32_t numBits = BLOOM_MIN_BITS;
+    while (numBits < BLOOM_MAX_BITS && numBits < (2 * BLOOM_BITS_PER_IP * numRecords)) numBits <<= 1;
+
+    bloomFilter_t *bloomFilter = calloc(1, sizeof(bloomFilter_t) + numBits / 8);
+    if (!bloomFilter) {
+        LogError("calloc() error in %s line %d: %s", __FILE__, __LINE__, strerror(errno));
+        return NULL;
+    }
+    bloomFilter->numBits = numBits;
+    bloomFilter->numHash = BLOOM_NUM_HASH;
+    return bloomFilter;
+
+}  // End of NewBloomFilter
+
+static void FreeBloomFilters(nffile_t *nffile) {
+    for (uint32_t i = 0; i < nffile->numBloomFilter; i++) {
+        if (nffile->bloomFilter[i]) free(nffile->bloomFilter[i]);
+        nffile->bloomFilter[i] = NULL;
+    }
+    nffile->numBloomFilter = 0;
+
+}  // End of FreeBloomFilters
+
+// create a compression dictionary from the dictionary data
+static compressDict_t *NewDictionary(int compression, void *data, uint32_t size) {
+    compressDict_t *dict = calloc(1, sizeof(compressDict_t));
+    dictionary_t *dictionary = malloc(sizeof(dictionary_t) + size);
+    if (!dict || !dictionary) {
+        LogError("malloc() error in %s line %d: %s", __FILE__, __LINE__, strerror(errno));
+        if (dict) free(dict);
+        if (dictionary) free(dictionary);
+        return NULL;
+    }
+    dictionary->compression = compression;
+    dictionary->fill = 0;
+    dictionary->size = size;
+    memcpy((void *)dictionary->data, data, size);
+    dict->dictionary = dictionary;
+
+#ifdef HAVE_ZSTD
+    if (compression == ZSTD_COMPRESSED) {
+        dict->ddict = ZSTD_createDDict(dictionary->data, size);
+        if (!dict->ddict) {
+            LogError("ZSTD_createDDict() error in %s line %d", __FILE__, __LINE__);
+            free(dictionary);
+            free(dict);
+            return NULL;
+        }
+    }
+#endif
+
+    return dict;
+
+}  // End of NewDictionary
+
+static void FreeDictionary(nffile_t *nffile) {
+    compressDict_t *dict = nffile->dictionary;
+    if (!dict) return;
+
+#ifdef HAVE_ZSTD
+    if (dict->cdict) ZSTD_freeCDict(dict->cdict);
+    if (dict->ddict) ZSTD_freeDDict(dict->ddict);
+#endif
+    free(dict->dictionary);
+    free(dict);
+    nffile->dictionary = NULL;
+
+}  // End of FreeDictionary
+
+// copy the beginning of a written data block into the samples for the next dictionary
+// Called with wlock held
+static void SampleBlock(nffile_t *nffile, dataBlock_t *dataBlock) {
+    dictSamples_t *samples = nffile->dictSamples;
+    if (!samples) {
+        samples = malloc(sizeof(dictSamples_t));
+        if (!samples) {
+            LogError("malloc() error in %s line %d: %s", __FILE__, __LINE__, strerror(errno));
+            return;
+        }
+        samples->size = 0;
+        samples->numSamples = 0;
+        nffile->dictSamples = samples;
+    }
+
+    size_t sampleSize = dataBlock->size;
+    if (sampleSize > DICT_SAMPLESIZE) sampleSize = DICT_SAMPLESIZE;
+    if (sampleSize > (DICT_SAMPLEBUFF - samples->size)) sampleSize = DICT_SAMPLEBUFF - samples->size;
+    if (sampleSize == 0 || samples->numSamples == DICT_MAXSAMPLES) return;
+
+    memcpy((void *)(samples->data + samples->size), GetCursor(dataBlock), sampleSize);
+    samples->sampleSize[samples->numSamples++] = sampleSize;
+    samples->size += sampleSize;
+
+}  // End of SampleBlock
+
+// replace the dictionary by a new one, trained from the samples of the previous file.
+// zstd trains a dictionary, lz4 uses the most recent sample data as dictionary
+static void TrainDictionary(nffile_t *nffile) {
+    dictSamples_t *samples = nffile->dictSamples;
+    if (!samples) return;
+
+    if (samples->size < DICT_MINSIZE) {
+        // not enough data - keep the current dictionary
+        samples->size = 0;
+        samples->numSamples = 0;
+        return;
     }
 
+    int compression = nffile->file_header->compression;
+    void *dictData = (void *)samples->data;
+    size_t dictSize = samples->size;
+    void *trained = NULL;
+#ifdef HAVE_ZSTD
+    if (compression == ZSTD_COMPRESSED) {
+        trained = malloc(DICTIONARY_SIZE);
+        if (trained) {
+            size_t size = ZDICT_trainFromBuffer(trained, DICTIONARY_SIZE, samples->data, samples->sampleSize, samples->numSamples);
+            if (ZDICT_isError(size)) {
+                // too few samples - zstd accepts raw content as dictionary
+                dbg_printf("ZDICT_trainFromBuffer() failed: %s\n", ZDICT_getErrorName(size));
+            } else {
+                dictData = trained;
+                dictSize = size;
+            }
+        }
+    }
+#endif
+    if (dictSize > DICTIONARY_SIZE) {
+        dictData += dictSize - DICTIONARY_SIZE;
+        dictSize = DICTIONARY_SIZE;
+    }
+
+    compressDict_t *dict = NewDictionary(compression, dictData, dictSize);
+    if (trained) free(trained);
+    samples->size = 0;
+    samples->numSamples = 0;
+
+    if (dict) {
+        FreeDictionary(nffile);
+        nffile->dictionary = dict;
+    }
+
+}  // End of TrainDictionary
+
+// set up the dictionary of a file opened for writing. A dictionary of a different
+// compression is dropped. zstd needs a compression dictionary for the file level
+static void PrepareDictionary(nffile_t *nffile) {
+    compressDict_t *dict = nffile->dictionary;
+    if (!dict) return;
+
+    if (dict->dictionary->compression != nffile->file_header->compression) {
+        FreeDictionary(nffile);
+        return;
+    }
+
+#ifdef HAVE_ZSTD
+    if (dict->dictionary->compression == ZSTD_COMPRESSED && dict->cdict == NULL) {
+        int level = nffile->compression_level ? nffile->compression_level : ZSTD_CLEVEL_DEFAULT;
+        dict->cdict = ZSTD_createCDict(dict->dictionary->data, dict->dictionary->size, level);
+        if (!dict->cdict) {
+            LogError("ZSTD_createCDict() error in %s line %d", __FILE__, __LINE__);
+            FreeDictionary(nffile);
+        }
+    }
+#endif
+
+}  // End of PrepareDictionary
+
+// collect the block directory info, zone map and Bloom filter of an uncompressed data block
+static void ScanBlock(dataBlock_t *dataBlock, blockSummary_t *blockSummary) {
+    blockInfo_t *blockInfo = &blockSummary->blockInfo;
+    zoneMap_t *zoneMap = &blockSummary->zoneMap;
+    blockSummary->bloomFilter = NULL;
+
+    memset((void *)blockInfo, 0, sizeof(blockInfo_t));
+    blockInfo->NumRecords = dataBlock->NumRecords;
+    blockInfo->type = dataBlock->type;
+    blockInfo->msecFirst = 0x7fffffffffffffffLL;
+    blockInfo->msecLast = 0;
+
+    // all min values start at max and vice versa
+    memset((void *)zoneMap, 0, sizeof(zoneMap_t));
+    zoneMap->minSrcPort = zoneMap->minDstPort = zoneMap->minExporterID = 0xFFFF;
+    zoneMap->minSrc4Addr = zoneMap->minDst4Addr = 0xFFFFFFFF;
+    zoneMap->minSrc6Addr[0] = zoneMap->minSrc6Addr[1] = 0xFFFFFFFFFFFFFFFFLL;
+    zoneMap->minDst6Addr[0] = zoneMap->minDst6Addr[1] = 0xFFFFFFFFFFFFFFFFLL;
+
+    if (dataBlock->type != DATA_BLOCK_TYPE_3) {
+        blockInfo->flags |= BLOCKINFO_META;
+        return;
+    }
+
+    bloomFilter_t *bloomFilter = NewBloomFilter(dataBlock->NumRecords);
+
+    recordHeader_t *recordHeader = (recordHeader_t *)GetCursor(dataBlock);
+    uint32_t sumSize = 0;
+    for (int i = 0; i < dataBlock->NumRecords; i++) {
+        if (recordHeader->size == 0 || (sumSize + recordHeader->size) > dataBlock->size) {
+            // corrupt block - never skip it
+            blockInfo->flags |= BLOCKINFO_META;
+            if (bloomFilter) free(bloomFilter);
+            return;
+        }
+
+        if (recordHeader->type == V3Record) {
+            recordHeaderV3_t *recordHeaderV3 = (recordHeaderV3_t *)recordHeader;
+            void *eor = (void *)recordHeaderV3 + recordHeaderV3->size;
+            EXgenericFlow_t *genericFlow = NULL;
+            EXipv4Flow_t *ipv4Flow = NULL;
+            EXipv6Flow_t *ipv6Flow = NULL;
+            EXnselCommon_t *nselCommon = NULL;
+            EXnatCommon_t *natCommon = NULL;
+
+            elementHeader_t *elementHeader = (elementHeader_t *)((void *)recordHeaderV3 + sizeof(recordHeaderV3_t));
+            for (int j = 0; j < recordHeaderV3->numElements; j++) {
+                if (elementHeader->length == 0 || ((void *)elementHeader + elementHeader->length) > eor) break;
+                void *data = (void *)elementHeader + sizeof(elementHeader_t);
+                switch (elementHeader->type) {
+                    case EXgenericFlowID:
+                        genericFlow = (EXgenericFlow_t *)data;
+                        break;
+                    case EXipv4FlowID:
+                        ipv4Flow = (EXipv4Flow_t *)data;
+                        break;
+                    case EXipv6FlowID:
+                        ipv6Flow = (EXipv6Flow_t *)data;
+                        break;
+                    case EXnselCommonID:
+                        nselCommon = (EXnselCommon_t *)data;
+                        break;
+                    case EXnatCommonID:
+                        natCommon = (EXnatCommon_t *)data;
+                        break;
+                }
+                elementHeader = (elementHeader_t *)((void *)elementHeader + elementHeader->length);
+            }
+
+            if (genericFlow) {
+                // same as MapRecordHandle() - event time for missing first seen
+                uint64_t msecFirst = genericFlow->msecFirst;
+                if (msecFirst == 0) {
+                    if (nselCommon)
+                        msecFirst = nselCommon->msecEvent;
+                    else if (natCommon)
+                        msecFirst = natCommon->msecEvent;
+                }
+                uint64_t msecLast = genericFlow->msecLast;
+                // time span covers both values, even if first > last
+                if (msecFirst < blockInfo->msecFirst) blockInfo->msecFirst = msecFirst;
+                if (msecLast < blockInfo->msecFirst) blockInfo->msecFirst = msecLast;
+                if (msecFirst > blockInfo->msecLast) blockInfo->msecLast = msecFirst;
+                if (msecLast > blockInfo->msecLast) blockInfo->msecLast = msecLast;
+
+                zoneMap->numFlows++;
+                zoneMap->protoMap[genericFlow->proto >> 6] |= 1LL << (genericFlow->proto & 0x3F);
+                if (genericFlow->srcPort < zoneMap->minSrcPort) zoneMap->minSrcPort = genericFlow->srcPort;
+                if (genericFlow->srcPort > zoneMap->maxSrcPort) zoneMap->maxSrcPort = genericFlow->srcPort;
+                if (genericFlow->dstPort < zoneMap->minDstPort) zoneMap->minDstPort = genericFlow->dstPort;
+                if (genericFlow->dstPort > zoneMap->maxDstPort) zoneMap->maxDstPort = genericFlow->dstPort;
+            }
+
+            zoneMap->numRecords++;
+            if (recordHeaderV3->exporterID < zoneMap->minExporterID) zoneMap->minExporterID = recordHeaderV3->exporterID;
+            if (recordHeaderV3->exporterID > zoneMap->maxExporterID) zoneMap->maxExporterID = recordHeaderV3->exporterID;
+
+            if (ipv4Flow) {
+                zoneMap->numIPv4++;
+                if (ipv4Flow->srcAddr < zoneMap->minSrc4Addr) zoneMap->minSrc4Addr = ipv4Flow->srcAddr;
+                if (ipv4Flow->srcAddr > zoneMap->maxSrc4Addr) zoneMap->maxSrc4Addr = ipv4Flow->srcAddr;
+                if (ipv4Flow->dstAddr < zoneMap->minDst4Addr) zoneMap->minDst4Addr = ipv4Flow->dstAddr;
+                if (ipv4Flow->dstAddr > zoneMap->maxDst4Addr) zoneMap->maxDst4Addr = ipv4Flow->dstAddr;
+                if (bloomFilter) {
+                    BloomAdd(bloomFilter, 0, ipv4Flow->srcAddr);
+                    BloomAdd(bloomFilter, 0, ipv4Flow->dstAddr);
+                }
+            }
+            if (ipv6Flow) {
+                zoneMap->numIPv6++;
+                ZoneMapIPv6(zoneMap->minSrc6Addr, zoneMap->maxSrc6Addr, ipv6Flow->srcAddr);
+                ZoneMapIPv6(zoneMap->minDst6Addr, zoneMap->maxDst6Addr, ipv6Flow->dstAddr);
+                if (bloomFilter) {
+                    BloomAdd(bloomFilter, ipv6Flow->srcAddr[0], ipv6Flow->srcAddr[1]);
+                    BloomAdd(bloomFilter, ipv6Flow->dstAddr[0], ipv6Flow->dstAddr[1]);
+                }
+            }
+        } else {
+            blockInfo->flags |= BLOCKINFO_META;
+        }
+
+        sumSize += recordHeader->size;
+        recordHeader = (recordHeader_t *)((void *)recordHeader + recordHeader->size);
+    }
+    blockSummary->bloomFilter = bloomFilter;
+
+}  // End of ScanBlock
+
+// add the summary of a written block to the block directory, zone maps and Bloom filters
+// as long as they are complete. Called with wlock held
+static void AddBlockSummary(nffile_t *nffile, blockSummary_t *blockSummary, off_t offset, uint32_t size) {
+    bloomFilter_t *bloomFilter = blockSummary->bloomFilter;
+    blockSummary->bloomFilter = NULL;
+
+    if (offset < 0 || nffile->numBlockInfo != nffile->file_header->NumBlocks) {
+        if (bloomFilter) free(bloomFilter);
+        return;
+    }
+
+    if (nffile->numBlockInfo == nffile->maxBlockInfo) {
+        blockInfo_t *p = realloc(nffile->blockInfo, (nffile->maxBlockInfo + BLOCKDIR_CHUNK) * sizeof(blockInfo_t));
+        if (!p) {
+            LogError("realloc() error in %s line %d: %s", __FILE__, __LINE__, strerror(errno));
+            if (bloomFilter) free(bloomFilter);
+            return;
+        }
+        nffile->blockInfo = p;
+        nffile->maxBlockInfo += BLOCKDIR_CHUNK;
+    }
+
+    // zone maps are kept in sync with the block directory
+    if (nffile->numZoneMap == nffile->numBlockInfo) {
+        if (nffile->numZoneMap == nffile->maxZoneMap) {
+            zoneMap_t *p = realloc(nffile->zoneMap, (nffile->maxZoneMap + BLOCKDIR_CHUNK) * sizeof(zoneMap_t));
+            if (p) {
+                nffile->zoneMap = p;
+                nffile->maxZoneMap += BLOCKDIR_CHUNK;
+            } else {
+                LogError("realloc() error in %s line %d: %s", __FILE__, __LINE__, strerror(errno));
+            }
+        }
+        if (nffile->numZoneMap < nffile->maxZoneMap) nffile->zoneMap[nffile->numZoneMap++] = blockSummary->zoneMap;
+    }
+
+    // checksums as well
+    if (nffile->numChecksum == nffile->numBlockInfo) {
+        if (nffile->numChecksum == nffile->maxChecksum) {
+            uint32_t *p = realloc(nffile->checksum, (nffile->maxChecksum + BLOCKDIR_CHUNK) * sizeof(uint32_t));
+            if (p) {
+                nffile->checksum = p;
+                nffile->maxChecksum += BLOCKDIR_CHUNK;
+            } else {
+                LogError("realloc() error in %s line %d: %s", __FILE__, __LINE__, strerror(errno));
+            }
+        }
+        if (nffile->numChecksum < nffile->maxChecksum) nffile->checksum[nffile->numChecksum++] = blockSummary->checksum;
+    }
+
+    // Bloom filters as well
+    if (nffile->numBloomFilter == nffile->numBlockInfo) {
+        if (nffile->numBloomFilter == nffile->maxBloomFilter) {
+            bloomFilter_t **p = realloc(nffile->bloomFilter, (nffile->maxBloomFilter + BLOCKDIR_CHUNK) * sizeof(bloomFilter_t *));
+            if (p) {
+                nffile->bloomFilter = p;
+                nffile->maxBloomFilter += BLOCKDIR_CHUNK;
+            } else {
+                LogError("realloc() error in %s line %d: %s", __FILE__, __LINE__, strerror(errno));
+            }
+        }
+        if (nffile->numBloomFilter < nffile->maxBloomFilter) {
+            if (bloomFilter) bloomFilter->blockNum = nffile->numBloomFilter;
+            nffile->bloomFilter[nffile->numBloomFilter++] = bloomFilter;
+            bloomFilter = NULL;
+        }
+    }
+    if (bloomFilter) free(bloomFilter);
+
+    blockInfo_t *blockInfo = &nffile->blockInfo[nffile->numBlockInfo++];
+    *blockInfo = blockSummary->blockInfo;
+    blockInfo->offset = offset;
+    blockInfo->size = size;
+
+}  // End of AddBlockSummary
+
+static uint64_t NanoTime(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+
+}  // End of NanoTime
+
+// moving average over the last ~8 values
+static void UpdateAverage(_Atomic uint64_t *average, uint64_t value) {
+    uint64_t avg = atomic_load(average);
+    atomic_store(average, avg - (avg >> 3) + (value >> 3));
+
+}  // End of UpdateAverage
+
+// choose the compression level of the next data block from the writer backlog.
+// The level steps down, while blocks queue up in the processQueue and steps up again,
+// if the writers keep up and a block compresses in less than half the time between
+// two blocks. If the fastest level does not keep up, blocks are stored uncompressed
+static int AdaptiveLevel(nffile_t *nffile) {
+    int compression = nffile->file_header->compression;
+    int minLevel = 0;
+    int maxLevel = nffile->compression_level;
+    if (compression == LZO_COMPRESSED || compression == BZ2_COMPRESSED) maxLevel = 0;
+#ifdef HAVE_ZSTD
+    if (compression == ZSTD_COMPRESSED) {
+        minLevel = 1;
+        if (maxLevel == 0) maxLevel = ZSTD_CLEVEL_DEFAULT;
+    }
+#endif
+
+    int level = atomic_load(&nffile->adaptLevel);
+    if (level > maxLevel) level = maxLevel;
+
+    uint32_t backlog = queue_length(nffile->processQueue);
+    if (backlog >= (QueueSize / 2)) {
+        level = level > minLevel ? level / 2 : ADAPT_STORE;
+    } else if (backlog == 0 && level < maxLevel) {
+        if ((2 * atomic_load(&nffile->compressTime)) < atomic_load(&nffile->blockInterval)) {
+            level = level < minLevel ? minLevel : 2 * level + 1;
+            if (level > maxLevel) level = maxLevel;
+        }
+    }
+    atomic_store(&nffile->adaptLevel, level);
+
+    return level;
+
+}  // End of AdaptiveLevel
+
+// compress the data block of a write job. If blockSummary is not NULL, the block is added
+// to the block directory on writing. Appendix blocks are not part of the directory
+static int CompressJob(nffile_t *nffile, writeJob_t *job) {
+    dataBlock_t *block_header = job->dataBlock;
+    blockSummary_t *blockSummary = job->blockSummary;
+
     dbg_printf("nfwrite - write: %u\n", block_header->size);
 
     dataBlock_t *buff = NULL;
@@ -1413,6 +3018,21 @@ static int nfwrite(nffile_t *nffile, dataBlock_t *block_header) {
     // compress according file compression
     int compression = nffile->file_header->compression;
     int level = nffile->compression_level;
+    int adaptive = blockSummary && adaptiveCompression && compression != NOT_COMPRESSED;
+    if (adaptive) {
+        level = AdaptiveLevel(nffile);
+        if (level == ADAPT_STORE) {
+            compression = NOT_COMPRESSED;
+            SetFlag(block_header->flags, FLAG_BLOCK_UNCOMPRESSED);
+            blockSummary->blockInfo.flags |= BLOCKINFO_UNCOMPRESSED;
+            level = 0;
+        }
+    }
+    if (blockSummary) blockSummary->blockInfo.level = level;
+
+    // data blocks are compressed with the file dictionary, if any
+    compressDict_t *dict = blockSummary ? nffile->dictionary : NULL;
+    uint64_t startTime = adaptive ? NanoTime() : 0;
     dbg_printf("nfwrite - compression: %u\n", compression);
     switch (compression) {
         case NOT_COMPRESSED:
@@ -1425,7 +3045,7 @@ static int nfwrite(nffile_t *nffile, dataBlock_t *block_header) {
             break;
         case LZ4_COMPRESSED:
             buff = NewDataBlock();
-            if (Compress_Block_LZ4(block_header, buff, nffile->buff_size, level) < 0) failed = 1;
+            if (Compress_Block_LZ4(block_header, buff, nffile->buff_size, level, dict) < 0) failed = 1;
             wptr = buff;
             break;
         case BZ2_COMPRESSED:
@@ -1435,7 +3055,7 @@ static int nfwrite(nffile_t *nffile, dataBlock_t *block_header) {
             break;
         case ZSTD_COMPRESSED:
             buff = NewDataBlock();
-            if (Compress_Block_ZSTD(block_header, buff, nffile->buff_size, level) < 0) failed = 1;
+            if (Compress_Block_ZSTD(block_header, buff, nffile->buff_size, level, dict) < 0) failed = 1;
             wptr = buff;
             break;
     }
@@ -1445,24 +3065,154 @@ static int nfwrite(nffile_t *nffile, dataBlock_t *block_header) {
         return 0;
     }
 
+    if (adaptive) UpdateAverage(&nffile->compressTime, NanoTime() - startTime);
+    if (dict && (compression == LZ4_COMPRESSED || compression == ZSTD_COMPRESSED)) SetFlag(wptr->flags, FLAG_BLOCK_DICTIONARY);
+
+    // checksum of the block as written to disk
+    if (blockSummary) blockSummary->checksum = Crc32c(0, (void *)wptr, sizeof(dataBlock_t) + wptr->size);
+
     dbg_printf("WriteBlock - type: %u, size: %u, compressed: %u, numRecords: %u, flags: %u\n", wptr->type, block_header->size, compression,
                wptr->NumRecords, wptr->flags);
 
+    job->buff = buff;
+    job->wptr = wptr;
+    job->compression = compression;
+    return 1;
+
+}  // End of CompressJob
+
+// drop the written data from the page cache, so a collector does not push out the cached data
+// of other processes. The writeback of the new block is started and the blocks written before
+// are dropped, once they are on disk. This also spreads the disk writes evenly over time,
+// instead of a large writeback at the end of the file. Called with wlock held
+static void DropWritten(nffile_t *nffile, off_t offset, size_t size) {
+#ifdef HAVE_SYNC_FILE_RANGE
+    sync_file_range(nffile->fd, offset, size, SYNC_FILE_RANGE_WRITE);
+    if (offset > nffile->cacheOffset) {
+        off_t len = offset - nffile->cacheOffset;
+        sync_file_range(nffile->fd, nffile->cacheOffset, len, SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER);
+#ifdef HAVE_POSIX_FADVISE
+        posix_fadvise(nffile->fd, nffile->cacheOffset, len, POSIX_FADV_DONTNEED);
+#endif
+        nffile->cacheOffset = offset;
+    }
+#elif defined(HAVE_POSIX_FADVISE)
+    // dirty pages are not dropped - pages written back in between are
+    if (offset > nffile->cacheOffset) {
+        posix_fadvise(nffile->fd, nffile->cacheOffset, offset - nffile->cacheOffset, POSIX_FADV_DONTNEED);
+        nffile->cacheOffset = offset;
+    }
+#endif
+
+}  // End of DropWritten
+
+// write the compressed block of a write job to the file
+static int WriteJob(nffile_t *nffile, writeJob_t *job) {
+    blockSummary_t *blockSummary = job->blockSummary;
+    dataBlock_t *wptr = job->wptr;
+
     pthread_mutex_lock(&nffile->wlock);
+    off_t offset = (blockSummary || dropCache) ? lseek(nffile->fd, 0, SEEK_CUR) : -1;
+    uint32_t size = wptr->size;
     ssize_t ret = write(nffile->fd, (void *)wptr, sizeof(dataBlock_t) + wptr->size);
-    FreeDataBlock(buff);
     if (ret < 0) {
         pthread_mutex_unlock(&nffile->wlock);
         LogError("write() error in %s line %d: %s", __FILE__, __LINE__, strerror(errno));
         return 0;
     }
+    if (dropCache && offset >= 0) DropWritten(nffile, offset, ret);
+
+    if (blockSummary) {
+        AddBlockSummary(nffile, blockSummary, offset, size);
+        if (trainDictionary && (job->compression == LZ4_COMPRESSED || job->compression == ZSTD_COMPRESSED)) SampleBlock(nffile, job->dataBlock);
+    }
 
     nffile->file_header->NumBlocks++;
     pthread_mutex_unlock(&nffile->wlock);
     return 1;
 
+}  // End of WriteJob
+
+// compress and write a data block. If blockSummary is not NULL, the block is added
+// to the block directory. nfwrite takes over the Bloom filter of the summary.
+// Appendix blocks are not part of the directory
+static int nfwrite(nffile_t *nffile, dataBlock_t *block_header, blockSummary_t *blockSummary) {
+    int ok = 1;
+    if (block_header->size) {
+        writeJob_t job = {.dataBlock = block_header, .blockSummary = blockSummary};
+        ok = CompressJob(nffile, &job) && WriteJob(nffile, &job);
+        FreeDataBlock(job.buff);
+    }
+    if (blockSummary && blockSummary->bloomFilter) {
+        free(blockSummary->bloomFilter);
+        blockSummary->bloomFilter = NULL;
+    }
+
+    return ok;
+
 }  // End of nfwrite
 
+static void FreeWriteJob(writeJob_t *job) {
+    if (job == NULL || job == WRITE_FAILED) return;
+
+    FreeDataBlock(job->dataBlock);
+    FreeDataBlock(job->buff);
+    if (job->summary.bloomFilter) free(job->summary.bloomFilter);
+    free(job);
+
+}  // End of FreeWriteJob
+
+// write compressed blocks in sequence. nfwriter threads may finish compressing in any order -
+// blocks are parked in the writeRing until all preceding blocks are written. Only one thread
+// at a time writes the blocks of the ring. Returns 0, if a block could not be written
+static int CommitWrite(nffile_t *nffile, uint32_t seq, writeJob_t *job) {
+    pthread_mutex_lock(&nffile->rlock);
+    // wait for a free slot in the ring
+    while ((seq - nffile->nextBlock) >= nffile->ringSize && atomic_load(&nffile->terminate) != 1) {
+        pthread_cond_wait(&nffile->rcond, &nffile->rlock);
+    }
+    if (atomic_load(&nffile->terminate) == 1) {
+        pthread_mutex_unlock(&nffile->rlock);
+        FreeWriteJob(job);
+        return 0;
+    }
+
+    nffile->writeRing[seq % nffile->ringSize] = job;
+    if (nffile->committing) {
+        // the committing thread writes this block as well
+        pthread_mutex_unlock(&nffile->rlock);
+        return 1;
+    }
+
+    // write all blocks in sequence
+    int ok = 1;
+    nffile->committing = 1;
+    uint32_t slot = nffile->nextBlock % nffile->ringSize;
+    while (nffile->writeRing[slot]) {
+        writeJob_t *next = nffile->writeRing[slot];
+        nffile->writeRing[slot] = NULL;
+        pthread_mutex_unlock(&nffile->rlock);
+
+        // a failed block is dropped
+        if (next == WRITE_FAILED) {
+            ok = 0;
+        } else if (next->dataBlock->size && !WriteJob(nffile, next)) {
+            ok = 0;
+        }
+        FreeWriteJob(next);
+
+        pthread_mutex_lock(&nffile->rlock);
+        nffile->nextBlock++;
+        pthread_cond_broadcast(&nffile->rcond);
+        slot = nffile->nextBlock % nffile->ringSize;
+    }
+    nffile->committing = 0;
+    pthread_mutex_unlock(&nffile->rlock);
+
+    return ok;
+
+}  // End of CommitWrite
+
 __attribute__((noreturn)) void *nfwriter(void *arg) {
     nffile_t *nffile = (nffile_t *)arg;
 
@@ -1474,18 +3224,49 @@ __attribute__((noreturn)) void *nfwriter(void *arg) {
 
     dataBlock_t *block_header;
     while (1) {
-        block_header = queue_pop(nffile->processQueue);
+        // blocks are numbered in the order of the processQueue, which is the order of WriteBlock()
+        size_t pos;
+        block_header = queue_pop_pos(nffile->processQueue, &pos);
+        uint32_t seq = (uint32_t)(pos - nffile->writeBase);
         if (block_header == QUEUE_CLOSED) break;
 
-        int ok = 1;
-        if (block_header->size) {
-            // block with data
-            dbg_printf("nfwriter write\n");
-            ok = nfwrite(nffile, block_header);
+        if (adaptiveCompression) {
+            // with an empty queue, blocks are popped, as they arrive
+            uint64_t now = NanoTime();
+            uint64_t lastBlock = atomic_exchange(&nffile->lastBlock, now);
+            if (lastBlock) UpdateAverage(&nffile->blockInterval, now - lastBlock);
+        }
+
+        writeJob_t *job = calloc(1, sizeof(writeJob_t));
+        if (!job) {
+            LogError("malloc() error in %s line %d: %s", __FILE__, __LINE__, strerror(errno));
+            FreeDataBlock(block_header);
+            CommitWrite(nffile, seq, WRITE_FAILED);
+            break;
         }
-        FreeDataBlock(block_header);
 
-        if (!ok) break;
+        // block with data
+        dbg_printf("nfwriter write\n");
+        ScanBlock(block_header, &job->summary);
+        if (nffile->columnar && block_header->type == DATA_BLOCK_TYPE_3) {
+            dataBlock_t *columnBlock = NewDataBlock();
+            if (columnBlock && ColumnBlock(block_header, columnBlock, BUFFSIZE)) {
+                FreeDataBlock(block_header);
+                block_header = columnBlock;
+                job->summary.blockInfo.type = DATA_BLOCK_TYPE_5;
+            } else {
+                // write the row block
+                FreeDataBlock(columnBlock);
+            }
+        }
+        job->dataBlock = block_header;
+        job->blockSummary = &job->summary;
+
+        if (block_header->size && !CompressJob(nffile, job)) {
+            FreeWriteJob(job);
+            job = WRITE_FAILED;
+        }
+        if (!CommitWrite(nffile, seq, job)) break;
     }
 
     dbg_printf("nfwriter exit\n");
@@ -1499,9 +3280,14 @@ static int SignalTerminate(nffile_t *nffile) {
     // set terminate
     atomic_store(&nffile->terminate, 1);
     queue_close(nffile->processQueue);
+    queue_close(nffile->blockQueue);
 
-    pthread_cond_broadcast(&(nffile->processQueue->cond));
-    for (unsigned i = 0; i < NumWorkers; i++) {
+    // wake up decompress workers waiting for the reorder ring
+    pthread_mutex_lock(&nffile->rlock);
+    pthread_cond_broadcast(&nffile->rcond);
+    pthread_mutex_unlock(&nffile->rlock);
+
+    for (unsigned i = 0; i < MAXWORKERS; i++) {
         if (nffile->worker[i]) {
             int err = pthread_join(nffile->worker[i], NULL);
             if (err && err != ESRCH) {
@@ -1524,6 +3310,12 @@ void SetIdent(nffile_t *nffile, char *Ident) {
 
 }  // End of SetIdent
 
+// data blocks written to nffile are converted into columnar blocks
+void SetColumnar(nffile_t *nffile, int columnar) {
+    nffile->columnar = columnar;
+
+}  // End of SetColumnar
+
 int ChangeIdent(char *filename, char *Ident) {
     nffile_t *nffile = OpenFileStatic(filename, NULL);
     if (!nffile) {
@@ -1543,7 +3335,8 @@ int ChangeIdent(char *filename, char *Ident) {
     SetIdent(nffile, Ident);
 
     // seek to end of data
-    if (nffile->file_header->offAppendix) {
+    int hasAppendix = nffile->file_header->offAppendix != 0;
+    if (hasAppendix) {
         // seek to  end of data blocks
         if (lseek(nffile->fd, nffile->file_header->offAppendix, SEEK_SET) < 0) {
             LogError("lseek() error in %s line %d: %s", __FILE__, __LINE__, strerror(errno));
@@ -1551,8 +3344,13 @@ int ChangeIdent(char *filename, char *Ident) {
             DisposeFile(nffile);
             return 0;
         }
-        // remove old appendix block
-        nffile->file_header->NumBlocks--;
+        // cut off old appendix
+        if (ftruncate(nffile->fd, nffile->file_header->offAppendix) < 0) {
+            LogError("ftruncate() error in %s line %d: %s", __FILE__, __LINE__, strerror(errno));
+            close(nffile->fd);
+            DisposeFile(nffile);
+            return 0;
+        }
     } else {
         // if no appendix
         if (lseek(nffile->fd, 0, SEEK_END) < 0) {
@@ -1567,6 +3365,14 @@ int ChangeIdent(char *filename, char *Ident) {
         LogError("Failed to write appendix");
     }
 
+    // update V2 file header - the number of appendix blocks may have changed
+    if (hasAppendix) {
+        nffile->file_header->NumBlocks -= nffile->file_header->appendixBlocks;
+        if (lseek(nffile->fd, 0, SEEK_SET) < 0 || write(nffile->fd, (void *)nffile->file_header, sizeof(fileHeaderV2_t)) <= 0) {
+            LogError("write() error in %s line %d: %s", __FILE__, __LINE__, strerror(errno));
+        }
+    }
+
     if (close(nffile->fd) < 0) {
         LogError("close() error in %s line %d: %s", __FILE__, __LINE__, strerror(errno));
         return 0;
@@ -1644,16 +3450,93 @@ void ModifyCompressFile(int compress) {
 
 }  // End of ModifyCompressFile
 
+typedef struct verifyArgs_s {
+    nffile_t *nffile;
+    _Atomic uint32_t nextBlock;      // next block to verify
+    _Atomic uint32_t corruptBlocks;  // blocks with checksum error
+} verifyArgs_t;
+
+// verify worker - reads the data blocks from disk and checks their checksums
+__attribute__((noreturn)) static void *nfverifier(void *arg) {
+    verifyArgs_t *verifyArgs = (verifyArgs_t *)arg;
+    nffile_t *nffile = verifyArgs->nffile;
+
+    dataBlock_t *buff = NewDataBlock();
+    while (buff) {
+        uint32_t blockNum = atomic_fetch_add(&verifyArgs->nextBlock, 1);
+        if (blockNum >= nffile->numBlockInfo) break;
+
+        blockInfo_t *blockInfo = &nffile->blockInfo[blockNum];
+        size_t size = sizeof(dataBlock_t) + blockInfo->size;
+        if (blockInfo->size > (BUFFSIZE - sizeof(dataBlock_t)) || pread(nffile->fd, (void *)buff, size, blockInfo->offset) != (ssize_t)size ||
+            Crc32c(0, (void *)buff, size) != nffile->checksum[blockNum]) {
+            LogError("Block %u: checksum error, offset: %llu, size: %u", blockNum + 1, (unsigned long long)blockInfo->offset, blockInfo->size);
+            atomic_fetch_add(&verifyArgs->corruptBlocks, 1);
+        }
+    }
+    FreeDataBlock(buff);
+
+    pthread_exit(NULL);
+
+}  // End of nfverifier
+
+// verify the checksums of all data blocks with a number of nfverifier threads and
+// print the block summary from the block directory. Returns 0, if a block is corrupt
+static int VerifyChecksums(nffile_t *nffile) {
+    verifyArgs_t verifyArgs = {.nffile = nffile};
+    uint32_t numWorkers = GetNumWorkers(0);
+
+    printf("Checking data block checksums\n");
+#ifdef HAVE_POSIX_FADVISE
+    posix_fadvise(nffile->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+    pthread_t tid[MAXWORKERS];
+    uint32_t numThreads = 0;
+    for (uint32_t i = 0; i < numWorkers; i++) {
+        int err = pthread_create(&tid[numThreads], NULL, nfverifier, (void *)&verifyArgs);
+        if (err) {
+            LogError("pthread_create() error in %s line %d: %s", __FILE__, __LINE__, strerror(err));
+            break;
+        }
+        numThreads++;
+    }
+    if (numThreads == 0) {
+        LogError("Failed to start verify workers");
+        return 0;
+    }
+    for (uint32_t i = 0; i < numThreads; i++) pthread_join(tid[i], NULL);
+
+    uint32_t typeCnt[DATA_BLOCK_TYPE_5 + 1] = {0};
+    uint64_t totalRecords = 0;
+    for (uint32_t i = 0; i < nffile->numBlockInfo; i++) {
+        blockInfo_t *blockInfo = &nffile->blockInfo[i];
+        if (blockInfo->type <= DATA_BLOCK_TYPE_5) typeCnt[blockInfo->type]++;
+        totalRecords += blockInfo->NumRecords;
+    }
+
+    uint32_t corruptBlocks = atomic_load(&verifyArgs.corruptBlocks);
+    printf("\nTotal\n");
+    for (int type = 1; type <= DATA_BLOCK_TYPE_5; type++) {
+        if (typeCnt[type]) printf("Type %d blocks : %u\n", type, typeCnt[type]);
+    }
+    printf("Records       : %" PRIu64 "\n", totalRecords);
+    if (corruptBlocks) printf("Corrupt blocks: %u\n", corruptBlocks);
+
+    return corruptBlocks == 0;
+
+}  // End of VerifyChecksums
+
 int QueryFile(char *filename, int verbose) {
     int fd;
-    uint32_t totalRecords, numBlocks, type1, type2, type3, type4;
+    uint32_t totalRecords, numBlocks, type1, type2, type3, type4, type5;
     struct stat stat_buf;
     ssize_t ret;
 
     dbg_printf("Query mode verbose: %d\n", verbose);
     if (!Init_nffile(1, NULL)) return 0;
 
-    type1 = type2 = type3 = type4 = 0;
+    type1 = type2 = type3 = type4 = type5 = 0;
     totalRecords = numBlocks = 0;
 
     if (stat(filename, &stat_buf)) {
@@ -1772,6 +3655,21 @@ int QueryFile(char *filename, int verbose) {
     nffile->fileName = strdup(filename);
     memcpy(nffile->file_header, &fileHeader, sizeof(fileHeader));
 
+    // data blocks may be compressed with the dictionary from the appendix
+    // and may be verified with the block checksums
+    if (fileHeader.version == LAYOUT_VERSION_2 && fileHeader.appendixBlocks) {
+        ReadAppendix(nffile);
+        if (nffile->dictionary) printf("Dictionary : %u bytes\n", nffile->dictionary->dictionary->size);
+    }
+    int checksums = fileHeader.NumBlocks && nffile->numBlockInfo == fileHeader.NumBlocks && nffile->numChecksum == fileHeader.NumBlocks;
+
+    // verify the checksums of the blocks on disk in parallel, without uncompressing them
+    if (checksums && verbose == 0) {
+        int ok = VerifyChecksums(nffile);
+        DisposeFile(nffile);
+        return ok;
+    }
+
     // read buffer
     dataBlock_t *readBlock = NewDataBlock();
     // tmp uncompress buffer
@@ -1825,6 +3723,9 @@ int QueryFile(char *filename, int verbose) {
             case DATA_BLOCK_TYPE_4:
                 type4++;
                 break;
+            case DATA_BLOCK_TYPE_5:
+                type5++;
+                break;
             default:
                 printf("block %i has unknown type %u\n", numBlocks, readBlock->type);
                 close(fd);
@@ -1851,6 +3752,15 @@ int QueryFile(char *filename, int verbose) {
         if (TestFlag(readBlock->flags, FLAG_BLOCK_UNCOMPRESSED)) {
             compression = NOT_COMPRESSED;
         }
+        compressDict_t *dict = NULL;
+        if (TestFlag(readBlock->flags, FLAG_BLOCK_DICTIONARY)) {
+            dict = nffile->dictionary;
+            if (!dict) {
+                LogError("Block %i: missing compression dictionary", numBlocks);
+                close(fd);
+                return 0;
+            }
+        }
 
         void *read_ptr = GetCursor(readBlock);
         ret = read(nffile->fd, read_ptr, readBlock->size);
@@ -1871,6 +3781,12 @@ int QueryFile(char *filename, int verbose) {
             return 0;
         }
 
+        if (checksums && i < fileHeader.NumBlocks && Crc32c(0, (void *)readBlock, sizeof(dataBlock_t) + readBlock->size) != nffile->checksum[i]) {
+            LogError("Block %i: checksum error", numBlocks);
+            close(fd);
+            return 0;
+        }
+
         int failed = 0;
         switch (compression) {
             case NOT_COMPRESSED:
@@ -1888,7 +3804,7 @@ int QueryFile(char *filename, int verbose) {
                 dataBlock_t *b = readBlock;
                 readBlock = buff;
                 buff = b;
-                if (Uncompress_Block_LZ4(buff, readBlock, nffile->buff_size) < 0) {
+                if (Uncompress_Block_LZ4(buff, readBlock, nffile->buff_size, dict) < 0) {
                     LogError("LZ4 decompress failed");
                     failed = 1;
                 }
@@ -1906,7 +3822,7 @@ int QueryFile(char *filename, int verbose) {
                 dataBlock_t *b = readBlock;
                 readBlock = buff;
                 buff = b;
-                if (Uncompress_Block_ZSTD(buff, readBlock, nffile->buff_size) < 0) {
+                if (Uncompress_Block_ZSTD(buff, readBlock, nffile->buff_size, dict) < 0) {
                     LogError("Zstd decompress failed");
                     failed = 1;
                 }
@@ -1918,6 +3834,18 @@ int QueryFile(char *filename, int verbose) {
 
         if (failed) continue;
 
+        if (readBlock->type == DATA_BLOCK_TYPE_5) {
+            // check the records of the expanded row block
+            if (RowBlock(readBlock, buff, BUFFSIZE) == 0) {
+                LogError("Error in block: %u, columnar block corrupt", numBlocks);
+                close(fd);
+                return 0;
+            }
+            dataBlock_t *b = readBlock;
+            readBlock = buff;
+            buff = b;
+        }
+
         if (verbose)
             printf("Uncompressed block %i, type: %u, size: %u, flags: 0x%x, records: %u\n", numBlocks, readBlock->type, readBlock->size,
                    readBlock->flags, readBlock->NumRecords);
@@ -2020,6 +3948,7 @@ int QueryFile(char *filename, int verbose) {
     if (type2) printf("Type 2 blocks : %u\n", type2);
     if (type3) printf("Type 3 blocks : %u\n", type3);
     if (type4) printf("Type 4 blocks : %u\n", type4);
+    if (type5) printf("Type 5 blocks : %u\n", type5);
     printf("Records       : %u\n", totalRecords);
 
     DisposeFile(nffile);
@@ -2114,18 +4043,46 @@ static void UpdateStat(stat_record_t *s, stat_recordV1_t *sv1) {
     s->sequence_failure = sv1->sequence_failure;
 }  // End of UpdateStat
 
-// simple interface to get a stat record
-int GetStatRecord(char *filename, stat_record_t *stat_record) {
+// read stat record and ident from the file itself
+int ReadStatRecord(char *filename, stat_record_t *stat_record, char *ident, size_t identLen) {
     nffile_t *nffile = OpenFileStatic(filename, NULL);
     if (!nffile) {
         return 0;
     }
 
     memcpy((void *)stat_record, nffile->stat_record, sizeof(stat_record_t));
+    if (ident && identLen) {
+        ident[0] = '\0';
+        if (nffile->ident) strncpy(ident, nffile->ident, identLen - 1);
+        ident[identLen - 1] = '\0';
+    }
     DisposeFile(nffile);
 
     return 1;
 
+}  // End of ReadStatRecord
+
+// get stat record and ident of a file - from the directory catalog if valid,
+// otherwise from the file
+int GetStatInfo(char *filename, stat_record_t *stat_record, char *ident, size_t identLen) {
+    catalogEntry_t catalogEntry;
+    if (CatalogLookup(filename, NULL, &catalogEntry)) {
+        memcpy((void *)stat_record, (void *)&catalogEntry.stat_record, sizeof(stat_record_t));
+        if (ident && identLen) {
+            strncpy(ident, catalogEntry.ident, identLen - 1);
+            ident[identLen - 1] = '\0';
+        }
+        return 1;
+    }
+
+    return ReadStatRecord(filename, stat_record, ident, identLen);
+
+}  // End of GetStatInfo
+
+// simple interface to get a stat record
+int GetStatRecord(char *filename, stat_record_t *stat_record) {
+    return GetStatInfo(filename, stat_record, NULL, 0);
+
 }  // End of GetStatRecord
 
 void PrintStat(stat_record_t *s, char *ident) {
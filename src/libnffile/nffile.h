@@ -190,10 +190,63 @@ typedef struct nffile_s {
 
     queue_t *processQueue;  // blocks ready to be processed. Connects consumer/producer threads
 
+    // parallel block decompression
+    queue_t *blockQueue;        // raw blocks waiting for a decompress worker
+    uint32_t numDecompressors;  // number of decompress workers. 0: the reader decompresses
+    pthread_mutex_t rlock;      // reorder lock
+    pthread_cond_t rcond;       // reorder condition
+    uint32_t nextBlock;         // sequence number of next block to deliver
+    uint32_t ringSize;          // max blocks in flight
+    int blockFailed;            // a block failed to decompress - stop delivering
+#define BLOCKRING 64
+    dataBlock_t *blockRing[BLOCKRING];  // decompressed blocks waiting for delivery in order
+
+    // ordered block commit of the nfwriter threads - uses the reorder lock, nextBlock and ringSize
+    size_t writeBase;                         // processQueue position of the first block of the file
+    int committing;                           // a writer thread is writing the blocks of the writeRing
+    struct writeJob_s *writeRing[BLOCKRING];  // compressed blocks waiting to be written in order
+
+    // block directory
+    blockInfo_t *blockInfo;  // info for each data block
+    uint32_t numBlockInfo;   // number of entries in blockInfo. 0 if not available
+    uint32_t maxBlockInfo;   // allocated entries
+    uint32_t skippedBlocks;  // blocks skipped by the block check
+
+    // zone maps - same index as blockInfo
+    zoneMap_t *zoneMap;    // zone map for each data block. Valid if numZoneMap == numBlockInfo
+    uint32_t numZoneMap;   // number of entries in zoneMap
+    uint32_t maxZoneMap;   // allocated entries
+
+    // Bloom filters - same index as blockInfo. NULL for blocks without filter
+    bloomFilter_t **bloomFilter;  // Valid if numBloomFilter == numBlockInfo
+    uint32_t numBloomFilter;      // number of entries in bloomFilter
+    uint32_t maxBloomFilter;      // allocated entries
+
+    // block checksums - same index as blockInfo
+    uint32_t *checksum;      // CRC32C of each data block on disk. Valid if numChecksum == numBlockInfo
+    uint32_t numChecksum;    // number of entries in checksum
+    uint32_t maxChecksum;    // allocated entries
+    uint32_t corruptBlocks;  // corrupt blocks skipped by the reader
+
+    struct fileMap_s *fileMap;  // map of an uncompressed file for zero copy reads. NULL if not mapped
+
+    off_t cacheOffset;  // start of the written data, not yet dropped from the page cache
+
+    // compression dictionary - kept with the handle, if the handle is reused for the next file
+    struct compressDict_s *dictionary;  // dictionary of this file. NULL if none
+    struct dictSamples_s *dictSamples;  // samples of written blocks to train the next dictionary
+
     stat_record_t *stat_record;  // flow stat record
     char *ident;                 // source identifier
     char *fileName;              // file name
     uint16_t compression_level;  // compression level, if available.
+
+    // adaptive compression
+    _Atomic int adaptLevel;          // compression level for the next block. -1: store uncompressed
+    _Atomic uint64_t compressTime;   // average time to compress a block in ns
+    _Atomic uint64_t blockInterval;  // average time between two blocks in ns
+    _Atomic uint64_t lastBlock;      // time of the last block in ns
+    int columnar;                // write columnar data blocks
 } nffile_t;
 
 #define GetCursor(block) ((void *)(block) + sizeof(dataBlock_t))
@@ -234,12 +287,34 @@ typedef struct record_header_s {
  * for the detailed description of the record definition see nfx.h
  */
 
+/*
+ * optional callback, to check if a data block needs to be read.
+ * Called by the reader for each data block described in the block directory.
+ * zoneMap and bloomFilter are NULL, if not available for this block.
+ * Returns 0, if the block can be skipped
+ */
+typedef int (*blockCheck_t)(blockInfo_t *blockInfo, zoneMap_t *zoneMap, bloomFilter_t *bloomFilter, void *arg);
+
 int Init_nffile(int workers, queue_t *fileList);
 
+void SetBlockCheck(blockCheck_t blockCheck, void *arg);
+
+int BloomTest(const bloomFilter_t *bloomFilter, uint64_t ip0, uint64_t ip1);
+
 int ParseCompression(char *arg);
 
 unsigned ReportBlocks(void);
 
+typedef struct blockPoolStat_s {
+    unsigned inUse;      // data blocks in use
+    unsigned highWater;  // max data blocks in use
+    unsigned pooled;     // free buffers in the pool
+    uint64_t hits;       // blocks served from the pool
+    uint64_t misses;     // blocks newly allocated
+} blockPoolStat_t;
+
+void ReportBlockPool(blockPoolStat_t *blockPoolStat);
+
 void SumStatRecords(stat_record_t *s1, stat_record_t *s2);
 
 nffile_t *OpenFile(char *filename, nffile_t *nffile);
@@ -257,6 +332,10 @@ void PrintGNUplotSumStat(nffile_t *nffile);
 
 int QueryFile(char *filename, int verbose);
 
+int ReadStatRecord(char *filename, stat_record_t *stat_record, char *ident, size_t identLen);
+
+int GetStatInfo(char *filename, stat_record_t *stat_record, char *ident, size_t identLen);
+
 int GetStatRecord(char *filename, stat_record_t *stat_record);
 
 nffile_t *NewFile(nffile_t *nffile);
@@ -275,6 +354,27 @@ dataBlock_t *NewDataBlock(void);
 
 dataBlock_t *ReadBlock(nffile_t *nffile, dataBlock_t *dataBlock);
 
+// random block access
+typedef struct blockIterator_s {
+    nffile_t *nffile;
+    uint32_t next;  // next block to read
+    uint32_t end;   // end of block range
+} blockIterator_t;
+
+nffile_t *OpenFileBlocks(char *filename, nffile_t *nffile);
+
+uint32_t NumDataBlocks(nffile_t *nffile);
+
+dataBlock_t *ReadBlockAt(nffile_t *nffile, uint32_t blockNum);
+
+int SkipBlock(nffile_t *nffile, uint32_t blockNum);
+
+void InitBlockIterator(blockIterator_t *blockIterator, nffile_t *nffile, uint32_t first, uint32_t last);
+
+int SeekBlock(blockIterator_t *blockIterator, uint32_t blockNum);
+
+dataBlock_t *NextBlock(blockIterator_t *blockIterator, dataBlock_t *dataBlock);
+
 dataBlock_t *WriteBlock(nffile_t *nffile, dataBlock_t *dataBlock);
 
 void FlushBlock(nffile_t *nffile, dataBlock_t *dataBlock);
@@ -283,10 +383,14 @@ void FreeDataBlock(dataBlock_t *dataBlock);
 
 void SetIdent(nffile_t *nffile, char *Ident);
 
+void SetColumnar(nffile_t *nffile, int columnar);
+
 void ModifyCompressFile(int compress);
 
 void *nfreader(void *arg);
 
+void *nfdecompressor(void *arg);
+
 void *nfwriter(void *arg);
 
 #endif  //_NFFILE_H
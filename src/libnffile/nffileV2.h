@@ -88,7 +88,8 @@ typedef struct fileHeaderV2_s {
 #define CREATOR_LOOKUP 7
 #define CREATOR_FT2NFDUMP 8
 #define CREATOR_TORLOOKUP 9
-#define MAX_CREATOR 10
+#define CREATOR_NFCOMPACT 10
+#define MAX_CREATOR 11
     off_t offAppendix;  // offset in file for appendix blocks with additional data
 
     uint32_t BlockSize;  // max block size of data blocks
@@ -123,6 +124,14 @@ typedef struct fileHeaderV2_s {
  * array elements without any header. The number of array elements is
  * NumRecords in the block header
  *
+ * datablock type 5 is a columnar block - see columnar.h
+ *   +------------+--------------+-------------+----------+----------+-----+
+ *   |Blockheader | columnheader | row records | column 0 | column 1 | ... |
+ *   +------------+--------------+-------------+----------+----------+-----+
+ * the hot extensions of all records are stored as columns, one array per
+ * extension field. All other data remains in the row records. Type 5 blocks
+ * are converted back into type 3 blocks on reading.
+ *
  */
 typedef struct dataBlock_s {
     uint32_t NumRecords;  // size of this block in bytes without this header
@@ -130,12 +139,15 @@ typedef struct dataBlock_s {
     uint16_t type;        // Block type
 #define DATA_BLOCK_TYPE_3 3
 #define DATA_BLOCK_TYPE_4 4
+#define DATA_BLOCK_TYPE_5 5
     uint16_t flags;  // Bit 0: 0: file block compression, 1: block uncompressed
                      // Bit 1: 0: file block encryption, 1: block unencrypted
                      // Bit 2: 0: no autoread, 1: autoread - internal structure
+                     // Bit 3: 0: no dictionary, 1: compressed with the file dictionary
 #define FLAG_BLOCK_UNCOMPRESSED 0x1
 #define FLAG_BLOCK_UNENCRYPTED 0x2
 #define FLAG_BLOCK_AUTOREAD 0x4
+#define FLAG_BLOCK_DICTIONARY 0x8
 } dataBlock_t;
 
 /*
@@ -155,5 +167,145 @@ typedef struct recordHeader_s {
 
 #define TYPE_IDENT 0x8001
 #define TYPE_STAT 0x8002
+#define TYPE_BLOCKDIR 0x8003
+#define TYPE_ZONEMAP 0x8004
+#define TYPE_BLOOMFILTER 0x8005
+#define TYPE_DICTIONARY 0x8006
+#define TYPE_CHECKSUM 0x8007
+
+/*
+ * Block directory
+ * ===============
+ * The appendix may contain a block directory, which describes each data block
+ * of the file. It allows a reader to skip blocks without reading or uncompressing them.
+ * The directory is split into TYPE_BLOCKDIR records of max BLOCKDIR_CHUNK entries each,
+ * as a record size is limited to 64k.
+ *   +--------------+------------+----------+-----+----------+
+ *   |recordheader  | dir header | entry 0  | ... | entry n  |
+ *   +--------------+------------+----------+-----+----------+
+ */
+typedef struct blockInfo_s {
+    uint64_t offset;      // file offset of the data block header
+    uint32_t size;        // size of the block on disk without block header
+    uint32_t NumRecords;  // number of records in this block
+    uint64_t msecFirst;   // min msecFirst of all flow records
+    uint64_t msecLast;    // max msecLast of all flow records
+    uint16_t type;        // block type
+    uint16_t flags;
+#define BLOCKINFO_META 0x1          // block contains exporter, sampler or other non flow records
+#define BLOCKINFO_UNCOMPRESSED 0x2  // block is stored uncompressed in a compressed file
+    uint16_t level;                 // compression level of this block. 0: default level
+    uint16_t fill;
+} blockInfo_t;
+
+typedef struct blockDir_s {
+    uint32_t firstBlock;  // block number of first entry
+    uint32_t numEntries;  // number of entries in this record
+    blockInfo_t entry[];
+} blockDir_t;
+
+#define BLOCKDIR_CHUNK 1024
+
+/*
+ * Zone map
+ * ========
+ * For each data block in the block directory, the appendix may contain a zone map
+ * with min/max summaries of the most often filtered flow fields. It allows a filter
+ * to prove, that no record of a block can match. Records without the corresponding
+ * extension are not counted in the min/max values.
+ * The zone maps are split into TYPE_ZONEMAP records of max ZONEMAP_CHUNK entries each.
+ *   +--------------+------------+----------+-----+----------+
+ *   |recordheader  | dir header | zone 0   | ... | zone n   |
+ *   +--------------+------------+----------+-----+----------+
+ */
+typedef struct zoneMap_s {
+    uint32_t numRecords;  // number of V3 records
+    uint32_t numFlows;    // records with EXgenericFlow
+    uint32_t numIPv4;     // records with EXipv4Flow
+    uint32_t numIPv6;     // records with EXipv6Flow
+
+    uint64_t protoMap[4];  // bitmap of all protocols
+    uint16_t minSrcPort;
+    uint16_t maxSrcPort;
+    uint16_t minDstPort;
+    uint16_t maxDstPort;
+    uint16_t minExporterID;
+    uint16_t maxExporterID;
+
+    uint32_t minSrc4Addr;
+    uint32_t maxSrc4Addr;
+    uint32_t minDst4Addr;
+    uint32_t maxDst4Addr;
+
+    uint64_t minSrc6Addr[2];
+    uint64_t maxSrc6Addr[2];
+    uint64_t minDst6Addr[2];
+    uint64_t maxDst6Addr[2];
+} zoneMap_t;
+
+typedef struct zoneMapDir_s {
+    uint32_t firstBlock;  // block number of first entry
+    uint32_t numEntries;  // number of entries in this record
+    zoneMap_t entry[];
+} zoneMapDir_t;
+
+#define ZONEMAP_CHUNK 256
+
+/*
+ * Bloom filter
+ * ============
+ * For each data block with flow records, the appendix may contain a Bloom filter
+ * over all src and dst IPv4/IPv6 addresses of the block. IPv4 addresses are hashed
+ * as ::a.b.c.d. Each filter is stored in its own TYPE_BLOOMFILTER record.
+ * The bitmap size is a power of 2 and depends on the number of records in the block.
+ */
+typedef struct bloomFilter_s {
+    uint32_t blockNum;  // data block number
+    uint32_t numBits;   // size of bitmap in bits
+    uint32_t numHash;   // number of hash functions
+    uint32_t fill;
+    uint64_t bits[];
+} bloomFilter_t;
+
+#define BLOOM_BITS_PER_IP 8
+#define BLOOM_NUM_HASH 4
+#define BLOOM_MIN_BITS 512
+#define BLOOM_MAX_BITS (1 << 18)
+
+/*
+ * Compression dictionary
+ * ======================
+ * lz4 and zstd compressed files may contain a compression dictionary in the appendix.
+ * Data blocks with FLAG_BLOCK_DICTIONARY set are compressed with this dictionary.
+ * Appendix blocks are never compressed with the dictionary.
+ */
+typedef struct dictionary_s {
+    uint16_t compression;  // compression the dictionary is made for
+    uint16_t fill;
+    uint32_t size;  // size of dictionary data
+    uint8_t data[];
+} dictionary_t;
+
+#define DICTIONARY_SIZE (32 * 1024)
+
+/*
+ * Block checksums
+ * ===============
+ * For each data block in the block directory, the appendix may contain the CRC32C
+ * of the block as stored on disk - block header and compressed data. A reader detects
+ * corrupt blocks without uncompressing them and resyncs to the next block using the
+ * block directory. The checksums are split into TYPE_CHECKSUM records of max
+ * CHECKSUM_CHUNK entries each.
+ *   +--------------+------------+----------+-----+----------+
+ *   |recordheader  | dir header | crc 0    | ... | crc n    |
+ *   +--------------+------------+----------+-----+----------+
+ */
+typedef struct checksumDir_s {
+    uint32_t firstBlock;  // block number of first entry
+    uint32_t numEntries;  // number of entries in this record
+    uint32_t entry[];
+} checksumDir_t;
+
+#define CHECKSUM_CHUNK 4096
 
 #endif  //_NFFILEV2_H
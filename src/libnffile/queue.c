@@ -32,6 +32,7 @@
 
 #include <arpa/inet.h>
 #include <errno.h>
+#include <limits.h>
 #include <pthread.h>
 #include <signal.h>
 #include <stdarg.h>
@@ -42,9 +43,58 @@
 #include <string.h>
 #include <unistd.h>
 
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
 #include "config.h"
 #include "util.h"
 
+// number of retries on a full or empty queue, before a thread goes to sleep
+// spinning is useless on a single CPU
+#define SPINCOUNT 128
+static unsigned spinCount = 0;
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CPU_RELAX() __builtin_ia32_pause()
+#elif defined(__aarch64__)
+#define CPU_RELAX() __asm__ __volatile__("yield" ::: "memory")
+#else
+#define CPU_RELAX()
+#endif
+
+// sleep, as long as the event counter is unchanged
+static void WaitEvent(queue_t *queue, _Atomic uint32_t *event, uint32_t expected) {
+#ifdef __linux__
+    syscall(SYS_futex, (uint32_t *)event, FUTEX_WAIT_PRIVATE, expected, NULL, NULL, 0);
+#else
+    pthread_mutex_lock(&(queue->mutex));
+    if (atomic_load(event) == expected) pthread_cond_wait(&(queue->cond), &(queue->mutex));
+    pthread_mutex_unlock(&(queue->mutex));
+#endif
+
+}  // End of WaitEvent
+
+// wake one or all threads sleeping on the event counter
+static void WakeEvent(queue_t *queue, _Atomic uint32_t *event, int all) {
+#ifdef __linux__
+    syscall(SYS_futex, (uint32_t *)event, FUTEX_WAKE_PRIVATE, all ? INT_MAX : 1, NULL, NULL, 0);
+#else
+    pthread_mutex_lock(&(queue->mutex));
+    pthread_cond_broadcast(&(queue->cond));
+    pthread_mutex_unlock(&(queue->mutex));
+#endif
+
+}  // End of WakeEvent
+
+// signal an event to the waiting threads, if any
+static inline void SignalEvent(queue_t *queue, _Atomic uint32_t *event, _Atomic unsigned *waiting, int all) {
+    atomic_fetch_add(event, 1);
+    if (atomic_load(waiting)) WakeEvent(queue, event, all);
+
+}  // End of SignalEvent
+
 queue_t *queue_init(size_t length) {
     queue_t *queue;
 
@@ -52,6 +102,8 @@ queue_t *queue_init(size_t length) {
         LogError("Queue length %u not a power of 2", length);
         return NULL;
     }
+    // the ring needs at least 2 elements to tell a filled from a free element
+    if (length < 2) length = 2;
 
     queue = calloc(1, sizeof(queue_t) + length * sizeof(element_t));
     if (!queue) {
@@ -67,11 +119,22 @@ queue_t *queue_init(size_t length) {
         return NULL;
     }
 
-    queue->producers = 1;
+    spinCount = sysconf(_SC_NPROCESSORS_ONLN) > 1 ? SPINCOUNT : 0;
+
     queue->length = length;
     queue->mask = length - 1;
+    atomic_init(&queue->producers, 1);
+    atomic_init(&queue->closed, 0);
     atomic_init(&queue->c_wait, 0);
     atomic_init(&queue->p_wait, 0);
+    atomic_init(&queue->notEmpty, 0);
+    atomic_init(&queue->notFull, 0);
+    atomic_init(&queue->maxUsed, 0);
+    atomic_init(&queue->next_free, 0);
+    atomic_init(&queue->next_avail, 0);
+    for (size_t i = 0; i < length; i++) {
+        atomic_init(&queue->element[i].seq, i);
+    }
 
     return queue;
 
@@ -79,58 +142,50 @@ queue_t *queue_init(size_t length) {
 
 void queue_producers(queue_t *queue, unsigned producers) {
     //
-    queue->producers = producers;
+    atomic_store(&queue->producers, producers);
 }  // End of queue_producers
 
 void queue_free(queue_t *queue) {
     queue_sync(queue);
+    pthread_mutex_destroy(&queue->mutex);
+    pthread_cond_destroy(&queue->cond);
     free(queue);
 
 }  // End of Queue_free
 
 void queue_open(queue_t *queue) {
-    pthread_mutex_lock(&(queue->mutex));
-    queue->closed = 0;
-    pthread_mutex_unlock(&(queue->mutex));
-
+    //
+    atomic_store(&queue->closed, 0);
 }  // End of queue_open
 
 void queue_close(queue_t *queue) {
-    pthread_mutex_lock(&(queue->mutex));
-    queue->producers--;
-    if (queue->producers <= 0) queue->closed = 1;
-    if (queue->c_wait) {
-        pthread_cond_broadcast(&(queue->cond));
-    }
-    pthread_mutex_unlock(&(queue->mutex));
+    if (atomic_fetch_sub(&queue->producers, 1) <= 1) atomic_store(&queue->closed, 1);
+
+    // wake up all waiting threads to check the closed queue
+    SignalEvent(queue, &queue->notEmpty, &queue->c_wait, 1);
+    SignalEvent(queue, &queue->notFull, &queue->p_wait, 1);
 
 }  // End of queue_close
 
 size_t queue_length(queue_t *queue) {
-    pthread_mutex_lock(&(queue->mutex));
-    size_t length = queue->num_elements;
-    pthread_mutex_unlock(&(queue->mutex));
+    size_t avail = atomic_load(&queue->next_avail);
+    size_t length = atomic_load(&queue->next_free) - avail;
 
-    return length;
+    // positions may move in between the two loads
+    return length > queue->length ? queue->length : length;
 
 }  // End of queue_length
 
 queueStat_t queue_stat(queue_t *queue) {
-    pthread_mutex_lock(&(queue->mutex));
-    queueStat_t stat = queue->stat;
-    stat.length = queue->num_elements;
-    queue->stat.maxUsed = 0;
-    pthread_mutex_unlock(&(queue->mutex));
+    queueStat_t stat = {0};
+    stat.maxUsed = atomic_exchange(&queue->maxUsed, 0);
+    stat.length = queue_length(queue);
     return stat;
 }  // End of queue_stat
 
 uint32_t queue_done(queue_t *queue) {
-    pthread_mutex_lock(&(queue->mutex));
-    uint32_t done = queue->num_elements == 0 && queue->closed;
-    pthread_mutex_unlock(&(queue->mutex));
-
-    return done;
-
+    //
+    return atomic_load(&queue->closed) && queue_length(queue) == 0;
 }  // End of queue_length
 
 void queue_sync(queue_t *queue) {
@@ -150,124 +205,186 @@ void queue_sync(queue_t *queue) {
     while (atomic_load(&queue->c_wait) || atomic_load(&queue->p_wait)) {
         struct timeval tv = {0};
         tv.tv_usec = 1;
-        pthread_mutex_lock(&(queue->mutex));
-        pthread_cond_broadcast(&(queue->cond));
-        pthread_mutex_unlock(&(queue->mutex));
+        SignalEvent(queue, &queue->notEmpty, &queue->c_wait, 1);
+        SignalEvent(queue, &queue->notFull, &queue->p_wait, 1);
         select(0, NULL, NULL, NULL, &tv);
     }
 
 }  // end of queue_sync
 
-void *queue_push(queue_t *queue, void *data) {
-    pthread_mutex_lock(&(queue->mutex));
+// try to put data into the next free element. Returns 0, if the queue is full
+// On success, slot is the position of the element in the ring
+static inline int TryPush(queue_t *queue, void *data, size_t *slot) {
+    size_t pos = atomic_load_explicit(&queue->next_free, memory_order_relaxed);
+    element_t *element;
     while (1) {
-        if (queue->closed) {
-            pthread_mutex_unlock(&(queue->mutex));
-            return QUEUE_CLOSED;
+        element = &queue->element[pos & queue->mask];
+        size_t seq = atomic_load_explicit(&element->seq, memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+        if (diff == 0) {
+            // element is free - claim it
+            if (atomic_compare_exchange_weak_explicit(&queue->next_free, &pos, pos + 1, memory_order_relaxed, memory_order_relaxed)) break;
+        } else if (diff < 0) {
+            // element not yet consumed - queue full
+            return 0;
+        } else {
+            // another producer was faster
+            pos = atomic_load_explicit(&queue->next_free, memory_order_relaxed);
         }
-        if (queue->num_elements < queue->length) {
-            unsigned index = queue->next_free;
-            queue->element[index] = data;
-            queue->num_elements++;
-            queue->next_free = (queue->next_free + 1) & queue->mask;
+    }
+    element->data = data;
+    atomic_store_explicit(&element->seq, pos + 1, memory_order_release);
 
-            if (queue->stat.maxUsed < queue->num_elements) queue->stat.maxUsed = queue->num_elements;
+    size_t used = pos + 1 - atomic_load_explicit(&queue->next_avail, memory_order_relaxed);
+    if (used <= queue->length && used > atomic_load_explicit(&queue->maxUsed, memory_order_relaxed))
+        atomic_store_explicit(&queue->maxUsed, used, memory_order_relaxed);
 
-            if (atomic_load(&queue->c_wait)) {
-                pthread_cond_signal(&(queue->cond));
-            }
-            pthread_mutex_unlock(&(queue->mutex));
-            return NULL;
+    *slot = pos;
+    return 1;
+
+}  // End of TryPush
+
+// try to get data from the next filled element. Returns 0, if the queue is empty
+// On success, slot is the position of the element in the ring
+static inline int TryPop(queue_t *queue, void **data, size_t *slot) {
+    size_t pos = atomic_load_explicit(&queue->next_avail, memory_order_relaxed);
+    element_t *element;
+    while (1) {
+        element = &queue->element[pos & queue->mask];
+        size_t seq = atomic_load_explicit(&element->seq, memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+        if (diff == 0) {
+            // element is filled - claim it
+            if (atomic_compare_exchange_weak_explicit(&queue->next_avail, &pos, pos + 1, memory_order_relaxed, memory_order_relaxed)) break;
+        } else if (diff < 0) {
+            // element not yet filled - queue empty
+            return 0;
         } else {
-            queue->p_wait++;
-            pthread_cond_wait(&(queue->cond), &(queue->mutex));
-            queue->p_wait--;
+            // another consumer was faster
+            pos = atomic_load_explicit(&queue->next_avail, memory_order_relaxed);
         }
     }
+    *data = element->data;
+    // free element for the next round
+    atomic_store_explicit(&element->seq, pos + queue->mask + 1, memory_order_release);
 
-    /*NOTREACHED*/
+    *slot = pos;
+    return 1;
 
-}  // End of queue_push
+}  // End of TryPop
 
-void *queue_pop(queue_t *queue) {
-    pthread_mutex_lock(&(queue->mutex));
+/*
+ * Wakeup policy: a sleeping consumer only needs a wakeup, if the queue becomes non empty.
+ * This is the case for the element at the head of the queue. Therefore only the producer,
+ * which filled the element at next_avail wakes a consumer. A woken consumer wakes the
+ * next one with its first element, if more elements are waiting. Producers are handled the same way for the
+ * element, which frees the slot at next_free. This saves a syscall for every element
+ * while the threads are busy.
+ */
+static inline void Pushed(queue_t *queue, size_t pos, int woken) {
+    atomic_fetch_add(&queue->notEmpty, 1);
+    if (atomic_load(&queue->c_wait) && pos <= atomic_load(&queue->next_avail)) WakeEvent(queue, &queue->notEmpty, 0);
+
+    // more free slots - wake the next producer
+    if (woken && atomic_load(&queue->p_wait) && queue_length(queue) < queue->length) WakeEvent(queue, &queue->notFull, 0);
+
+}  // End of Pushed
+
+static inline void Popped(queue_t *queue, size_t pos, int woken) {
+    atomic_fetch_add(&queue->notFull, 1);
+    if (atomic_load(&queue->p_wait) && (atomic_load(&queue->next_free) - pos) >= queue->length)
+        WakeEvent(queue, &queue->notFull, 0);
+
+    // more elements waiting - wake the next consumer
+    if (woken && atomic_load(&queue->c_wait) && atomic_load(&queue->next_free) > (pos + 1)) WakeEvent(queue, &queue->notEmpty, 0);
+
+}  // End of Popped
+
+void *queue_push(queue_t *queue, void *data) {
+    unsigned spin = 0;
+    int woken = 0;
     while (1) {
-        if (queue->closed && queue->num_elements == 0) {
-            pthread_mutex_unlock(&(queue->mutex));
-            return QUEUE_CLOSED;
+        if (atomic_load(&queue->closed)) return QUEUE_CLOSED;
+
+        size_t pos;
+        if (TryPush(queue, data, &pos)) {
+            Pushed(queue, pos, woken);
+            return NULL;
         }
 
-        if (queue->num_elements > 0) {
-            unsigned index = queue->next_avail;
-            void *data = queue->element[index];
-            queue->num_elements--;
-            queue->next_avail = (queue->next_avail + 1) & queue->mask;
+        if (spin < spinCount) {
+            spin++;
+            CPU_RELAX();
+            continue;
+        }
 
-            if (queue->p_wait) {
-                pthread_cond_broadcast(&(queue->cond));
-            }
-            if (queue->closed && queue->c_wait) {
-                pthread_cond_broadcast(&(queue->cond));
-            }
-            pthread_mutex_unlock(&(queue->mutex));
-            return data;
-        } else {
-            atomic_fetch_add(&queue->c_wait, 1);
-            pthread_cond_wait(&(queue->cond), &(queue->mutex));
-            atomic_fetch_sub(&queue->c_wait, 1);
+        // queue full - sleep until an element gets popped
+        uint32_t event = atomic_load(&queue->notFull);
+        atomic_fetch_add(&queue->p_wait, 1);
+        if (atomic_load(&queue->closed) == 0 && queue_length(queue) == queue->length) {
+            WaitEvent(queue, &queue->notFull, event);
+            woken = 1;
         }
+        atomic_fetch_sub(&queue->p_wait, 1);
     }
 
     /*NOTREACHED*/
 
-}  // End of queue_pop
+}  // End of queue_push
 
-/*
-static void *producer(void *arg) {
+// pop an element and return its position in the queue. Positions number the elements
+// in queue order, as they are popped - popping threads do not need a lock for the order
+void *queue_pop_pos(queue_t *queue, size_t *position) {
+    unsigned spin = 0;
+    int woken = 0;
+    while (1) {
+        void *data;
+        size_t pos;
+        if (TryPop(queue, &data, &pos)) {
+            Popped(queue, pos, woken);
+            *position = pos;
+            return data;
+        }
 
-        queue_t *queue = (queue_t *)arg;
+        if (atomic_load(&queue->closed)) {
+            // elements pushed before the close are still delivered
+            if (TryPop(queue, &data, &pos)) {
+                Popped(queue, pos, woken);
+                *position = pos;
+                return data;
+            }
+            return QUEUE_CLOSED;
+        }
 
-        printf("producer started\n");
-        for (long i=1; i< 1024; i++ ) {
-                queue_push(queue, (void *)i);
-                printf("pushed data: %li\n", i);
+        if (spin < spinCount) {
+            spin++;
+            CPU_RELAX();
+            continue;
         }
-        printf("close Q\n");
-        queue_close(queue);
 
-        return NULL;
-}
-
-static void *consumer(void *arg) {
-
-        printf("consumer started\n");
-        queue_t *queue = (queue_t *)arg;
-        static int cnt = 1;
-        while (1) {
-                void *data = queue_get(queue);
-                if ( data == QUEUE_CLOSED ) {
-                        printf("Q closed\n");
-                        break;
-                }
-
-                if ((int)data != cnt ) {
-                        printf("Error compare: expected: %i, got: %i\n", cnt, (int)data);
-                }
-                printf("got data: %li\n", cnt);
-                cnt++;
+        // queue empty - sleep until an element gets pushed
+        uint32_t event = atomic_load(&queue->notEmpty);
+        atomic_fetch_add(&queue->c_wait, 1);
+        if (atomic_load(&queue->closed) == 0 && queue_length(queue) == 0) {
+            WaitEvent(queue, &queue->notEmpty, event);
+            woken = 1;
         }
-        return NULL;
-}
+        atomic_fetch_sub(&queue->c_wait, 1);
+    }
+
+    /*NOTREACHED*/
 
-int main(int argc, char **argv) {
+}  // End of queue_pop_pos
 
-        queue_t *queue = queue_init();
-        pthread_t t1, t2;
+void *queue_pop(queue_t *queue) {
+    size_t pos;
+    return queue_pop_pos(queue, &pos);
+
+}  // End of queue_pop
+
+// position of the next element to pop
+size_t queue_position(queue_t *queue) {
+    //
+    return atomic_load(&queue->next_avail);
 
-        pthread_create(&t1, NULL, producer, (void *)queue);
-        pthread_create(&t2, NULL, consumer, (void *)queue);
-        pthread_join(t2, NULL);
-        printf("Done\n");
-        return 0;
-}
-*/
+}  // End of queue_position
@@ -39,7 +39,14 @@
 #define QUEUE_EMPTY (void *)-2
 #define QUEUE_CLOSED (void *)-3
 
+/*
+ * bounded lock free multi producer/multi consumer queue.
+ * Each element carries a sequence number, which tells producers and consumers,
+ * if the element is free or filled for the current round of the ring.
+ * Threads spin shortly on a full or empty queue and then sleep on an event counter.
+ */
 typedef struct element_s {
+    _Atomic size_t seq;
     void *data;
 } element_t;
 
@@ -48,22 +55,30 @@ typedef struct queueStat_s {
     size_t length;
 } queueStat_t;
 
+#define CACHELINE 64
+
 typedef struct queue_s {
+    // sleep/wakeup of waiting threads, if futex is not available
     pthread_mutex_t mutex;
     pthread_cond_t cond;
-    uint32_t closed;
+    _Atomic uint32_t closed;
 
     size_t length;
     size_t mask;
-    unsigned next_free;
-    unsigned next_avail;
-    int producers;
-    _Atomic unsigned c_wait;
-    _Atomic unsigned p_wait;
-    size_t num_elements;
-
-    queueStat_t stat;
-    void *element[1];
+    _Atomic int producers;
+    _Atomic unsigned c_wait;    // consumers waiting
+    _Atomic unsigned p_wait;    // producers waiting
+    _Atomic uint32_t notEmpty;  // event: element pushed or queue closed
+    _Atomic uint32_t notFull;   // event: element popped or queue closed
+    _Atomic size_t maxUsed;
+
+    char pad0[CACHELINE];
+    _Atomic size_t next_free;  // producer position
+    char pad1[CACHELINE];
+    _Atomic size_t next_avail;  // consumer position
+    char pad2[CACHELINE];
+
+    element_t element[];
 } queue_t;
 
 queue_t *queue_init(size_t length);
@@ -76,6 +91,10 @@ void *queue_push(queue_t *queue, void *data);
 
 void *queue_pop(queue_t *queue);
 
+void *queue_pop_pos(queue_t *queue, size_t *position);
+
+size_t queue_position(queue_t *queue);
+
 void queue_open(queue_t *queue);
 
 void queue_close(queue_t *queue);
@@ -318,7 +318,7 @@ int ProtoNum(char *protoString) {
 }  // End of ProtoNum
 
 char *ProtoString(uint8_t protoNum, uint32_t plainNumbers) {
-    static char s[16];
+    static _Thread_local char s[16];
 
     if (protoNum >= NUMPROTOS || plainNumbers) {
         snprintf(s, 15, "%-5i", protoNum);
@@ -382,7 +382,7 @@ char *fwEventString(int event) {
     }
 
     // unknow event string
-    static char s[16];
+    static _Thread_local char s[16];
     snprintf(s, 15, "%u-Unknw", event);
     s[15] = '\0';
     return s;
@@ -409,7 +409,7 @@ char *fwXEventString(int xeventID) {
     }
 
     // unknow event string
-    static char s[16];
+    static _Thread_local char s[16];
     snprintf(s, 15, "%u", xeventID);
     s[15] = '\0';
     return s;
@@ -432,7 +432,7 @@ int natEventNum(char *natString) {
 char *natEventString(int event, int longName) {
     if (event >= MAX_NAT_EVENTS) {
         // unknow event string
-        static char s[32] = {0};
+        static _Thread_local char s[32] = {0};
         snprintf(s, 31, "%u-Unknown", event);
         return s;
     }
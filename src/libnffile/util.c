@@ -502,26 +502,25 @@ timeWindow_t *ScanTimeFrame(char *tstring) {
 }  // End of ScanTimeFrame
 
 char *TimeString(uint64_t msecStart, uint64_t msecEnd) {
-    static char datestr[255];
+    static _Thread_local char datestr[255];
 
     if (msecStart) {
         time_t secs = msecStart / 1000;
-        struct tm *tbuff = localtime(&secs);
-        if (!tbuff) {
-            LogError("localtime() error in %s line %d: %s", __FILE__, __LINE__, strerror(errno));
+        struct tm tbuff;
+        if (!localtime_r(&secs, &tbuff)) {
+            LogError("localtime_r() error in %s line %d: %s", __FILE__, __LINE__, strerror(errno));
             return "Error time convert";
         }
         char t1[64];
-        strftime(t1, 63, "%Y-%m-%d %H:%M:%S", tbuff);
+        strftime(t1, 63, "%Y-%m-%d %H:%M:%S", &tbuff);
 
         secs = msecEnd / 1000;
-        tbuff = localtime(&secs);
-        if (!tbuff) {
-            LogError("localtime() error in %s line %d: %s", __FILE__, __LINE__, strerror(errno));
+        if (!localtime_r(&secs, &tbuff)) {
+            LogError("localtime_r() error in %s line %d: %s", __FILE__, __LINE__, strerror(errno));
             return "Error time convert";
         }
         char t2[64];
-        strftime(t2, 63, "%Y-%m-%d %H:%M:%S", tbuff);
+        strftime(t2, 63, "%Y-%m-%d %H:%M:%S", &tbuff);
 
         snprintf(datestr, 254, "%s.%3d - %s.%3d", t1, (int)(msecStart % 1000), t2, (int)(msecEnd % 1000));
     } else {
@@ -532,13 +531,13 @@ char *TimeString(uint64_t msecStart, uint64_t msecEnd) {
 }
 
 char *UNIX2ISO(time_t t) {
-    struct tm *when;
-    static char timestring[32];
+    struct tm when;
+    static _Thread_local char timestring[32];
 
-    when = localtime(&t);
-    when->tm_isdst = -1;
-    snprintf(timestring, 31, "%4i%02i%02i%02i%02i%02i", when->tm_year + 1900, when->tm_mon + 1, when->tm_mday, when->tm_hour, when->tm_min,
-             when->tm_sec);
+    localtime_r(&t, &when);
+    when.tm_isdst = -1;
+    snprintf(timestring, 31, "%4i%02i%02i%02i%02i%02i", when.tm_year + 1900, when.tm_mon + 1, when.tm_mday, when.tm_hour, when.tm_min,
+             when.tm_sec);
     timestring[31] = '\0';
 
     return timestring;
@@ -624,7 +623,7 @@ long getTick(void) {
 }
 
 char *DurationString(uint64_t duration) {
-    static char s[128];
+    static _Thread_local char s[128];
     if (duration == 0) {
         strncpy(s, "    00:00:00.000", 128);
     } else {
@@ -0,0 +1,564 @@
+/*
+ *  Copyright (c) 2025, Peter Haag
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *   * Neither the name of the author nor the names of its contributors may be
+ *     used to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*
+ * nfcompact merges the closed interval files of a collector directory into hourly
+ * or daily files. Records are copied in file order into full data blocks, duplicate
+ * exporter and sampler records are dropped. The stat record and appendix of the
+ * merged file are rebuilt. The directory stat file stays locked while compacting
+ * and is updated together with the collector bookkeeping records.
+ */
+
+#include <ctype.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "config.h"
+
+#ifdef HAVE_FTS_H
+#include <fts.h>
+#else
+#include "fts_compat.h"
+#define fts_children fts_children_compat
+#define fts_close fts_close_compat
+#define fts_open fts_open_compat
+#define fts_read fts_read_compat
+#define fts_set fts_set_compat
+#endif
+
+#ifdef HAVE_STDINT_H
+#include <stdint.h>
+#endif
+
+#include "barrier.h"
+#include "bookkeeper.h"
+#include "catalog.h"
+#include "expire.h"
+#include "id.h"
+#include "nfdump.h"
+#include "nffile.h"
+#include "nfstatfile.h"
+#include "util.h"
+
+#include "nffile_inline.c"
+
+typedef struct compactParam_s {
+    uint64_t minAge;    // min age of a time slot after its end
+    uint32_t interval;  // time slot of merged files in seconds
+    int compress;       // compression of merged files. -1: as first input file
+    int verbose;
+} compactParam_t;
+
+typedef struct compactStat_s {
+    uint64_t numMerged;  // number of merged files created
+    uint64_t numFiles;   // number of input files
+    uint64_t sizeIn;
+    uint64_t sizeOut;
+} compactStat_t;
+
+typedef struct channelList_s {
+    stringlist_t dirList;
+    _Atomic uint32_t next;
+    compactParam_t *param;
+    compactStat_t stat;
+} channelList_t;
+
+// records, already written to the merged file
+typedef struct recordList_s {
+    uint32_t numRecords;
+    uint32_t maxRecords;
+    record_header_t **record;
+} recordList_t;
+
+// nfstatfile and bookkeeper keep global lists - serialize access
+static pthread_mutex_t statLock = PTHREAD_MUTEX_INITIALIZER;
+
+static void usage(char *name) {
+    printf(
+        "usage %s [options] \n"
+        "-h\t\tThis text\n"
+        "-l datadir\tCompact files in data directory\n"
+        "-p\t\tdatadir is a profile directory: compact all channels\n"
+        "-i interval\tinterval of merged files: H hourly (default), d daily\n"
+        "-a age\t\tmin age of an interval after its end: w week, d day, H hour, M minute. Default 1H\n"
+        "-z=<comp>\tcompress merged files: lzo, lz4, bz2, zstd. Default as the input files\n"
+        "-W workers\tnumber of channels to compact in parallel\n"
+        "-v\t\tverbose: print each merged file\n",
+        name);
+
+}  // End of usage
+
+// return 1, if record is identical to a record already written, otherwise remember it
+static int SeenRecord(recordList_t *recordList, record_header_t *record) {
+    for (uint32_t i = 0; i < recordList->numRecords; i++) {
+        record_header_t *r = recordList->record[i];
+        if (r->size == record->size && memcmp((void *)r, (void *)record, record->size) == 0) return 1;
+    }
+
+    if (recordList->numRecords == recordList->maxRecords) {
+        recordList->maxRecords += 32;
+        recordList->record = realloc(recordList->record, recordList->maxRecords * sizeof(record_header_t *));
+        if (!recordList->record) {
+            LogError("realloc() error in %s line %d: %s", __FILE__, __LINE__, strerror(errno));
+            exit(250);
+        }
+    }
+    record_header_t *r = malloc(record->size);
+    if (!r) {
+        LogError("malloc() error in %s line %d: %s", __FILE__, __LINE__, strerror(errno));
+        exit(250);
+    }
+    memcpy((void *)r, (void *)record, record->size);
+    recordList->record[recordList->numRecords++] = r;
+
+    return 0;
+
+}  // End of SeenRecord
+
+static void FreeRecordList(recordList_t *recordList) {
+    for (uint32_t i = 0; i < recordList->numRecords; i++) free(recordList->record[i]);
+    free(recordList->record);
+    memset((void *)recordList, 0, sizeof(recordList_t));
+
+}  // End of FreeRecordList
+
+// copy all records of nffile_r into full blocks of nffile_w
+static dataBlock_t *CopyRecords(nffile_t *nffile_r, nffile_t *nffile_w, dataBlock_t *dataBlock_w, recordList_t *recordList) {
+    dataBlock_t *dataBlock = NULL;
+    while ((dataBlock = ReadBlock(nffile_r, dataBlock)) != NULL) {
+        if (dataBlock->type != DATA_BLOCK_TYPE_3) {
+            // keep block order: flush collected records first
+            LogError("Can't process block type %u. Write block unmodified", dataBlock->type);
+            dataBlock_w = WriteBlock(nffile_w, dataBlock_w);
+            FlushBlock(nffile_w, dataBlock);
+            dataBlock = NULL;
+            continue;
+        }
+
+        record_header_t *record_ptr = GetCursor(dataBlock);
+        uint32_t sumSize = 0;
+        for (int i = 0; i < dataBlock->NumRecords; i++) {
+            if ((sumSize + record_ptr->size) > dataBlock->size || (record_ptr->size < sizeof(record_header_t))) {
+                LogError("Corrupt data file %s. Inconsistent block size in %s line %d", nffile_r->fileName, __FILE__, __LINE__);
+                break;
+            }
+            sumSize += record_ptr->size;
+
+            switch (record_ptr->type) {
+                case ExporterInfoRecordType:
+                case SamplerRecordType:
+                    // each interval file repeats the exporter and sampler records
+                    if (SeenRecord(recordList, record_ptr)) break;
+                    dataBlock_w = AppendToBuffer(nffile_w, dataBlock_w, (void *)record_ptr, record_ptr->size);
+                    break;
+                default:
+                    dataBlock_w = AppendToBuffer(nffile_w, dataBlock_w, (void *)record_ptr, record_ptr->size);
+            }
+
+            record_ptr = (record_header_t *)((void *)record_ptr + record_ptr->size);
+        }
+    }
+
+    return dataBlock_w;
+
+}  // End of CopyRecords
+
+// merge files into dirName/fileName. Returns 1 on success, 0 otherwise
+static int MergeFiles(char *dirName, char *fileName, stringlist_t *fileList, int compress, compactStat_t *compactStat) {
+    char tmpName[MAXPATHLEN];
+    char target[MAXPATHLEN];
+    // nfcapd.current.* files are skipped by all readers
+    snprintf(tmpName, MAXPATHLEN, "%s/%s.compact.%lu", dirName, NF_DUMPFILE, (unsigned long)getpid());
+    snprintf(target, MAXPATHLEN, "%s/%s", dirName, fileName);
+
+    stat_record_t stat_record = {0};
+    stat_record.firstseen = 0x7fffffffffffffffLL;
+
+    recordList_t recordList = {0};
+    nffile_t *nffile_r = NewFile(NULL);
+    nffile_t *nffile_w = NULL;
+    dataBlock_t *dataBlock_w = NULL;
+    uint64_t sizeIn = 0;
+
+    for (int i = 0; i < fileList->num_strings; i++) {
+        struct stat fstat;
+        if (stat(fileList->list[i], &fstat) < 0 || OpenFile(fileList->list[i], nffile_r) == NULL) {
+            LogError("Failed to open %s - skip merging into %s", fileList->list[i], target);
+            if (nffile_w) {
+                FlushBlock(nffile_w, dataBlock_w);
+                CloseUpdateFile(nffile_w);
+                DisposeFile(nffile_w);
+                unlink(tmpName);
+            }
+            DisposeFile(nffile_r);
+            FreeRecordList(&recordList);
+            return 0;
+        }
+        sizeIn += 512 * fstat.st_blocks;
+
+        if (nffile_w == NULL) {
+            nffile_w = OpenNewFile(tmpName, NULL, CREATOR_NFCOMPACT, compress >= 0 ? compress : FILE_COMPRESSION(nffile_r), NOT_ENCRYPTED);
+            if (!nffile_w) {
+                CloseFile(nffile_r);
+                DisposeFile(nffile_r);
+                return 0;
+            }
+            SetIdent(nffile_w, FILE_IDENT(nffile_r));
+            dataBlock_w = WriteBlock(nffile_w, NULL);
+        }
+
+        SumStatRecords(&stat_record, nffile_r->stat_record);
+        dataBlock_w = CopyRecords(nffile_r, nffile_w, dataBlock_w, &recordList);
+        CloseFile(nffile_r);
+    }
+    DisposeFile(nffile_r);
+    FreeRecordList(&recordList);
+
+    FlushBlock(nffile_w, dataBlock_w);
+    memcpy((void *)nffile_w->stat_record, (void *)&stat_record, sizeof(stat_record_t));
+    if (CloseUpdateFile(nffile_w) == 0) {
+        DisposeFile(nffile_w);
+        unlink(tmpName);
+        return 0;
+    }
+    DisposeFile(nffile_w);
+
+    // the merged file replaces the first input file, if it has the same name. Until all
+    // input files are removed, flows are duplicated rather than lost on a crash
+    if (rename(tmpName, target) < 0) {
+        LogError("rename() error in %s line %d: %s", __FILE__, __LINE__, strerror(errno));
+        unlink(tmpName);
+        return 0;
+    }
+    for (int i = 0; i < fileList->num_strings; i++) {
+        if (strcmp(fileList->list[i], target) != 0 && unlink(fileList->list[i]) < 0) {
+            LogError("unlink() %s failed: %s", fileList->list[i], strerror(errno));
+        }
+    }
+    UpdateCatalog(target);
+
+    struct stat fstat;
+    if (stat(target, &fstat) < 0) fstat.st_blocks = 0;
+
+    compactStat->numMerged++;
+    compactStat->numFiles += fileList->num_strings;
+    compactStat->sizeIn += sizeIn;
+    compactStat->sizeOut += 512 * fstat.st_blocks;
+
+    return 1;
+
+}  // End of MergeFiles
+
+static void ClearFileList(stringlist_t *fileList) {
+    for (int i = 0; i < fileList->num_strings; i++) free(fileList->list[i]);
+    fileList->num_strings = 0;
+
+}  // End of ClearFileList
+
+#if defined __FreeBSD__
+static int compare(const FTSENT *const *f1, const FTSENT *const *f2) { return strcmp((*f1)->fts_name, (*f2)->fts_name); }  // End of compare
+#else
+static int compare(const FTSENT **f1, const FTSENT **f2) { return strcmp((*f1)->fts_name, (*f2)->fts_name); }  // End of compare
+#endif
+
+// compact all closed time slots of a channel directory
+static void CompactChannel(char *datadir, compactParam_t *param, compactStat_t *channelStat) {
+    dirstat_t *dirstat = NULL;
+    bookkeeper_t *books = NULL;
+
+    // lock the dirstat file, so no nfexpire runs in parallel, and collect new
+    // files from the collector bookkeeping
+    pthread_mutex_lock(&statLock);
+    int ret = ReadStatInfo(datadir, &dirstat, CREATE_AND_LOCK);
+    if (ret != STATFILE_OK && ret != ERR_NOSTATFILE && ret != FORCE_REBUILD) {
+        pthread_mutex_unlock(&statLock);
+        LogError("Failed to read stat file in %s", datadir);
+        return;
+    }
+    int doRescan = ret != STATFILE_OK;
+    int books_stat = AccessBookkeeper(&books, datadir);
+    if (books_stat == BOOKKEEPER_OK) {
+        bookkeeper_t tmp_books;
+        ClearBooks(books, &tmp_books);
+        UpdateDirStat(dirstat, &tmp_books);
+        if (dirstat->status == FORCE_REBUILD) doRescan = 1;
+    }
+    pthread_mutex_unlock(&statLock);
+
+    time_t now = time(NULL);
+    compactStat_t compactStat = {0};
+
+    stringlist_t fileList = {0};
+    InitStringlist(&fileList, 64);
+    char groupDir[MAXPATHLEN] = {0};
+    char groupName[32] = {0};
+    time_t groupStart = 0;
+
+    char *const path[] = {datadir, NULL};
+    FTS *fts = fts_open(path, FTS_LOGICAL, compare);
+    if (!fts) {
+        LogError("fts_open() error in %s line %d: %s", __FILE__, __LINE__, strerror(errno));
+    }
+
+    FTSENT *ftsent = NULL;
+    int done = fts == NULL;
+    while (!done) {
+        ftsent = fts_read(fts);
+        done = ftsent == NULL;
+
+        char fileDir[MAXPATHLEN] = {0};
+        char fileName[32] = {0};
+        if (!done) {
+            if (ftsent->fts_info == FTS_D) {
+                // skip all '.' entries as well as hidden directories and non time directories
+                if (ftsent->fts_level > 0 && (ftsent->fts_name[0] == '.' || !isdigit(ftsent->fts_name[0]))) fts_set(fts, ftsent, FTS_SKIP);
+                continue;
+            }
+            // nfcapd.200604301200   strlen = 19
+            // nfcapd.20190430120010 strlen = 21
+            if (ftsent->fts_info != FTS_F || (ftsent->fts_namelen != 19 && ftsent->fts_namelen != 21) ||
+                strncmp(ftsent->fts_name, "nfcapd.", 7) != 0)
+                continue;
+            char *s = &(ftsent->fts_name[7]);
+            while (*s && isdigit(*s)) s++;
+            if (*s) continue;
+
+            // time slot of the merged file
+            char timeString[16];
+            memcpy(timeString, &(ftsent->fts_name[7]), 12);
+            timeString[12] = '\0';
+            if (param->interval == 3600) {
+                memcpy(&timeString[10], "00", 2);
+            } else {
+                memcpy(&timeString[8], "0000", 4);
+            }
+            snprintf(fileName, sizeof(fileName), "nfcapd.%s", timeString);
+            snprintf(fileDir, MAXPATHLEN, "%.*s", (int)(ftsent->fts_pathlen - ftsent->fts_namelen - 1), ftsent->fts_path);
+
+            if (strcmp(fileName, groupName) == 0 && strcmp(fileDir, groupDir) == 0) {
+                InsertString(&fileList, ftsent->fts_path);
+                continue;
+            }
+        }
+
+        // next time slot - merge the collected files of the closed slot
+        if (fileList.num_strings > 1 && (groupStart + param->interval + param->minAge) <= now) {
+            if (MergeFiles(groupDir, groupName, &fileList, param->compress, &compactStat)) {
+                if (param->verbose) printf("%s/%s: merged %u files\n", groupDir, groupName, fileList.num_strings);
+                if (groupStart < dirstat->first) dirstat->first = groupStart;
+            }
+        }
+        ClearFileList(&fileList);
+
+        if (!done) {
+            strcpy(groupName, fileName);
+            strcpy(groupDir, fileDir);
+            groupStart = ISO2UNIX(&groupName[7]);
+            InsertString(&fileList, ftsent->fts_path);
+        }
+    }
+    if (fts) fts_close(fts);
+    ClearFileList(&fileList);
+    free(fileList.list);
+
+    // update the stat file with the merged files
+    if (doRescan) {
+        RescanDir(datadir, dirstat);
+    } else {
+        dirstat->numfiles -= compactStat.numFiles - compactStat.numMerged;
+        dirstat->filesize -= compactStat.sizeIn - compactStat.sizeOut;
+    }
+
+    pthread_mutex_lock(&statLock);
+    if (books_stat == BOOKKEEPER_OK) ReleaseBookkeeper(books, DETACH_ONLY);
+    WriteStatInfo(dirstat);
+    channelStat->numMerged += compactStat.numMerged;
+    channelStat->numFiles += compactStat.numFiles;
+    channelStat->sizeIn += compactStat.sizeIn;
+    channelStat->sizeOut += compactStat.sizeOut;
+    pthread_mutex_unlock(&statLock);
+
+}  // End of CompactChannel
+
+__attribute__((noreturn)) static void *compactThread(void *arg) {
+    channelList_t *channelList = (channelList_t *)arg;
+
+    uint32_t next;
+    while ((next = atomic_fetch_add(&channelList->next, 1)) < channelList->dirList.num_strings) {
+        char *datadir = channelList->dirList.list[next];
+        if (channelList->param->verbose) printf("Compact channel %s\n", datadir);
+        CompactChannel(datadir, channelList->param, &channelList->stat);
+    }
+
+    pthread_exit(NULL);
+
+}  // End of compactThread
+
+// get the list of channel directories to compact
+static int GetChannelDirs(char *datadir, int isProfile, stringlist_t *dirList) {
+    InitStringlist(dirList, 32);
+    if (!isProfile) {
+        InsertString(dirList, datadir);
+        return 1;
+    }
+
+    DIR *PDIR = opendir(datadir);
+    if (!PDIR) {
+        LogError("Can't read profiledir '%s': %s", datadir, strerror(errno));
+        return 0;
+    }
+    struct dirent *entry;
+    while ((entry = readdir(PDIR)) != NULL) {
+        // skip all '.' entries
+        if (entry->d_name[0] == '.') continue;
+
+        char stringbuf[MAXPATHLEN];
+        snprintf(stringbuf, MAXPATHLEN, "%s/%s", datadir, entry->d_name);
+        struct stat stat_buf;
+        if (stat(stringbuf, &stat_buf) || !S_ISDIR(stat_buf.st_mode)) continue;
+
+        InsertString(dirList, stringbuf);
+    }
+    closedir(PDIR);
+
+    return 1;
+
+}  // End of GetChannelDirs
+
+int main(int argc, char **argv) {
+    char *datadir = NULL;
+    int isProfile = 0;
+    int numWorkers = 0;
+    compactParam_t param = {.minAge = 3600, .interval = 3600, .compress = -1, .verbose = 0};
+
+    int c;
+    while ((c = getopt(argc, argv, "a:hi:l:pvW:z::")) != EOF) {
+        switch (c) {
+            case 'h':
+                usage(argv[0]);
+                exit(0);
+                break;
+            case 'a':
+                CheckArgLen(optarg, 32);
+                if (ParseTimeDef(optarg, &param.minAge) == 0) exit(250);
+                break;
+            case 'i':
+                if (strcmp(optarg, "H") == 0) {
+                    param.interval = 3600;
+                } else if (strcmp(optarg, "d") == 0) {
+                    param.interval = 86400;
+                } else {
+                    LogError("Unknown interval '%s'. Use H hourly or d daily", optarg);
+                    exit(250);
+                }
+                break;
+            case 'l':
+                CheckArgLen(optarg, MAXPATHLEN);
+                datadir = optarg;
+                break;
+            case 'p':
+                isProfile = 1;
+                break;
+            case 'v':
+                param.verbose = 1;
+                break;
+            case 'W':
+                CheckArgLen(optarg, 16);
+                numWorkers = atoi(optarg);
+                if (numWorkers < 1) {
+                    LogError("Number of workers out of range");
+                    exit(250);
+                }
+                break;
+            case 'z':
+                param.compress = ParseCompression(optarg);
+                if (param.compress == -1) {
+                    LogError("Usage for option -z: set -z=lzo, -z=lz4, -z=bz2 or z=zstd for valid compression formats");
+                    exit(250);
+                }
+                break;
+            default:
+                usage(argv[0]);
+                exit(250);
+        }
+    }
+
+    if (!datadir) {
+        LogError("Expect data directory -l <datadir>");
+        usage(argv[0]);
+        exit(250);
+    }
+
+    char *dir = realpath(datadir, NULL);
+    struct stat fstat;
+    if (!dir || stat(dir, &fstat) < 0 || !S_ISDIR(fstat.st_mode)) {
+        LogError("No such directory: %s", datadir);
+        exit(250);
+    }
+
+    channelList_t channelList = {.param = &param};
+    if (!GetChannelDirs(dir, isProfile, &channelList.dirList)) exit(250);
+    atomic_init(&channelList.next, 0);
+
+    if (!Init_nffile(0, NULL)) exit(250);
+
+    // each channel is locked and compacted independently
+    numWorkers = GetNumWorkers(numWorkers);
+    if (numWorkers > (int)channelList.dirList.num_strings) numWorkers = channelList.dirList.num_strings;
+
+    pthread_t tid[MAXWORKERS];
+    for (int i = 0; i < numWorkers; i++) {
+        if (pthread_create(&tid[i], NULL, compactThread, (void *)&channelList) != 0) {
+            LogError("pthread_create() error in %s line %d: %s", __FILE__, __LINE__, strerror(errno));
+            exit(250);
+        }
+    }
+    for (int i = 0; i < numWorkers; i++) pthread_join(tid[i], NULL);
+
+    printf("Merged files:       %llu\n", (unsigned long long)channelList.stat.numFiles);
+    printf("New files:          %llu\n", (unsigned long long)channelList.stat.numMerged);
+    printf("Size before:        %s\n", ScaleValue(channelList.stat.sizeIn));
+    printf("Size after:         %s\n", ScaleValue(channelList.stat.sizeOut));
+
+    return 0;
+
+}  // End of main
@@ -34,6 +34,7 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/time.h>
 #include <unistd.h>
 
@@ -75,14 +76,28 @@ void blocksort(SortElement_t *data, int len);
         }                                \
     }
 
-static int max_threads;
-static int n_threads;
-static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
-static pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
+// min partition size to be sorted by an additional thread
+#define QUICK_THREAD_MIN 100000
+
+// thread control of a single blocksort() call
+// blocksort() may be called by several threads at the same time
+typedef struct sortControl_s {
+    int max_threads;
+    int n_threads;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+} sortControl_t;
+
+// arguments of a sort thread
+typedef struct sortParam_s {
+    sortControl_t *control;
+    SortElement_t *left;
+    SortElement_t *right;
+} sortParam_t;
 
 // static void init(SortElement_t *data, int len);
 
-static void qusort(SortElement_t *left, SortElement_t *right);
+static void qusort(sortControl_t *control, SortElement_t *left, SortElement_t *right);
 
 static void insert_sort(SortElement_t *left, SortElement_t *right);
 
@@ -144,15 +159,16 @@ static void partition(SortElement_t *left0, SortElement_t *right0, SortElement_t
 }
 
 static void *sort_thr(void *arg) {
-    SortElement_t **par = (SortElement_t **)arg;
-    qusort(par[0], par[1]);
+    sortParam_t *param = (sortParam_t *)arg;
+    sortControl_t *control = param->control;
+    qusort(control, param->left, param->right);
     free(arg);
-    pthread_mutex_lock(&mutex);
-    n_threads--;
-    if (n_threads <= 0) {
-        pthread_cond_signal(&cond);
+    pthread_mutex_lock(&control->mutex);
+    control->n_threads--;
+    if (control->n_threads <= 0) {
+        pthread_cond_signal(&control->cond);
     }
-    pthread_mutex_unlock(&mutex);
+    pthread_mutex_unlock(&control->mutex);
     return NULL;
 }
 
@@ -160,61 +176,375 @@ static void qusort_single(SortElement_t *left, SortElement_t *right) {
     SortElement_t *l, *r;
     while (right - left >= 50) {
         partition(left, right, &l, &r, &left, &right);
-        qusort(l, r);
+        qusort_single(l, r);
     }
     insert_sort(left, right);
 }
 
-static void qusort(SortElement_t *left, SortElement_t *right) {
+static void qusort(sortControl_t *control, SortElement_t *left, SortElement_t *right) {
     while (right - left >= 50) {
         SortElement_t *l, *r;
         partition(left, right, &l, &r, &left, &right);
 
-        if (right - left > 100000 && n_threads < max_threads) {
+        if (right - left > QUICK_THREAD_MIN && control->n_threads < control->max_threads) {
             // start a new thread - max_threads is a soft limit
             pthread_t thread;
-            SortElement_t **param = (SortElement_t **)malloc(2 * sizeof(SortElement_t *));
+            sortParam_t *param = (sortParam_t *)malloc(sizeof(sortParam_t));
             if (!param) abort();
-            param[0] = left;
-            param[1] = right;
-            pthread_mutex_lock(&mutex);
-            n_threads++;
-            pthread_mutex_unlock(&mutex);
+            param->control = control;
+            param->left = left;
+            param->right = right;
+            pthread_mutex_lock(&control->mutex);
+            control->n_threads++;
+            pthread_mutex_unlock(&control->mutex);
             pthread_create(&thread, NULL, sort_thr, param);
+            pthread_detach(thread);
             left = l;
             right = r;
         } else {
-            qusort(l, r);
+            qusort(control, l, r);
         }
     }
     insert_sort(left, right);
 }
 
-void blocksort(SortElement_t *data, int len) {
-    // shortcut for few entries
-    if (len < 50) {
+void blocksort_quick(SortElement_t *data, int len) {
+    // shortcut for arrays, which are too small for additional threads
+    if (len <= QUICK_THREAD_MIN) {
         SortElement_t *left = data;
         SortElement_t *right = data + len - 1;
         qusort_single(left, right);
         return;
     }
 
+    sortControl_t control = {
+        .n_threads = 0,
+        .mutex = PTHREAD_MUTEX_INITIALIZER,
+        .cond = PTHREAD_COND_INITIALIZER,
+    };
     int n_cpus = sysconf(_SC_NPROCESSORS_ONLN);
     if (n_cpus > 0)
-        max_threads = n_cpus * 2;
+        control.max_threads = n_cpus * 2;
     else
-        max_threads = 8;
+        control.max_threads = 8;
+
+    // sort in the calling thread - large partitions are sorted by additional threads
+    qusort(&control, data, data + len - 1);
+
+    pthread_mutex_lock(&control.mutex);
+    while (control.n_threads > 0) pthread_cond_wait(&control.cond, &control.mutex);
+    pthread_mutex_unlock(&control.mutex);
+
+}  // End of blocksort_quick
+
+void blocksort_insert(SortElement_t *data, int len) {
+    if (len > 1) insert_sort(data, data + len - 1);
+}  // End of blocksort_insert
 
-    pthread_t thread;
-    SortElement_t **param = (SortElement_t **)malloc(2 * sizeof(SortElement_t *));
+/*
+ * bounded heap top N selection
+ * the heap keeps the topN best elements seen so far. The root is the worst of them:
+ * the smallest count for the largest elements, the largest count for the smallest.
+ */
+#define worse(a, b, ascending) ((ascending) ? (a).count > (b).count : (a).count < (b).count)
+
+// min number of elements per selection thread
+#define TOPN_CHUNK 262144
+
+typedef struct topNParam_s {
+    SortElement_t *data;
+    int len;
+    SortElement_t *heap;
+    int topN;
+    int size;  // number of elements in heap
+    int ascending;
+} topNParam_t;
+
+static inline void heap_down(SortElement_t *heap, int size, int i, int ascending) {
+    SortElement_t h = heap[i];
+    while (1) {
+        int child = 2 * i + 1;
+        if (child >= size) break;
+        if ((child + 1) < size && worse(heap[child + 1], heap[child], ascending)) child++;
+        if (!worse(heap[child], h, ascending)) break;
+        heap[i] = heap[child];
+        i = child;
+    }
+    heap[i] = h;
+}
+
+static inline void heap_up(SortElement_t *heap, int i, int ascending) {
+    SortElement_t h = heap[i];
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        if (!worse(h, heap[parent], ascending)) break;
+        heap[i] = heap[parent];
+        i = parent;
+    }
+    heap[i] = h;
+}
+
+// push all elements of data into the bounded heap of param
+static void heap_select(topNParam_t *param, SortElement_t *data, int len) {
+    SortElement_t *heap = param->heap;
+    int ascending = param->ascending;
+    int size = param->size;
+    int i = 0;
+
+    // fill heap
+    for (; i < len && size < param->topN; i++) {
+        heap[size] = data[i];
+        heap_up(heap, size, ascending);
+        size++;
+    }
+
+    // replace the root, if the element is better than the worst of the heap
+    for (; i < len; i++) {
+        if (worse(heap[0], data[i], ascending)) {
+            heap[0] = data[i];
+            heap_down(heap, size, 0, ascending);
+        }
+    }
+    param->size = size;
+}
+
+static void *topn_thr(void *arg) {
+    topNParam_t *param = (topNParam_t *)arg;
+    heap_select(param, param->data, param->len);
+    return NULL;
+}
+
+/*
+ * select the topN elements with the largest counts, if not ascending, or the smallest
+ * counts, if ascending. The selected elements are sorted ascending by count and placed
+ * at the end of data for the largest and at the start of data for the smallest elements,
+ * so they are found in the same place as after a blocksort() of the full array.
+ * The other elements remain in data in undefined order. If topN <= 0, or topN is
+ * a large part of the array, the full array is sorted by blocksort().
+ */
+void blocksort_topn(SortElement_t *data, int len, int topN, int ascending) {
+    // full sort, if no or not much gain
+    if (topN <= 0 || topN >= (len >> 2)) {
+        blocksort(data, len);
+        return;
+    }
+
+    int numThreads = len / TOPN_CHUNK;
+    if (numThreads > 1) {
+        int n_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        if (numThreads > n_cpus) numThreads = n_cpus;
+    }
+    if (numThreads < 1) numThreads = 1;
+
+    // each thread selects the topN of its chunk into its own heap
+    topNParam_t *param = (topNParam_t *)calloc(numThreads, sizeof(topNParam_t));
+    SortElement_t *heaps = (SortElement_t *)malloc((size_t)numThreads * topN * sizeof(SortElement_t));
+    if (!param || !heaps) abort();
+
+    int chunk = len / numThreads;
+    for (int i = 0; i < numThreads; i++) {
+        param[i].data = data + i * chunk;
+        param[i].len = i == (numThreads - 1) ? len - i * chunk : chunk;
+        param[i].heap = heaps + i * topN;
+        param[i].topN = topN;
+        param[i].size = 0;
+        param[i].ascending = ascending;
+    }
+
+    if (numThreads == 1) {
+        heap_select(&param[0], param[0].data, param[0].len);
+    } else {
+        pthread_t tid[numThreads];
+        for (int i = 0; i < numThreads; i++) {
+            if (pthread_create(&tid[i], NULL, topn_thr, &param[i]) != 0) abort();
+        }
+        for (int i = 0; i < numThreads; i++) pthread_join(tid[i], NULL);
+
+        // merge the heaps of all threads into the first one
+        for (int i = 1; i < numThreads; i++) heap_select(&param[0], param[i].heap, param[i].size);
+    }
+
+    // the root of the heap is the worst selected element. All elements better than
+    // the root and as many elements equal to the root as in the heap are selected.
+    SortElement_t *heap = param[0].heap;
+    int size = param[0].size;
+    uint64_t limit = heap[0].count;
+    int numEqual = 0;
+    for (int i = 0; i < size; i++) {
+        if (heap[i].count == limit) numEqual++;
+    }
+
+    // move the selected elements to the start or end of data by swapping, so data
+    // still holds all elements and can be sorted again by a different order
+    SortElement_t *target;
+    if (ascending) {
+        int w = 0;
+        for (int i = 0; i < len && w < size; i++) {
+            if (data[i].count < limit || (data[i].count == limit && numEqual-- > 0)) {
+                SortElement_t tmp = data[w];
+                data[w++] = data[i];
+                data[i] = tmp;
+            }
+        }
+        target = data;
+    } else {
+        int w = len - 1;
+        for (int i = len - 1; i >= 0 && w >= len - size; i--) {
+            if (data[i].count > limit || (data[i].count == limit && numEqual-- > 0)) {
+                SortElement_t tmp = data[w];
+                data[w--] = data[i];
+                data[i] = tmp;
+            }
+        }
+        target = data + len - size;
+    }
+    blocksort(target, size);
+
+    free(heaps);
+    free(param);
+
+}  // End of blocksort_topn
+
+// min number of elements per radix sort thread
+#define RADIX_CHUNK 262144
+
+#define RADIX_BITS 8
+#define RADIX_SIZE (1 << RADIX_BITS)
+#define RADIX_MASK (RADIX_SIZE - 1)
+
+typedef struct radixParam_s {
+    SortElement_t *src;
+    SortElement_t *dst;
+    int start;
+    int end;
+    int shift;
+    uint64_t first;              // key of the first element
+    uint64_t diff;               // key bits, which differ from the first key
+    uint32_t count[RADIX_SIZE];  // digit histogram, target index while scattering
+} radixParam_t;
+
+static void *radix_diff_thr(void *arg) {
+    radixParam_t *param = (radixParam_t *)arg;
+    uint64_t diff = 0;
+    for (int i = param->start; i < param->end; i++) diff |= param->src[i].count ^ param->first;
+    param->diff = diff;
+    return NULL;
+}
+
+static void *radix_count_thr(void *arg) {
+    radixParam_t *param = (radixParam_t *)arg;
+    memset(param->count, 0, sizeof(param->count));
+    for (int i = param->start; i < param->end; i++) param->count[(param->src[i].count >> param->shift) & RADIX_MASK]++;
+    return NULL;
+}
+
+static void *radix_scatter_thr(void *arg) {
+    radixParam_t *param = (radixParam_t *)arg;
+    for (int i = param->start; i < param->end; i++) {
+        uint32_t digit = (param->src[i].count >> param->shift) & RADIX_MASK;
+        param->dst[param->count[digit]++] = param->src[i];
+    }
+    return NULL;
+}
+
+// run func for all radix params - one thread each
+static void radix_run(void *(*func)(void *), radixParam_t *param, int numThreads) {
+    if (numThreads == 1) {
+        func(&param[0]);
+        return;
+    }
+
+    pthread_t tid[numThreads];
+    for (int i = 0; i < numThreads; i++) {
+        if (pthread_create(&tid[i], NULL, func, &param[i]) != 0) abort();
+    }
+    for (int i = 0; i < numThreads; i++) pthread_join(tid[i], NULL);
+
+}  // End of radix_run
+
+/*
+ * stable LSD radix sort of data ascending by count. Each thread counts and scatters
+ * its own chunk of the array. The digits of all threads are placed in chunk order,
+ * so elements with equal counts keep their order. Digits, which are equal for all
+ * elements are skipped. Falls back to blocksort_quick(), if no buffer can be allocated.
+ */
+void blocksort_radix(SortElement_t *data, int len) {
+    if (len < 2) return;
+
+    SortElement_t *buff = (SortElement_t *)malloc((size_t)len * sizeof(SortElement_t));
+    if (!buff) {
+        blocksort_quick(data, len);
+        return;
+    }
+
+    int numThreads = len / RADIX_CHUNK;
+    if (numThreads > 1) {
+        int n_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        if (numThreads > n_cpus) numThreads = n_cpus;
+    }
+    if (numThreads < 1) numThreads = 1;
+
+    radixParam_t *param = (radixParam_t *)calloc(numThreads, sizeof(radixParam_t));
     if (!param) abort();
-    param[0] = data;
-    param[1] = data + len - 1;
-    pthread_create(&thread, NULL, sort_thr, param);
 
-    pthread_mutex_lock(&mutex);
-    n_threads++;
-    while (n_threads > 0) pthread_cond_wait(&cond, &mutex);
-    pthread_mutex_unlock(&mutex);
+    int chunk = len / numThreads;
+    for (int i = 0; i < numThreads; i++) {
+        param[i].start = i * chunk;
+        param[i].end = i == (numThreads - 1) ? len : (i + 1) * chunk;
+        param[i].src = data;
+        param[i].first = data[0].count;
+    }
+
+    radix_run(radix_diff_thr, param, numThreads);
+    uint64_t diff = 0;
+    for (int i = 0; i < numThreads; i++) diff |= param[i].diff;
+
+    SortElement_t *src = data;
+    SortElement_t *dst = buff;
+    for (int shift = 0; shift < 64; shift += RADIX_BITS) {
+        if (((diff >> shift) & RADIX_MASK) == 0) continue;
+
+        for (int i = 0; i < numThreads; i++) {
+            param[i].src = src;
+            param[i].dst = dst;
+            param[i].shift = shift;
+        }
+        radix_run(radix_count_thr, param, numThreads);
+
+        // target index of each digit and thread
+        uint32_t index = 0;
+        for (int digit = 0; digit < RADIX_SIZE; digit++) {
+            for (int i = 0; i < numThreads; i++) {
+                uint32_t cnt = param[i].count[digit];
+                param[i].count[digit] = index;
+                index += cnt;
+            }
+        }
+        radix_run(radix_scatter_thr, param, numThreads);
+
+        SortElement_t *tmp = src;
+        src = dst;
+        dst = tmp;
+    }
+
+    if (src != data) memcpy(data, src, (size_t)len * sizeof(SortElement_t));
+
+    free(param);
+    free(buff);
+
+}  // End of blocksort_radix
+
+/*
+ * sort data ascending by count. The sort strategy is chosen by the number of elements:
+ * insertion sort for a few elements, the parallel quicksort for medium sized arrays
+ * and the radix sort for large arrays. See sortbench in src/test for the limits.
+ */
+void blocksort(SortElement_t *data, int len) {
+    if (len <= SORT_INSERT_MAX)
+        blocksort_insert(data, len);
+    else if (len < SORT_RADIX_MIN)
+        blocksort_quick(data, len);
+    else
+        blocksort_radix(data, len);
 
-}  // End of blocksort
\ No newline at end of file
+}  // End of blocksort
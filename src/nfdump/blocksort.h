@@ -42,6 +42,18 @@ typedef struct SortElement_s {
     uint64_t count;
 } SortElement_t;
 
+// blocksort() selects one of the sort strategies below by the number of elements
+#define SORT_INSERT_MAX 32
+#define SORT_RADIX_MIN 4096
+
 void blocksort(SortElement_t *data, int len);
 
+void blocksort_insert(SortElement_t *data, int len);
+
+void blocksort_quick(SortElement_t *data, int len);
+
+void blocksort_radix(SortElement_t *data, int len);
+
+void blocksort_topn(SortElement_t *data, int len, int topN, int ascending);
+
 #endif  //_BLOCKSORT_H
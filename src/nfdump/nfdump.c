@@ -65,6 +65,7 @@
 #include "nfdump_1_6_x.h"
 #include "nffile.h"
 #include "nflowcache.h"
+#include "nfmerge.h"
 #include "nfnet.h"
 #include "nfprof.h"
 #include "nfstat.h"
@@ -83,10 +84,21 @@ typedef struct dataHandle_s {
     dataBlock_t *dataBlock;
     char *ident;
     uint64_t recordCnt;
+    uint64_t seq;  // block sequence for the ordered output
+    // selection vector of the filter thread: offsets of all records to be processed
+    // and the mapped record handles of the passed flow records in the same order
+    uint32_t numSelected;
+    uint32_t numPassed;
+    uint32_t *selection;
+    recordHandle_t *handles;
+    // passed records rendered by the filter thread for printing
+    char *text;
+    size_t textLen;
 } dataHandle_t;
 
 typedef struct prepareArgs_s {
     queue_t *prepareQueue;
+    queue_t *mergeList;  // file list for the time ordered merge of -M sources
     uint32_t processedBlocks;
     uint32_t skippedBlocks;
 } prepareArgs_t;
@@ -99,10 +111,31 @@ typedef struct filterArgs_s {
     int hasGeoDB;
     queue_t *prepareQueue;
     queue_t *processQueue;
+    // aggregate the passed flows in the filter threads
+    int aggregate;
+    // update the element statistics in the filter threads
+    int elementStat;
+    // collect the passed flows for -O sorting in the filter threads
+    int sortRecords;
+    // render the passed records for printing in the filter threads
+    RecordPrinter_t render;
+    outputParams_t *outputParams;
+    uint64_t nextRenderSeq;
+    uint32_t renderedRecords;
+    // keep the block order of the prepare thread
+    int ordered;
+    uint64_t nextSeq;
+    pthread_mutex_t orderLock;
+    pthread_cond_t orderCond;
     _Atomic uint64_t processedRecords;
     _Atomic uint64_t passedRecords;
 } filterArgs_t;
 
+typedef struct blockCheckArgs_s {
+    timeWindow_t *timeWindow;
+    void *engine;
+} blockCheckArgs_t;
+
 typedef struct filterStat_s {
     uint32_t processedRecords;
     uint32_t passedRecords;
@@ -112,6 +145,7 @@ static uint64_t total_bytes = 0;
 static uint64_t totalRecords = 0;
 static uint64_t totalPassed = 0;
 static uint32_t skippedBlocks = 0;
+static int columnar = 0;
 static uint64_t t_firstMsec = 0, t_lastMsec = 0;
 static _Atomic uint32_t abortProcessing = 0;
 
@@ -127,7 +161,9 @@ static int SetStat(char *str, int *element_stat, int *flow_stat);
 static void PrintSummary(stat_record_t *stat_record, outputParams_t *outputParams);
 
 static stat_record_t process_data(void *engine, int processMode, char *wfile, RecordPrinter_t print_record, timeWindow_t *timeWindow,
-                                  uint64_t limitRecords, outputParams_t *outputParams, int compress);
+                                  uint64_t limitRecords, outputParams_t *outputParams, int compress, uint32_t worker, queue_t *mergeList);
+
+static int CheckBlock(blockInfo_t *blockInfo, zoneMap_t *zoneMap, bloomFilter_t *bloomFilter, void *arg);
 
 /* Functions */
 
@@ -164,6 +200,7 @@ static void usage(char *name) {
         "-z=bz2\t\tBZIP2 compress flows in output file.\n"
         "-z=lz4[:level]\tLZ4 compress flows in output file.\n"
         "-z=zstd[:level]\tZSTD compress flows in output file.\n"
+        "-Y\t\tWrite columnar data blocks to output file.\n"
         "-l <expr>\tSet limit on packets for line and packed output format.\n"
         "\t\tkey: 32 character string or 64 digit hex string starting with 0x.\n"
         "-L <expr>\tSet limit on bytes for line and packed output format.\n"
@@ -195,7 +232,7 @@ static void usage(char *name) {
         "-6\t\tPrint full length of IPv6 addresses in fmt output instead of condensed.\n"
         "-E <file>\tPrint exporter and sampling info for collected flows.\n"
         "-v <file>\tverify netflow data file. Print version and blocks.\n"
-        "-W <num>\tOptionally set the number of workers to compress flows\n"
+        "-W <num>\tOptionally set the number of workers to compress and filter flows\n"
         "-x <file>\tverify extension records in netflow data file.\n"
         "-X\t\tDump Filtertable and exit (debug option).\n"
         "-Z\t\tCheck filter syntax and exit.\n"
@@ -270,6 +307,88 @@ static int SetStat(char *str, int *element_stat, int *flow_stat) {
 
 }  // End of SetStat
 
+// block check for the file reader - a data block may be skipped, if none of its
+// flows can match the time window or the filter in filterThread()
+static int CheckBlock(blockInfo_t *blockInfo, zoneMap_t *zoneMap, bloomFilter_t *bloomFilter, void *arg) {
+    blockCheckArgs_t *blockCheckArgs = (blockCheckArgs_t *)arg;
+
+    timeWindow_t *timeWindow = blockCheckArgs->timeWindow;
+    if (timeWindow) {
+        uint64_t twin_msecLast = timeWindow->msecLast ? timeWindow->msecLast : 0x7FFFFFFFFFFFFFFFLL;
+        if (blockInfo->msecLast <= timeWindow->msecFirst || blockInfo->msecFirst >= twin_msecLast) return 0;
+    }
+
+    if ((zoneMap || bloomFilter) && blockCheckArgs->engine) return FilterBlock(blockCheckArgs->engine, zoneMap, bloomFilter);
+
+    return 1;
+
+}  // End of CheckBlock
+
+// convert the data block of dataHandle into a processable V3 block.
+// Returns 0, if the block is skipped. The data block is freed then
+static int PrepareBlock(dataHandle_t *dataHandle) {
+    switch (dataHandle->dataBlock->type) {
+        case DATA_BLOCK_TYPE_1:
+            LogError("nfdump 1.5.x block type 1 no longer supported. Skip block");
+            break;
+        case DATA_BLOCK_TYPE_2: {
+            dataBlock_t *v3DataBlock = NewDataBlock();
+            ConvertBlockType2(dataHandle->dataBlock, v3DataBlock);
+            FreeDataBlock(dataHandle->dataBlock);
+            dataHandle->dataBlock = v3DataBlock;
+            return 1;
+        }
+        case DATA_BLOCK_TYPE_3:
+            // processed blocks
+            return 1;
+        case DATA_BLOCK_TYPE_4:
+            // silently skipped
+            break;
+        default:
+            LogError("Unknown block type %u. Skip block", dataHandle->dataBlock->type);
+    }
+
+    FreeDataBlock(dataHandle->dataBlock);
+    dataHandle->dataBlock = NULL;
+    return 0;
+
+}  // End of PrepareBlock
+
+// free the selection vector and the record handles of dataHandle
+static void FreeSelection(dataHandle_t *dataHandle) {
+    if (dataHandle->handles) {
+        // the slot after the last passed record may be used by a dropped record
+        for (uint32_t i = 0; i <= dataHandle->numPassed; i++) {
+            recordHandle_t *recordHandle = &dataHandle->handles[i];
+            if (recordHandle->extensionList[SSLindex]) free(recordHandle->extensionList[SSLindex]);
+            if (recordHandle->extensionList[JA3index]) free(recordHandle->extensionList[JA3index]);
+            if (recordHandle->extensionList[JA4index]) free(recordHandle->extensionList[JA4index]);
+        }
+        free(dataHandle->handles);
+    }
+    if (dataHandle->selection) free(dataHandle->selection);
+    dataHandle->handles = NULL;
+    dataHandle->selection = NULL;
+    dataHandle->numSelected = dataHandle->numPassed = 0;
+
+}  // End of FreeSelection
+
+// render the passed records of a block into a text buffer, which is written by the main thread
+static void RenderBlock(dataHandle_t *dataHandle, RecordPrinter_t render, outputParams_t *outputParams) {
+    FILE *stream = open_memstream(&dataHandle->text, &dataHandle->textLen);
+    if (!stream) {
+        LogError("open_memstream() error in %s line %d: %s", __FILE__, __LINE__, strerror(errno));
+        exit(255);
+    }
+
+    outputParams->ident = dataHandle->ident;
+    for (uint32_t i = 0; i < dataHandle->numPassed; i++) {
+        render(stream, &dataHandle->handles[i], outputParams);
+    }
+    fclose(stream);
+
+}  // End of RenderBlock
+
 __attribute__((noreturn)) static void *prepareThread(void *arg) {
     prepareArgs_t *prepareArgs = (prepareArgs_t *)arg;
 
@@ -288,6 +407,7 @@ __attribute__((noreturn)) static void *prepareThread(void *arg) {
 
     dataHandle_t *dataHandle = NULL;
     uint64_t recordCnt = 0;
+    uint64_t seq = 0;
     int processedBlocks = 0;
     int skippedBlocks = 0;
 
@@ -301,6 +421,8 @@ __attribute__((noreturn)) static void *prepareThread(void *arg) {
 
         // get next data block from file
         if (dataHandle->dataBlock == NULL) {
+            // blocks skipped by the reader, using the block directory
+            skippedBlocks += nffile->skippedBlocks;
             // continue with next file
             if (GetNextFile(nffile) == NULL) {
                 done = 1;
@@ -314,32 +436,13 @@ __attribute__((noreturn)) static void *prepareThread(void *arg) {
         }
 
         processedBlocks++;
-        switch (dataHandle->dataBlock->type) {
-            case DATA_BLOCK_TYPE_1:
-                LogError("nfdump 1.5.x block type 1 no longer supported. Skip block");
-                goto SKIP;
-                break;
-            case DATA_BLOCK_TYPE_2: {
-                dataBlock_t *v3DataBlock = NewDataBlock();
-                ConvertBlockType2(dataHandle->dataBlock, v3DataBlock);
-                FreeDataBlock(dataHandle->dataBlock);
-                dataHandle->dataBlock = v3DataBlock;
-            } break;
-            case DATA_BLOCK_TYPE_3:
-                // processed blocks
-                break;
-            case DATA_BLOCK_TYPE_4:
-                // silently skipped
-                goto SKIP;
-                break;
-            default:
-                LogError("Unknown block type %u. Skip block", dataHandle->dataBlock->type);
-            SKIP:
-                skippedBlocks++;
-                continue;
+        if (!PrepareBlock(dataHandle)) {
+            skippedBlocks++;
+            continue;
         }
 
         dataHandle->recordCnt = recordCnt;
+        dataHandle->seq = seq++;
         recordCnt += (uint64_t)dataHandle->dataBlock->NumRecords;
         queue_push(prepareQueue, (void *)dataHandle);
         dataHandle = NULL;
@@ -360,12 +463,85 @@ __attribute__((noreturn)) static void *prepareThread(void *arg) {
 
 }  // End of prepareThread
 
+// prepare thread for multiple sources -M. The files of all sources for the same time
+// slot are merged by the merge reader, so the blocks are passed in time order
+__attribute__((noreturn)) static void *mergeThread(void *arg) {
+    prepareArgs_t *prepareArgs = (prepareArgs_t *)arg;
+
+    dbg_printf("mergeThread started\n");
+
+    // dispatch args
+    queue_t *prepareQueue = prepareArgs->prepareQueue;
+
+    uint32_t numFiles = 0;
+    char **fileList = GetMergeSlots(prepareArgs->mergeList, &numFiles);
+
+    uint64_t recordCnt = 0;
+    uint64_t seq = 0;
+    uint32_t processedBlocks = 0;
+    uint32_t skippedBlocks = 0;
+    t_firstMsec = 0x7fffffffffffffffLL;
+    t_lastMsec = 0;
+
+    uint32_t slot = 0;
+    while (slot < numFiles && !abortProcessing) {
+        uint32_t slotSize = SlotSize(&fileList[slot], numFiles - slot);
+        mergeReader_t *mergeReader = OpenMergeReader(&fileList[slot], slotSize);
+        slot += slotSize;
+        if (!mergeReader) continue;
+
+        if (mergeReader->msecFirst < t_firstMsec) t_firstMsec = mergeReader->msecFirst;
+        if (mergeReader->msecLast > t_lastMsec) t_lastMsec = mergeReader->msecLast;
+
+        char *ident = NULL;
+        dataBlock_t *dataBlock = NULL;
+        while (!abortProcessing && (dataBlock = ReadMergedBlock(mergeReader, &ident)) != NULL) {
+            processedBlocks++;
+            dataHandle_t *dataHandle = calloc(1, sizeof(dataHandle_t));
+            if (!dataHandle) {
+                LogError("calloc() error in %s line %d: %s", __FILE__, __LINE__, strerror(errno));
+                FreeDataBlock(dataBlock);
+                break;
+            }
+            dataHandle->dataBlock = dataBlock;
+            if (!PrepareBlock(dataHandle)) {
+                skippedBlocks++;
+                free(dataHandle);
+                continue;
+            }
+            dataHandle->ident = ident != NULL ? strdup(ident) : NULL;
+            dataHandle->recordCnt = recordCnt;
+            dataHandle->seq = seq++;
+            recordCnt += (uint64_t)dataHandle->dataBlock->NumRecords;
+            queue_push(prepareQueue, (void *)dataHandle);
+        }
+        dbg_printf("mergeThread slot: %u files, passed blocks: %u, merged blocks: %u\n", slotSize, mergeReader->passedBlocks,
+                   mergeReader->mergedBlocks);
+        skippedBlocks += mergeReader->skippedBlocks;
+        CloseMergeReader(mergeReader);
+    }
+
+    for (uint32_t i = 0; i < numFiles; i++) free(fileList[i]);
+    if (fileList) free(fileList);
+    if (t_firstMsec > t_lastMsec) t_firstMsec = t_lastMsec = 0;
+
+    dbg_printf("mergeThread done. blocks processed: %u, skipped: %u\n", processedBlocks, skippedBlocks);
+    queue_close(prepareQueue);
+
+    prepareArgs->processedBlocks = processedBlocks;
+    prepareArgs->skippedBlocks = skippedBlocks;
+    dbg_printf("mergeThread exit\n");
+    pthread_exit(NULL);
+
+}  // End of mergeThread
+
 __attribute__((noreturn)) static void *filterThread(void *arg) {
     filterArgs_t *filterArgs = (filterArgs_t *)arg;
 
+    // worker index of this filter thread
+    uint32_t self = filterArgs->self++;
 #ifdef DEVEL
     uint32_t numBlocks = 0;
-    uint32_t self = ++filterArgs->self;
     printf("Filter thread %i started\n", self);
 #endif
 
@@ -374,6 +550,14 @@ __attribute__((noreturn)) static void *filterThread(void *arg) {
     queue_t *processQueue = filterArgs->processQueue;
     void *engine = FilterCloneEngine(filterArgs->engine);
     int hasGeoDB = filterArgs->hasGeoDB;
+    int aggregate = filterArgs->aggregate;
+    int elementStat = filterArgs->elementStat;
+    int sortRecords = filterArgs->sortRecords;
+    RecordPrinter_t render = filterArgs->render;
+
+    // own copy for the ident and the record counter of the rendered blocks
+    outputParams_t outputParams = {0};
+    if (render) outputParams = *filterArgs->outputParams;
 
     timeWindow_t *timeWindow = filterArgs->timeWindow;
 
@@ -388,12 +572,6 @@ __attribute__((noreturn)) static void *filterThread(void *arg) {
             twin_msecLast = 0x7FFFFFFFFFFFFFFFLL;
     }
 
-    recordHandle_t *recordHandle = calloc(1, sizeof(recordHandle_t));
-    if (recordHandle == NULL) {
-        LogError("malloc() error in %s line %d: %s", __FILE__, __LINE__, strerror(errno));
-        exit(255);
-    }
-
     // counters for this thread
     uint64_t processedRecords = 0;
     uint64_t passedRecords = 0;
@@ -416,6 +594,16 @@ __attribute__((noreturn)) static void *filterThread(void *arg) {
         printf("Filter thread %i working on next Block: %u, records: %u\n", self, numBlocks, dataBlock->NumRecords);
 #endif
 
+        // one extra handle slot for the last dropped record
+        uint32_t *selection = malloc((dataBlock->NumRecords + 1) * sizeof(uint32_t));
+        recordHandle_t *handles = calloc(dataBlock->NumRecords + 1, sizeof(recordHandle_t));
+        if (selection == NULL || handles == NULL) {
+            LogError("malloc() error in %s line %d: %s", __FILE__, __LINE__, strerror(errno));
+            exit(255);
+        }
+        uint32_t numSelected = 0;
+        uint32_t numPassed = 0;
+
         record_header_t *record_ptr = GetCursor(dataBlock);
         uint32_t sumSize = 0;
         for (int i = 0; i < dataBlock->NumRecords; i++) {
@@ -443,6 +631,8 @@ __attribute__((noreturn)) static void *filterThread(void *arg) {
                     break;
                 case V3Record: {
                     recordHeaderV3_t *recordHeaderV3 = (recordHeaderV3_t *)record_ptr;
+                    // map into the next free slot. It is reused, if the record does not match
+                    recordHandle_t *recordHandle = &handles[numPassed];
                     int match = MapRecordHandle(recordHandle, recordHeaderV3, recordCounter);
                     // Time based filter
                     // if no time filter is given, the result is always true
@@ -460,60 +650,93 @@ __attribute__((noreturn)) static void *filterThread(void *arg) {
                         match = FilterRecord(engine, recordHandle);
                     }
                     if (match) {  // record passed all filters
-                        SetFlag(recordHeaderV3->flags, V3_FLAG_PASSED);
+                        if (aggregate) AddFlowCacheWorker(self, recordHandle);
+                        if (elementStat) AddElementStatWorker(self, recordHandle);
+                        if (sortRecords) InsertFlowWorker(self, recordHandle);
+                        selection[numSelected++] = (void *)record_ptr - GetCursor(dataBlock);
+                        numPassed++;
                         passedRecords++;
-                    } else {
-                        ClearFlag(recordHeaderV3->flags, V3_FLAG_PASSED);
                     }
 
                 } break;
-                case ExtensionMapType:
-                case ExporterInfoRecordType:
-                case ExporterStatRecordType:
-                case SamplerRecordType:
-                case NbarRecordType:
-                case IfNameRecordType:
-                case VrfNameRecordType:
-                    // Silently skip exporter/sampler records
-                    break;
-
-                default: {
-                    LogError("Skip unknown record: %" PRIu64 " type %i", recordCounter, record_ptr->type);
-                }
+                default:
+                    // exporter/sampler, legacy and unknown records are processed by the main thread
+                    selection[numSelected++] = (void *)record_ptr - GetCursor(dataBlock);
             }
 
             // Advance pointer by number of bytes for netflow record
             record_ptr = (record_header_t *)((void *)record_ptr + record_ptr->size);
         }
+        dataHandle->selection = selection;
+        dataHandle->handles = handles;
+        dataHandle->numSelected = numSelected;
+        dataHandle->numPassed = numPassed;
+        if (sumSize == 0) FreeSelection(dataHandle);
+
+        if (render) {
+            // the number of records printed before this block is known in block order
+            pthread_mutex_lock(&filterArgs->orderLock);
+            while (dataHandle->seq != filterArgs->nextRenderSeq) pthread_cond_wait(&filterArgs->orderCond, &filterArgs->orderLock);
+            outputParams.recordCount = filterArgs->renderedRecords;
+            filterArgs->renderedRecords += dataHandle->numPassed;
+            filterArgs->nextRenderSeq++;
+            pthread_cond_broadcast(&filterArgs->orderCond);
+            pthread_mutex_unlock(&filterArgs->orderLock);
+
+            if (dataHandle->numPassed) RenderBlock(dataHandle, render, &outputParams);
+        }
+
         dbg_printf("Filter thread %i push next block: %u\n", self, numBlocks);
-        if (sumSize) queue_push(processQueue, dataHandle);
+        if (filterArgs->ordered) {
+            // wait for the preceding blocks
+            pthread_mutex_lock(&filterArgs->orderLock);
+            while (dataHandle->seq != filterArgs->nextSeq) pthread_cond_wait(&filterArgs->orderCond, &filterArgs->orderLock);
+            if (sumSize) queue_push(processQueue, dataHandle);
+            filterArgs->nextSeq++;
+            pthread_cond_broadcast(&filterArgs->orderCond);
+            pthread_mutex_unlock(&filterArgs->orderLock);
+        } else if (sumSize) {
+            queue_push(processQueue, dataHandle);
+        }
     }
 
     queue_close(processQueue);
     dbg_printf("FilterThread %d done. blocks: %u records: %" PRIu64 " \n", self, numBlocks, processedRecords);
 
-    free(recordHandle);
     filterArgs->processedRecords += processedRecords;
     filterArgs->passedRecords += passedRecords;
     pthread_exit(NULL);
 }  // End of filterThread
 
 static stat_record_t process_data(void *engine, int processMode, char *wfile, RecordPrinter_t print_record, timeWindow_t *timeWindow,
-                                  uint64_t limitRecords, outputParams_t *outputParams, int compress) {
+                                  uint64_t limitRecords, outputParams_t *outputParams, int compress, uint32_t worker, queue_t *mergeList) {
     stat_record_t stat_record = {0};
     stat_record.firstseen = 0x7fffffffffffffffLL;
 
-    // launch prepareThread
-    prepareArgs_t prepareArgs = {.prepareQueue = queue_init(8)};
+    // skip data blocks outside the time window or without any matching record
+    blockCheckArgs_t blockCheckArgs = {.timeWindow = timeWindow, .engine = engine};
+    SetBlockCheck(CheckBlock, (void *)&blockCheckArgs);
+
+    // launch prepareThread or mergeThread for the time ordered merge of -M sources
+    prepareArgs_t prepareArgs = {.prepareQueue = queue_init(8), .mergeList = mergeList};
     pthread_t tidPrepare;
-    int err = pthread_create(&tidPrepare, NULL, prepareThread, (void *)&prepareArgs);
+    int err = pthread_create(&tidPrepare, NULL, mergeList ? mergeThread : prepareThread, (void *)&prepareArgs);
     if (err) {
         LogError("pthread_create() error in %s line %d: %s", __FILE__, __LINE__, strerror(errno));
         exit(255);
     }
 
     // check numWorkers depending on cores online
-    uint32_t numWorkers = GetNumWorkers(0);
+    uint32_t numWorkers = GetNumWorkers(worker);
+
+    // -A, -s record, the -s element statistics and the -O record lists are processed in
+    // the filter threads, unless the number of records is limited by -c
+    int aggregate = (processMode == FLOWSTAT || processMode == ELEMENTFLOWSTAT) && limitRecords == 0 && SetFlowCacheWorkers(numWorkers);
+    int elementStat = (processMode == ELEMENTSTAT || processMode == ELEMENTFLOWSTAT) && limitRecords == 0 && SetElementStatWorkers(numWorkers);
+    int sortRecords = processMode == SORTRECORDS && limitRecords == 0 && SetFlowListWorkers(numWorkers);
+    // the records are rendered by the filter threads, if the output format allows it and the
+    // number of records is not limited by -c. Printed records are always in block order
+    RecordPrinter_t render = processMode == PRINTRECORD && limitRecords == 0 && outputParams->parallel ? print_record : NULL;
     filterArgs_t filterArgs = {
         .engine = engine,
         .numWorkers = numWorkers,
@@ -521,6 +744,17 @@ static stat_record_t process_data(void *engine, int processMode, char *wfile, Re
         .processQueue = queue_init(8),
         .timeWindow = timeWindow,
         .hasGeoDB = outputParams->hasGeoDB,
+        .aggregate = aggregate,
+        .elementStat = elementStat,
+        .sortRecords = sortRecords,
+        .render = render,
+        .outputParams = outputParams,
+        .nextRenderSeq = 0,
+        .renderedRecords = outputParams->recordCount,
+        .ordered = mergeList != NULL || processMode == PRINTRECORD,
+        .nextSeq = 0,
+        .orderLock = PTHREAD_MUTEX_INITIALIZER,
+        .orderCond = PTHREAD_COND_INITIALIZER,
     };
     queue_producers(filterArgs.processQueue, numWorkers);
 
@@ -542,11 +776,10 @@ static stat_record_t process_data(void *engine, int processMode, char *wfile, Re
             stat_record.firstseen = 0;
             return stat_record;
         }
+        SetColumnar(nffile_w, columnar);
         dataBlock_w = WriteBlock(nffile_w, NULL);
     }
 
-    recordHandle_t *recordHandle = calloc(1, sizeof(recordHandle_t));
-
     // number of flows passed the filter
     dbg(uint32_t numBlocks = 0);
     int done = 0;
@@ -559,29 +792,24 @@ static stat_record_t process_data(void *engine, int processMode, char *wfile, Re
 
         dbg(numBlocks++);
         dataBlock_t *dataBlock = dataHandle->dataBlock;
-        record_header_t *record_ptr = GetCursor(dataBlock);
+        void *cursor = GetCursor(dataBlock);
 
-        uint64_t recordCounter = dataHandle->recordCnt;
         outputParams->ident = dataHandle->ident;
 
         // successfully read block
         total_bytes += dataBlock->size;
 
-        dbg_printf("processData() Next block: %d, Records: %u\n", numBlocks, dataBlock->NumRecords);
+        dbg_printf("processData() Next block: %d, Records: %u, selected: %u\n", numBlocks, dataBlock->NumRecords, dataHandle->numSelected);
 
-        for (int i = 0; i < dataBlock->NumRecords && !abortProcessing; i++) {
-            recordCounter++;
-            // process records
+        // process the records selected by the filter thread only
+        uint32_t numHandles = 0;
+        for (uint32_t i = 0; i < dataHandle->numSelected && !abortProcessing; i++) {
+            record_header_t *record_ptr = (record_header_t *)(cursor + dataHandle->selection[i]);
             switch (record_ptr->type) {
                 case V3Record: {
-                    recordHeaderV3_t *recordHeaderV3 = (recordHeaderV3_t *)record_ptr;
-                    // check if filter matched
-                    if (TestFlag(recordHeaderV3->flags, V3_FLAG_PASSED) == 0) goto NEXT;
-
-                    // clear filter flag after use
-                    ClearFlag(recordHeaderV3->flags, V3_FLAG_PASSED);
+                    // already mapped by the filter thread
+                    recordHandle_t *recordHandle = &dataHandle->handles[numHandles++];
                     totalRecords++;
-                    MapRecordHandle(recordHandle, (recordHeaderV3_t *)record_ptr, recordCounter);
                     // check if we are done, if -c option was set
                     if (limitRecords) abortProcessing = totalRecords >= limitRecords;
 
@@ -589,23 +817,23 @@ static stat_record_t process_data(void *engine, int processMode, char *wfile, Re
 
                     switch (processMode) {
                         case FLOWSTAT:
-                            AddFlowCache(recordHandle);
+                            if (!aggregate) AddFlowCache(recordHandle);
                             break;
                         case ELEMENTSTAT:
-                            AddElementStat(recordHandle);
+                            if (!elementStat) AddElementStat(recordHandle);
                             break;
                         case ELEMENTFLOWSTAT:
-                            AddFlowCache(recordHandle);
-                            AddElementStat(recordHandle);
+                            if (!aggregate) AddFlowCache(recordHandle);
+                            if (!elementStat) AddElementStat(recordHandle);
                             break;
                         case SORTRECORDS:
-                            InsertFlow(recordHandle);
+                            if (!sortRecords) InsertFlow(recordHandle);
                             break;
                         case WRITEFILE:
                             dataBlock_w = AppendToBuffer(nffile_w, dataBlock_w, (void *)record_ptr, record_ptr->size);
                             break;
                         case PRINTRECORD:
-                            print_record(stdout, recordHandle, outputParams);
+                            if (!render) print_record(stdout, recordHandle, outputParams);
                             break;
                     }
 
@@ -661,13 +889,18 @@ static stat_record_t process_data(void *engine, int processMode, char *wfile, Re
                     LogError("Skip unknown record type %i\n", record_ptr->type);
                 }
             }
-        NEXT:
-            // Advance pointer by number of bytes for netflow record
-            record_ptr = (record_header_t *)((void *)record_ptr + record_ptr->size);
-
-        }  // for all records
+        }  // for all selected records
+
+        if (dataHandle->text) {
+            // records rendered by the filter thread
+            fwrite(dataHandle->text, 1, dataHandle->textLen, stdout);
+            free(dataHandle->text);
+            dataHandle->text = NULL;
+            outputParams->recordCount += dataHandle->numPassed;
+        }
 
         // free resources
+        FreeSelection(dataHandle);
         FreeDataBlock(dataHandle->dataBlock);
         if (dataHandle->ident) {
             outputParams->ident = dataHandle->ident;
@@ -701,6 +934,9 @@ static stat_record_t process_data(void *engine, int processMode, char *wfile, Re
         }
         dbg_printf("processData() filter thread: %d\n", i);
     }
+    if (aggregate) MergeFlowCache();
+    if (elementStat) MergeElementStat();
+    SetBlockCheck(NULL, NULL);
 
     totalPassed = filterArgs.passedRecords;
     skippedBlocks = prepareArgs.skippedBlocks;
@@ -766,7 +1002,7 @@ int main(int argc, char **argv) {
 
     Ident[0] = '\0';
     int c;
-    while ((c = getopt(argc, argv, "6aA:Bbc:C:D:E:G:s:gH:hn:i:jf:qyz::r:v:w:J:M:NImO:P:R:XZt:TVv:W:x:o:")) != EOF) {
+    while ((c = getopt(argc, argv, "6aA:Bbc:C:D:E:G:s:gH:hn:i:jf:qyYz::r:v:w:J:M:NImO:P:R:XZt:TVv:W:x:o:")) != EOF) {
         switch (c) {
             case 'h':
                 usage(argv[0]);
@@ -854,6 +1090,9 @@ int main(int argc, char **argv) {
                 }
                 compress = BZ2_COMPRESSED;
                 break;
+            case 'Y':
+                columnar = 1;
+                break;
             case 'y':
                 if (compress) {
                     LogError("Use one compression only: set -z=lzo, -z=lz4, -z=bz2 or z=zstd for valid compression formats");
@@ -1115,7 +1354,14 @@ int main(int argc, char **argv) {
     }
 
     queue_t *fileList = SetupInputFileSequence(&flist);
-    if (!fileList || !Init_nffile(worker, fileList)) exit(EXIT_FAILURE);
+    // -I reads the stat records from the directory catalog or the file appendix only
+    // no file needs to be prefetched then
+    int statOnly = print_stat && ModifyCompress < 0 && strlen(Ident) == 0;
+    // flows of multiple sources -M are printed or written in time order. The files of all
+    // sources are merged slot by slot by the mergeThread instead of read one after the other
+    int mergeMode = flist.multiple_dirs && !print_stat && ModifyCompress < 0 && strlen(Ident) == 0 &&
+                    !(aggregate || flow_stat || element_stat || print_order);
+    if (!fileList || !Init_nffile(worker, statOnly || mergeMode ? NULL : fileList)) exit(EXIT_FAILURE);
 
     // Modify compression
     if (ModifyCompress >= 0) {
@@ -1134,7 +1380,6 @@ int main(int argc, char **argv) {
     }
 
     if (print_stat) {
-        nffile_t *nffile;
         if (!flist.single_file && !flist.multiple_files && !flist.multiple_dirs) {
             LogError("Expect data file(s).\n");
             exit(EXIT_FAILURE);
@@ -1142,18 +1387,22 @@ int main(int argc, char **argv) {
 
         memset((void *)&sum_stat, 0, sizeof(stat_record_t));
         sum_stat.firstseen = 0x7fffffffffffffff;
-        nffile = GetNextFile(NULL);
-        if (!nffile) {
-            LogError("Error open file: %s\n", strerror(errno));
-            exit(250);
-        }
         char *ident = NULL;
-        if (nffile->ident) {
-            ident = strdup(nffile->ident);
+        uint32_t numFiles = 0;
+        char *fileName;
+        while ((fileName = queue_pop(fileList)) != QUEUE_CLOSED) {
+            stat_record_t stat_record;
+            char fileIdent[IDENTLEN];
+            if (GetStatInfo(fileName, &stat_record, fileIdent, IDENTLEN)) {
+                if (numFiles == 0 && strlen(fileIdent) > 0) ident = strdup(fileIdent);
+                SumStatRecords(&sum_stat, &stat_record);
+                numFiles++;
+            }
+            free(fileName);
         }
-        while (nffile != NULL) {
-            SumStatRecords(&sum_stat, nffile->stat_record);
-            nffile = GetNextFile(nffile);
+        if (numFiles == 0) {
+            LogError("Error open file: %s\n", strerror(errno));
+            exit(250);
         }
         PrintStat(&sum_stat, ident);
         free(ident);
@@ -1257,7 +1506,8 @@ int main(int argc, char **argv) {
     }
 
     nfprof_start(&profile_data);
-    sum_stat = process_data(engine, processMode, wfile, print_record, flist.timeWindow, limitRecords, outputParams, compress);
+    sum_stat = process_data(engine, processMode, wfile, print_record, flist.timeWindow, limitRecords, outputParams, compress, worker,
+                            mergeMode ? fileList : NULL);
     nfprof_end(&profile_data, totalRecords);
 
     if (totalPassed == 0) {
@@ -1269,6 +1519,7 @@ int main(int argc, char **argv) {
             nffile_t *nffile = OpenNewFile(wfile, NULL, CREATOR_NFDUMP, compress, NOT_ENCRYPTED);
             if (!nffile) exit(EXIT_FAILURE);
             SetIdent(nffile, outputParams->ident);
+            SetColumnar(nffile, columnar);
             if (ExportFlowTable(nffile, aggregate, bidir, GuessDir)) {
                 CloseUpdateFile(nffile);
             } else {
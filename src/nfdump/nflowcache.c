@@ -36,6 +36,7 @@
 #include <ctype.h>
 #include <errno.h>
 #include <netinet/in.h>
+#include <pthread.h>
 #include <signal.h>
 #include <stddef.h>
 #include <stdint.h>
@@ -160,10 +161,8 @@ static struct aggregationElement_s {
 // FlowHash stat record, to aggregate flow counters in -A or -s stat/aggregate mode
 // original flow record attached for later printing the record
 // for -A -s hashkey points to the aggregation key in hash table
-// for -O <sort> next points to next record in list
 typedef struct FlowHashRecord {
     recordHeaderV3_t *flowrecord;  // orig flow record for printing
-    struct FlowHashRecord *next;   // record chain for flow list, unused otherwise
 
     uint8_t inFlags;   // tcp in flags
     uint8_t outFlags;  // tcp out flags XXX unused currently
@@ -181,6 +180,8 @@ typedef struct FlowHashRecord {
     uint64_t outBytes;
     uint64_t flows;
 
+    uint64_t flowCount;  // input record number of the first flow aggregated
+
 } FlowHashRecord_t;
 
 // order functions prototype
@@ -356,14 +357,13 @@ static flowHash_t *flowHash_init(uint32_t bitSize) {
 
 }  // End of flowHash_init
 
-static void flowHash_free(void) {
+static void flowHash_free(flowHash_t *flowHash) {
     if (!flowHash) return;
 
     free(flowHash->flags);
     free(flowHash->cells);
     free(flowHash->records);
     free(flowHash);
-    flowHash = NULL;
 
 }  // End of flowHash_free
 
@@ -487,12 +487,39 @@ static inline int flowHash_get(flowHash_t *flowHash, const hashValue_t value) {
     } while (1);
 }
 
-// linear FlowList for -O sorting
-static struct FlowList_s {
-    FlowHashRecord_t *head;
-    FlowHashRecord_t **tail;
+/*
+ * parallel aggregation in the filter threads:
+ * each worker aggregates into its own set of numPartitions hash tables. The partition
+ * is selected by the key hash, so a key is found in the same partition of any worker.
+ * MergeFlowCache() merges the partitions of all workers with one thread per partition.
+ */
+#define InitPartitionHashBits 25
+
+// partition index of a key hash. The lower 7 bits are used for the cell flag
+#define PartitionIndex(hash, numParts) (((hash) >> 7) % (numParts))
+
+typedef struct flowCacheWorker_s {
+    flowHash_t **partition;  // numPartitions hash tables of this worker
+    void *keyMem;            // preallocated key memory for keys > 16 bytes
+} flowCacheWorker_t;
+
+static flowCacheWorker_t *cacheWorker = NULL;
+static uint32_t numCacheWorkers = 0;
+static uint32_t numPartitions = 0;
+
+// merged partitions, set by MergeFlowCache()
+static flowHash_t **flowPartitions = NULL;
+
+// linear flow lists for -O sorting - one per filter worker
+#define FlowListBlockSize 65536
+typedef struct flowList_s {
+    FlowHashRecord_t *records;
     size_t NumRecords;
-} FlowList = {0};
+    size_t MaxRecords;
+} flowList_t;
+
+static flowList_t *FlowList = NULL;
+static uint32_t numFlowLists = 0;
 
 static size_t maxKeyLen = 0;
 static uint32_t bidir_flows = 0;
@@ -745,6 +772,14 @@ static inline int New_HashKey(void *keymem, recordHandle_t *recordHandle, int sw
         for (int i = 0; aggregateInfo[i] >= 0; i++) {
             // apply src/dst mask bits if requested
             uint32_t tableIndex = aggregateInfo[i];
+            // a flow with IPv4 and IPv6 addresses uses the IPv4 alternate of an element only
+            // maxKeyLen does not cover both alternates
+            if (ipv4Flow && aggregationTable[tableIndex].param.af == AF_INET6 && i > 0) {
+                uint32_t prevIndex = aggregateInfo[i - 1];
+                if (aggregationTable[prevIndex].param.af == AF_INET &&
+                    strcmp(aggregationTable[prevIndex].aggrElement, aggregationTable[tableIndex].aggrElement) == 0)
+                    continue;
+            }
             if (aggregationTable[tableIndex].netmaskID == 0xFF) {
                 ApplyNetMaskBits(recordHandle, &aggregationTable[tableIndex]);
             } else if (aggregationTable[tableIndex].netmaskID) {
@@ -955,7 +990,12 @@ int Init_FlowCache(int hasGeoDB) {
     if (!nfalloc_Init(0)) return 0;
 
     flowHash = flowHash_init(InitFlowHashBits);
-    FlowList = (struct FlowList_s){.head = NULL, .tail = &FlowList.head, .NumRecords = 0};
+    FlowList = (flowList_t *)calloc(1, sizeof(flowList_t));
+    if (!FlowList) {
+        LogError("calloc() error in %s line %d: %s", __FILE__, __LINE__, strerror(errno));
+        return 0;
+    }
+    numFlowLists = 1;
     // ipv4 fits into sizeof(FlowKeyV6_t)
     maxKeyLen = sizeof(FlowKeyV6_t);
 
@@ -966,7 +1006,17 @@ int Init_FlowCache(int hasGeoDB) {
 }  // End of Init_FlowCache
 
 void Dispose_FlowTable(void) {
-    flowHash_free();
+    flowHash_free(flowHash);
+    flowHash = NULL;
+    if (flowPartitions) {
+        for (uint32_t i = 0; i < numPartitions; i++) flowHash_free(flowPartitions[i]);
+        free(flowPartitions);
+        flowPartitions = NULL;
+    }
+    for (uint32_t i = 0; i < numFlowLists; i++) free(FlowList[i].records);
+    free(FlowList);
+    FlowList = NULL;
+    numFlowLists = 0;
     nfalloc_free();
 }  // End of Dispose_FlowTable
 
@@ -1327,14 +1377,24 @@ char *ParseAggregateMask(char *print_format, char *arg) {
 
 }  // End of ParseAggregateMask
 
-void InsertFlow(recordHandle_t *recordHandle) {
-    dbg_printf("Enter %s\n", __func__);
+static void InsertFlowList(flowList_t *flowList, recordHandle_t *recordHandle) {
     EXgenericFlow_t *genericFlow = (EXgenericFlow_t *)recordHandle->extensionList[EXgenericFlowID];
     if (!genericFlow) return;
 
     recordHeaderV3_t *recordHeaderV3 = recordHandle->recordHeaderV3;
 
-    FlowHashRecord_t *record = (FlowHashRecord_t *)nfmalloc(sizeof(FlowHashRecord_t));
+    if (flowList->NumRecords == flowList->MaxRecords) {
+        size_t maxRecords = flowList->MaxRecords ? 2 * flowList->MaxRecords : FlowListBlockSize;
+        FlowHashRecord_t *records = (FlowHashRecord_t *)realloc(flowList->records, maxRecords * sizeof(FlowHashRecord_t));
+        if (!records) {
+            LogError("realloc() error in %s line %d: %s", __FILE__, __LINE__, strerror(errno));
+            exit(255);
+        }
+        flowList->records = records;
+        flowList->MaxRecords = maxRecords;
+    }
+
+    FlowHashRecord_t *record = &(flowList->records[flowList->NumRecords++]);
     record->flowrecord = (recordHeaderV3_t *)nfmalloc(recordHeaderV3->size);
     memcpy((void *)record->flowrecord, (void *)recordHeaderV3, recordHeaderV3->size);
 
@@ -1356,14 +1416,42 @@ void InsertFlow(recordHandle_t *recordHandle) {
     }
     record->inFlags = genericFlow->tcpFlags;
     record->outFlags = 0;
-    FlowList.NumRecords++;
+    record->swap = 0;
+    record->flowCount = recordHandle->flowCount;
+
+}  // End of InsertFlowList
+
+void InsertFlow(recordHandle_t *recordHandle) {
+    dbg_printf("Enter %s\n", __func__);
 
-    record->next = NULL;
-    *FlowList.tail = record;
-    FlowList.tail = &(record->next);
+    InsertFlowList(&FlowList[0], recordHandle);
 
 }  // End of InsertFlow
 
+// setup one flow list for each filter worker for -O sorting
+int SetFlowListWorkers(uint32_t numWorkers) {
+    dbg_printf("Enter %s\n", __func__);
+
+    if (numWorkers <= numFlowLists) return 1;
+
+    flowList_t *flowList = (flowList_t *)realloc(FlowList, numWorkers * sizeof(flowList_t));
+    if (!flowList) {
+        LogError("realloc() error in %s line %d: %s", __FILE__, __LINE__, strerror(errno));
+        return 0;
+    }
+    memset(&flowList[numFlowLists], 0, (numWorkers - numFlowLists) * sizeof(flowList_t));
+    FlowList = flowList;
+    numFlowLists = numWorkers;
+
+    return 1;
+
+}  // End of SetFlowListWorkers
+
+// insert a flow into the list of the filter worker
+void InsertFlowWorker(uint32_t worker, recordHandle_t *recordHandle) {
+    InsertFlowList(&FlowList[worker], recordHandle);
+}  // End of InsertFlowWorker
+
 static void AddBidirFlow(recordHandle_t *recordHandle) {
     dbg_printf("Enter %s\n", __func__);
     EXgenericFlow_t *genericFlow = (EXgenericFlow_t *)recordHandle->extensionList[EXgenericFlowID];
@@ -1515,11 +1603,10 @@ static void AddBidirFlow(recordHandle_t *recordHandle) {
 
 }  // End of AddBidirFlow
 
-void AddFlowCache(recordHandle_t *recordHandle) {
-    dbg_printf("\nEnter %s\n", __func__);
+// aggregate the flow of recordHandle into the matching partition of a hash table set
+// keyMem holds the preallocated key memory for keys > 16 bytes of this table set
+static inline void AggregateFlow(flowHash_t **partition, uint32_t numParts, void **keyMem, recordHandle_t *recordHandle) {
     EXgenericFlow_t *genericFlow = (EXgenericFlow_t *)recordHandle->extensionList[EXgenericFlowID];
-    if (!genericFlow) return;
-
     EXcntFlow_t *cntFlow = (EXcntFlow_t *)recordHandle->extensionList[EXcntFlowID];
     uint64_t inPackets = genericFlow->inPackets;
     uint64_t inBytes = genericFlow->inBytes;
@@ -1532,10 +1619,8 @@ void AddFlowCache(recordHandle_t *recordHandle) {
         aggrFlows = cntFlow->flows ? cntFlow->flows : 1;
     }
 
-    if (bidir_flows) return AddBidirFlow(recordHandle);
-
     void *keymem = NULL;
-    static void *mem = NULL;
+    void *mem = *keyMem;
     recordHeaderV3_t *record = recordHandle->recordHeaderV3;
 
     hashValue_t hashValue = {0};
@@ -1549,7 +1634,7 @@ void AddFlowCache(recordHandle_t *recordHandle) {
     if (maxKeyLen > 16) {
         if (mem == NULL) {
             dbg_printf("Allocate: %zu\n", maxKeyLen);
-            mem = nfmalloc(maxKeyLen);
+            mem = *keyMem = nfmalloc(maxKeyLen);
         } else {
             dbg_printf("Recycle: %zu\n", maxKeyLen);
         }
@@ -1575,6 +1660,7 @@ void AddFlowCache(recordHandle_t *recordHandle) {
 
     hashValue.hash = metrohash64_1(keymem, keyLen, 0);
 
+    flowHash_t *flowHash = numParts == 1 ? partition[0] : partition[PartitionIndex(hashValue.hash, numParts)];
     int insert;
     int index = flowHash_add(flowHash, hashValue, &insert);
     if (insert == 0) {
@@ -1605,15 +1691,146 @@ void AddFlowCache(recordHandle_t *recordHandle) {
 
         flowHash->records[index].msecFirst = genericFlow->msecFirst;
         flowHash->records[index].msecLast = genericFlow->msecLast;
+        flowHash->records[index].flowCount = recordHandle->flowCount;
         flowHash->records[index].swap = NeedSwap(keymem);
         void *p = nfmalloc(record->size);
         memcpy((void *)p, record, record->size);
         flowHash->records[index].flowrecord = p;
-        mem = NULL;
+        // keymem got part of the cache
+        *keyMem = NULL;
     }
 
+}  // End of AggregateFlow
+
+void AddFlowCache(recordHandle_t *recordHandle) {
+    dbg_printf("\nEnter %s\n", __func__);
+    EXgenericFlow_t *genericFlow = (EXgenericFlow_t *)recordHandle->extensionList[EXgenericFlowID];
+    if (!genericFlow) return;
+
+    if (bidir_flows) return AddBidirFlow(recordHandle);
+
+    static void *mem = NULL;
+    AggregateFlow(&flowHash, 1, &mem, recordHandle);
+
 }  // End of AddFlowCache
 
+// parallel aggregation - called by the filter thread worker
+void AddFlowCacheWorker(uint32_t worker, recordHandle_t *recordHandle) {
+    EXgenericFlow_t *genericFlow = (EXgenericFlow_t *)recordHandle->extensionList[EXgenericFlowID];
+    if (!genericFlow) return;
+
+    flowCacheWorker_t *flowCacheWorker = &cacheWorker[worker];
+    AggregateFlow(flowCacheWorker->partition, numPartitions, &flowCacheWorker->keyMem, recordHandle);
+
+}  // End of AddFlowCacheWorker
+
+int SetFlowCacheWorkers(uint32_t numWorkers) {
+    dbg_printf("Enter %s\n", __func__);
+
+    // bidir aggregation depends on the record order and is done by the main thread
+    if (bidir_flows || numWorkers == 0) return 0;
+
+    cacheWorker = (flowCacheWorker_t *)calloc(numWorkers, sizeof(flowCacheWorker_t));
+    if (!cacheWorker) {
+        LogError("calloc() error in %s line %d: %s", __FILE__, __LINE__, strerror(errno));
+        return 0;
+    }
+
+    numCacheWorkers = numWorkers;
+    numPartitions = numWorkers;
+    for (int i = 0; i < numWorkers; i++) {
+        cacheWorker[i].partition = (flowHash_t **)calloc(numPartitions, sizeof(flowHash_t *));
+        if (!cacheWorker[i].partition) {
+            LogError("calloc() error in %s line %d: %s", __FILE__, __LINE__, strerror(errno));
+            return 0;
+        }
+        for (int j = 0; j < numPartitions; j++) {
+            cacheWorker[i].partition[j] = flowHash_init(InitPartitionHashBits);
+            if (!cacheWorker[i].partition[j]) {
+                LogError("calloc() error in %s line %d: %s", __FILE__, __LINE__, strerror(errno));
+                return 0;
+            }
+        }
+    }
+
+    return 1;
+
+}  // End of SetFlowCacheWorkers
+
+// merge the flow records of partition src into partition dst
+static void flowHash_merge(flowHash_t *dst, flowHash_t *src) {
+    for (uint32_t i = 0; i < src->capacity; i++) {
+        if (is_free(src->flags, i)) continue;
+
+        FlowHashRecord_t *srcRecord = &(src->records[src->cells[i].index]);
+        int insert;
+        int index = flowHash_add(dst, src->cells[i], &insert);
+        FlowHashRecord_t *dstRecord = &(dst->records[index]);
+        if (insert) {
+            *dstRecord = *srcRecord;
+            continue;
+        }
+
+        dstRecord->inBytes += srcRecord->inBytes;
+        dstRecord->inPackets += srcRecord->inPackets;
+        dstRecord->outBytes += srcRecord->outBytes;
+        dstRecord->outPackets += srcRecord->outPackets;
+        dstRecord->flows += srcRecord->flows;
+        dstRecord->inFlags |= srcRecord->inFlags;
+        if (srcRecord->msecFirst < dstRecord->msecFirst) dstRecord->msecFirst = srcRecord->msecFirst;
+        if (srcRecord->msecLast > dstRecord->msecLast) dstRecord->msecLast = srcRecord->msecLast;
+
+        // keep the first flow of the input as the record to print
+        if (srcRecord->flowCount < dstRecord->flowCount) {
+            dstRecord->flowrecord = srcRecord->flowrecord;
+            dstRecord->flowCount = srcRecord->flowCount;
+        }
+    }
+
+}  // End of flowHash_merge
+
+static void *mergePartitionThread(void *arg) {
+    uint32_t part = (uint32_t)(uintptr_t)arg;
+
+    // merge all workers into the partition of worker 0
+    flowHash_t *dst = cacheWorker[0].partition[part];
+    for (int i = 1; i < numCacheWorkers; i++) {
+        flowHash_merge(dst, cacheWorker[i].partition[part]);
+        flowHash_free(cacheWorker[i].partition[part]);
+        cacheWorker[i].partition[part] = NULL;
+    }
+
+    return NULL;
+
+}  // End of mergePartitionThread
+
+// merge the partitions of all filter thread workers
+// must be called after all workers are done
+void MergeFlowCache(void) {
+    dbg_printf("Enter %s\n", __func__);
+    if (!cacheWorker) return;
+
+    pthread_t tid[numPartitions];
+    for (uint32_t i = 0; i < numPartitions; i++) {
+        int err = pthread_create(&tid[i], NULL, mergePartitionThread, (void *)(uintptr_t)i);
+        if (err) {
+            LogError("pthread_create() error in %s line %d: %s", __FILE__, __LINE__, strerror(err));
+            exit(255);
+        }
+    }
+    for (uint32_t i = 0; i < numPartitions; i++) {
+        if (pthread_join(tid[i], NULL)) {
+            LogError("pthread_join() error in %s line %d: %s", __FILE__, __LINE__, strerror(errno));
+        }
+    }
+
+    flowPartitions = cacheWorker[0].partition;
+    for (int i = 1; i < numCacheWorkers; i++) free(cacheWorker[i].partition);
+    free(cacheWorker);
+    cacheWorker = NULL;
+
+}  // End of MergeFlowCache
+
 // return a linear list of aggregated/listed flows for later sorting
 static SortElement_t *GetSortList(uint64_t *size) {
     dbg_printf("Enter %s\n", __func__);
@@ -1621,7 +1838,12 @@ static SortElement_t *GetSortList(uint64_t *size) {
     SortElement_t *list = NULL;
     *size = 0;
 
-    uint64_t hashSize = flowHash->count;
+    // main thread hash table or merged partitions of the parallel aggregation
+    flowHash_t **hashTable = flowPartitions ? flowPartitions : &flowHash;
+    uint32_t numTables = flowPartitions ? numPartitions : 1;
+
+    uint64_t hashSize = 0;
+    for (uint32_t i = 0; i < numTables; i++) hashSize += hashTable[i]->count;
 
     if (hashSize) {  // hash table
         list = (SortElement_t *)calloc(hashSize, sizeof(SortElement_t));
@@ -1630,13 +1852,25 @@ static SortElement_t *GetSortList(uint64_t *size) {
             return NULL;
         }
 
-        for (uint32_t i = 0; i < flowHash->count; i++) {
-            list[i].record = (void *)&(flowHash->records[i]);
+        uint64_t index = 0;
+        for (uint32_t i = 0; i < numTables; i++) {
+            for (uint32_t j = 0; j < hashTable[i]->count; j++) {
+                list[index].record = (void *)&(hashTable[i]->records[j]);
+                list[index].count = hashTable[i]->records[j].flowCount;
+                index++;
+            }
         }
+        // restore the input order of the flows of the partitions
+        if (numTables > 1) blocksort(list, hashSize);
         *size = hashSize;
 
-    } else if (FlowList.NumRecords) {  // linear flow list
-        size_t listSize = FlowList.NumRecords;
+    } else {  // linear flow lists
+        size_t listSize = 0;
+        uint32_t numLists = 0;
+        for (uint32_t i = 0; i < numFlowLists; i++) {
+            listSize += FlowList[i].NumRecords;
+            if (FlowList[i].NumRecords) numLists++;
+        }
         if (!listSize) {
             return NULL;
         }
@@ -1646,11 +1880,16 @@ static SortElement_t *GetSortList(uint64_t *size) {
             return NULL;
         }
 
-        FlowHashRecord_t *flowRecord = FlowList.head;
-        for (int i = 0; i < listSize; i++) {
-            list[i].record = (void *)flowRecord;
-            flowRecord = flowRecord->next;
+        uint64_t index = 0;
+        for (uint32_t i = 0; i < numFlowLists; i++) {
+            for (size_t j = 0; j < FlowList[i].NumRecords; j++) {
+                list[index].record = (void *)&(FlowList[i].records[j]);
+                list[index].count = FlowList[i].records[j].flowCount;
+                index++;
+            }
         }
+        // restore the input order of the flows of the filter workers
+        if (numLists > 1) blocksort(list, listSize);
         *size = listSize;
     }
 
@@ -1883,7 +2122,7 @@ void PrintFlowStat(RecordPrinter_t print_record, outputParams_t *outputParams) {
                 SortList[i].count = order_mode[order_index].record_function(r);
             }
 
-            blocksort(SortList, maxindex);
+            blocksort_topn(SortList, maxindex, outputParams->topN, PrintDirection);
 
             if (!outputParams->quiet) {
                 if (outputParams->mode == MODE_FMT) {
@@ -1917,7 +2156,10 @@ void PrintFlowTable(RecordPrinter_t print_record, outputParams_t *outputParams,
             SortList[i].count = order_mode[PrintOrder].record_function(r);
         }
 
-        blocksort(SortList, maxindex);
+        if (outputParams->topN > 0)
+            blocksort_topn(SortList, maxindex, outputParams->topN, PrintDirection);
+        else
+            blocksort_radix(SortList, maxindex);
 
         PrintSortList(SortList, maxindex, outputParams, GuessDir, print_record, PrintDirection);
     } else {
@@ -1943,7 +2185,7 @@ int ExportFlowTable(nffile_t *nffile, int aggregate, int bidir, int GuessDir) {
             SortList[i].count = order_mode[PrintOrder].record_function(r);
         }
 
-        blocksort(SortList, maxindex);
+        blocksort_radix(SortList, maxindex);
     }
     ExportSortList(SortList, maxindex, nffile, GuessDir, PrintDirection);
     free(SortList);
@@ -137,8 +137,18 @@ int SetRecordStat(char *statType, char *optOrder);
 
 void InsertFlow(recordHandle_t *recordHandle);
 
+int SetFlowListWorkers(uint32_t numWorkers);
+
+void InsertFlowWorker(uint32_t worker, recordHandle_t *recordHandle);
+
 void AddFlowCache(recordHandle_t *recordHandle);
 
+int SetFlowCacheWorkers(uint32_t numWorkers);
+
+void AddFlowCacheWorker(uint32_t worker, recordHandle_t *recordHandle);
+
+void MergeFlowCache(void);
+
 void PrintFlowTable(RecordPrinter_t print_record, outputParams_t *outputParams, int GuessDir);
 
 void PrintFlowStat(RecordPrinter_t print_record, outputParams_t *outputParams);
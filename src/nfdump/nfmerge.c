@@ -0,0 +1,407 @@
+/*
+ *  Copyright (c) 2025, Peter Haag
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *   * Neither the name of the author nor the names of its contributors may be
+ *     used to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "nfmerge.h"
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+#include "nfdump.h"
+#include "nffileV2.h"
+#include "nfxV3.h"
+#include "util.h"
+
+typedef struct slotEntry_s {
+    char *path;    // full path of the file
+    char *name;    // file name without directory
+    uint32_t seq;  // position in the file list
+} slotEntry_t;
+
+static char *BaseName(char *path) {
+    char *p = strrchr(path, '/');
+    return p ? p + 1 : path;
+
+}  // End of BaseName
+
+static int CompareSlot(const void *p1, const void *p2) {
+    const slotEntry_t *e1 = (const slotEntry_t *)p1;
+    const slotEntry_t *e2 = (const slotEntry_t *)p2;
+
+    int ret = strcmp(e1->name, e2->name);
+    if (ret) return ret;
+    return e1->seq < e2->seq ? -1 : e1->seq > e2->seq;
+
+}  // End of CompareSlot
+
+// collect all files from the file list and order them by time slot. The file names
+// contain the time slot, so files with the same name in different sources belong to
+// the same slot and are kept in the order of the sources
+char **GetMergeSlots(queue_t *fileList, uint32_t *numFiles) {
+    slotEntry_t *entries = NULL;
+    uint32_t num = 0;
+    uint32_t max = 0;
+
+    char *path;
+    while ((path = queue_pop(fileList)) != QUEUE_CLOSED) {
+        if (num == max) {
+            max += 256;
+            slotEntry_t *tmp = realloc(entries, max * sizeof(slotEntry_t));
+            if (!tmp) {
+                LogError("realloc() error in %s line %d: %s", __FILE__, __LINE__, strerror(errno));
+                free(path);
+                break;
+            }
+            entries = tmp;
+        }
+        entries[num].path = path;
+        entries[num].name = BaseName(path);
+        entries[num].seq = num;
+        num++;
+    }
+
+    *numFiles = 0;
+    if (num == 0) {
+        free(entries);
+        return NULL;
+    }
+
+    char **slotList = malloc(num * sizeof(char *));
+    if (!slotList) {
+        LogError("malloc() error in %s line %d: %s", __FILE__, __LINE__, strerror(errno));
+        for (uint32_t i = 0; i < num; i++) free(entries[i].path);
+        free(entries);
+        return NULL;
+    }
+
+    qsort(entries, num, sizeof(slotEntry_t), CompareSlot);
+    for (uint32_t i = 0; i < num; i++) slotList[i] = entries[i].path;
+    free(entries);
+
+    *numFiles = num;
+    return slotList;
+
+}  // End of GetMergeSlots
+
+// return the number of files at the beginning of fileList, which belong to the same time slot
+uint32_t SlotSize(char **fileList, uint32_t numFiles) {
+    if (numFiles == 0) return 0;
+
+    char *name = BaseName(fileList[0]);
+    uint32_t num = 1;
+    while (num < numFiles && strcmp(BaseName(fileList[num]), name) == 0) num++;
+    return num;
+
+}  // End of SlotSize
+
+// merge key of a record - msecFirst of a flow record or the event time, if msecFirst
+// is missing. Same as the block summary. All other records get key 0, so exporter and
+// sampler records are passed before the flows of the same source
+static uint64_t RecordKey(recordHeader_t *record) {
+    if (record->type != V3Record) return 0;
+
+    recordHeaderV3_t *recordHeaderV3 = (recordHeaderV3_t *)record;
+    void *eor = (void *)recordHeaderV3 + recordHeaderV3->size;
+    EXgenericFlow_t *genericFlow = NULL;
+    uint64_t msecEvent = 0;
+
+    elementHeader_t *elementHeader = (elementHeader_t *)((void *)recordHeaderV3 + sizeof(recordHeaderV3_t));
+    for (int i = 0; i < recordHeaderV3->numElements; i++) {
+        if (elementHeader->length == 0 || ((void *)elementHeader + elementHeader->length) > eor) break;
+        void *data = (void *)elementHeader + sizeof(elementHeader_t);
+        switch (elementHeader->type) {
+            case EXgenericFlowID:
+                genericFlow = (EXgenericFlow_t *)data;
+                break;
+            case EXnselCommonID:
+                msecEvent = ((EXnselCommon_t *)data)->msecEvent;
+                break;
+            case EXnatCommonID:
+                if (msecEvent == 0) msecEvent = ((EXnatCommon_t *)data)->msecEvent;
+                break;
+        }
+        elementHeader = (elementHeader_t *)((void *)elementHeader + elementHeader->length);
+    }
+
+    if (genericFlow == NULL) return 0;
+    return genericFlow->msecFirst ? genericFlow->msecFirst : msecEvent;
+
+}  // End of RecordKey
+
+// return 1, if the time range of the block is known from the block directory
+static int BlockTimeKnown(blockInfo_t *blockInfo) {
+    return (blockInfo->flags & BLOCKINFO_META) == 0 && blockInfo->msecFirst <= blockInfo->msecLast;
+
+}  // End of BlockTimeKnown
+
+// merge key of the next block of a source, which is not yet loaded. Blocks without
+// known time range get key 0, so they are loaded next to get the key of their records
+static uint64_t BlockKey(mergeSource_t *source) {
+    blockInfo_t *blockInfo = &source->nffile->blockInfo[source->nextBlock];
+    return BlockTimeKnown(blockInfo) ? blockInfo->msecFirst : 0;
+
+}  // End of BlockKey
+
+// heap order by key. Equal keys are ordered by source
+static inline int Less(mergeReader_t *mergeReader, uint32_t a, uint32_t b) {
+    uint64_t keyA = mergeReader->source[a].key;
+    uint64_t keyB = mergeReader->source[b].key;
+    return keyA < keyB || (keyA == keyB && a < b);
+
+}  // End of Less
+
+static void SiftDown(mergeReader_t *mergeReader, uint32_t i) {
+    uint32_t *heap = mergeReader->heap;
+    uint32_t heapSize = mergeReader->heapSize;
+
+    while (1) {
+        uint32_t child = 2 * i + 1;
+        if (child >= heapSize) break;
+        if ((child + 1) < heapSize && Less(mergeReader, heap[child + 1], heap[child])) child++;
+        if (!Less(mergeReader, heap[child], heap[i])) break;
+        uint32_t tmp = heap[i];
+        heap[i] = heap[child];
+        heap[child] = tmp;
+        i = child;
+    }
+
+}  // End of SiftDown
+
+// smallest key of all sources but the top of the heap
+static uint64_t SecondKey(mergeReader_t *mergeReader) {
+    if (mergeReader->heapSize < 2) return UINT64_MAX;
+
+    uint64_t key = mergeReader->source[mergeReader->heap[1]].key;
+    if (mergeReader->heapSize > 2 && mergeReader->source[mergeReader->heap[2]].key < key) key = mergeReader->source[mergeReader->heap[2]].key;
+    return key;
+
+}  // End of SecondKey
+
+// continue the top source of the heap with its next block or remove it from the heap,
+// if all blocks are processed
+static void NextSourceBlock(mergeReader_t *mergeReader) {
+    mergeSource_t *source = &mergeReader->source[mergeReader->heap[0]];
+
+    if (source->nextBlock < source->numBlocks) {
+        source->key = BlockKey(source);
+    } else {
+        mergeReader->heapSize--;
+        mergeReader->heap[0] = mergeReader->heap[mergeReader->heapSize];
+    }
+    SiftDown(mergeReader, 0);
+
+}  // End of NextSourceBlock
+
+static int IdentEqual(char *ident1, char *ident2) {
+    if (ident1 == NULL || ident2 == NULL) return ident1 == ident2;
+    return strcmp(ident1, ident2) == 0;
+
+}  // End of IdentEqual
+
+static dataBlock_t *FlushMerged(mergeReader_t *mergeReader, char **ident) {
+    dataBlock_t *dataBlock = mergeReader->dataBlock;
+    mergeReader->dataBlock = NULL;
+    mergeReader->mergedBlocks++;
+    *ident = mergeReader->ident;
+    return dataBlock;
+
+}  // End of FlushMerged
+
+// open all files of a time slot for the merge. Files, which can not be opened, are skipped
+mergeReader_t *OpenMergeReader(char **fileList, uint32_t numFiles) {
+    mergeReader_t *mergeReader = calloc(1, sizeof(mergeReader_t));
+    if (!mergeReader) {
+        LogError("calloc() error in %s line %d: %s", __FILE__, __LINE__, strerror(errno));
+        return NULL;
+    }
+
+    mergeReader->source = calloc(numFiles, sizeof(mergeSource_t));
+    mergeReader->heap = calloc(numFiles, sizeof(uint32_t));
+    if (!mergeReader->source || !mergeReader->heap) {
+        LogError("calloc() error in %s line %d: %s", __FILE__, __LINE__, strerror(errno));
+        CloseMergeReader(mergeReader);
+        return NULL;
+    }
+
+    mergeReader->msecFirst = 0x7fffffffffffffffLL;
+    mergeReader->msecLast = 0;
+    for (uint32_t i = 0; i < numFiles; i++) {
+        nffile_t *nffile = OpenFileBlocks(fileList[i], NULL);
+        if (!nffile) continue;
+
+        if (nffile->stat_record->firstseen < mergeReader->msecFirst) mergeReader->msecFirst = nffile->stat_record->firstseen;
+        if (nffile->stat_record->lastseen > mergeReader->msecLast) mergeReader->msecLast = nffile->stat_record->lastseen;
+
+        uint32_t index = mergeReader->numSources++;
+        mergeSource_t *source = &mergeReader->source[index];
+        source->nffile = nffile;
+        source->numBlocks = NumDataBlocks(nffile);
+        if (source->numBlocks) {
+            source->key = BlockKey(source);
+            mergeReader->heap[mergeReader->heapSize++] = index;
+        }
+    }
+
+    for (int i = (int)mergeReader->heapSize / 2 - 1; i >= 0; i--) SiftDown(mergeReader, i);
+
+    return mergeReader;
+
+}  // End of OpenMergeReader
+
+// return the next data block in time order. This is either a block of a source passed
+// through unchanged or a block of merged records. ident is set to the ident of the records
+// and remains valid until CloseMergeReader(). Returns NULL, if all sources are processed
+dataBlock_t *ReadMergedBlock(mergeReader_t *mergeReader, char **ident) {
+    while (mergeReader->heapSize) {
+        mergeSource_t *source = &mergeReader->source[mergeReader->heap[0]];
+        nffile_t *nffile = source->nffile;
+
+        if (source->dataBlock == NULL) {
+            // next block of this source is not yet loaded
+            if (SkipBlock(nffile, source->nextBlock)) {
+                mergeReader->skippedBlocks++;
+                source->nextBlock++;
+                NextSourceBlock(mergeReader);
+                continue;
+            }
+
+            // the whole block ends before the next record of any other source
+            blockInfo_t *blockInfo = &nffile->blockInfo[source->nextBlock];
+            int passBlock = BlockTimeKnown(blockInfo) && blockInfo->msecLast <= SecondKey(mergeReader);
+            if (passBlock && mergeReader->dataBlock) return FlushMerged(mergeReader, ident);
+
+            dataBlock_t *dataBlock = ReadBlockAt(nffile, source->nextBlock++);
+            if (dataBlock == NULL) {
+                // error already logged - continue with next block
+                NextSourceBlock(mergeReader);
+                continue;
+            }
+
+            if (passBlock || dataBlock->type != DATA_BLOCK_TYPE_3) {
+                // other block types are passed in file order
+                if (mergeReader->dataBlock) {
+                    source->dataBlock = dataBlock;
+                    source->numRecords = 0;
+                    return FlushMerged(mergeReader, ident);
+                }
+                NextSourceBlock(mergeReader);
+                mergeReader->passedBlocks++;
+                *ident = nffile->ident;
+                return dataBlock;
+            }
+
+            source->dataBlock = dataBlock;
+            source->record = (recordHeader_t *)GetCursor(dataBlock);
+            source->numRecords = dataBlock->NumRecords;
+            source->key = RecordKey(source->record);
+            SiftDown(mergeReader, 0);
+            continue;
+        }
+
+        if (source->numRecords == 0) {
+            // pending block, which must be passed after the merged records
+            dataBlock_t *dataBlock = source->dataBlock;
+            source->dataBlock = NULL;
+            NextSourceBlock(mergeReader);
+            mergeReader->passedBlocks++;
+            *ident = nffile->ident;
+            return dataBlock;
+        }
+
+        // records of different idents go into different blocks
+        if (mergeReader->dataBlock && !IdentEqual(mergeReader->ident, nffile->ident)) return FlushMerged(mergeReader, ident);
+
+        if (mergeReader->dataBlock == NULL) {
+            mergeReader->dataBlock = NewDataBlock();
+            if (!mergeReader->dataBlock) return NULL;
+            mergeReader->ident = nffile->ident;
+        }
+        dataBlock_t *dataBlock = mergeReader->dataBlock;
+
+        // copy the run of records, which precede the next record of any other source
+        void *eob = GetCursor(source->dataBlock) + source->dataBlock->size;
+        uint64_t secondKey = SecondKey(mergeReader);
+        int full = 0;
+        do {
+            recordHeader_t *record = source->record;
+            if (record->size < sizeof(recordHeader_t) || ((void *)record + record->size) > eob) {
+                LogError("Corrupt data file %s: Inconsistent block size in %s line %d", nffile->fileName, __FILE__, __LINE__);
+                source->numRecords = 0;
+                break;
+            }
+            if (!IsAvailable(dataBlock, record->size)) {
+                full = 1;
+                break;
+            }
+            memcpy(GetCurrentCursor(dataBlock), (void *)record, record->size);
+            dataBlock->size += record->size;
+            dataBlock->NumRecords++;
+
+            source->record = (recordHeader_t *)((void *)record + record->size);
+            source->numRecords--;
+            if (source->numRecords) source->key = RecordKey(source->record);
+        } while (source->numRecords && source->key <= secondKey);
+
+        if (source->numRecords == 0) {
+            FreeDataBlock(source->dataBlock);
+            source->dataBlock = NULL;
+            NextSourceBlock(mergeReader);
+        } else {
+            SiftDown(mergeReader, 0);
+        }
+
+        if (full) return FlushMerged(mergeReader, ident);
+    }
+
+    // all sources done
+    if (mergeReader->dataBlock) return FlushMerged(mergeReader, ident);
+    return NULL;
+
+}  // End of ReadMergedBlock
+
+void CloseMergeReader(mergeReader_t *mergeReader) {
+    if (!mergeReader) return;
+
+    if (mergeReader->source) {
+        for (uint32_t i = 0; i < mergeReader->numSources; i++) {
+            mergeSource_t *source = &mergeReader->source[i];
+            if (source->dataBlock) FreeDataBlock(source->dataBlock);
+            DisposeFile(source->nffile);
+        }
+        free(mergeReader->source);
+    }
+    if (mergeReader->dataBlock) FreeDataBlock(mergeReader->dataBlock);
+    if (mergeReader->heap) free(mergeReader->heap);
+    free(mergeReader);
+
+}  // End of CloseMergeReader
@@ -0,0 +1,82 @@
+/*
+ *  Copyright (c) 2025, Peter Haag
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *   * Neither the name of the author nor the names of its contributors may be
+ *     used to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef _NFMERGE_H
+#define _NFMERGE_H 1
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "nffile.h"
+#include "queue.h"
+
+/*
+ * Time ordered merge of multiple sources -M
+ * The files of all sources for the same time slot are opened in parallel and their
+ * records are merged by msecFirst using a min heap of the sources. Blocks, which end
+ * before the next record of any other source, are passed through unchanged. At most
+ * one data block per source plus the output block is held in memory.
+ */
+
+typedef struct mergeSource_s {
+    nffile_t *nffile;
+    uint32_t nextBlock;      // next block to read from the file
+    uint32_t numBlocks;      // number of blocks in the file
+    dataBlock_t *dataBlock;  // current data block - NULL, if not yet loaded
+    recordHeader_t *record;  // next record in the current data block
+    uint32_t numRecords;     // records left in the current data block
+    uint64_t key;            // merge key - msecFirst of next record or block
+} mergeSource_t;
+
+typedef struct mergeReader_s {
+    uint32_t numSources;
+    mergeSource_t *source;
+    uint32_t *heap;  // min heap of source index
+    uint32_t heapSize;
+    dataBlock_t *dataBlock;  // merged output block
+    char *ident;             // ident of the records in the output block
+    uint64_t msecFirst;      // time window of all files
+    uint64_t msecLast;
+    uint32_t passedBlocks;   // blocks passed through unchanged
+    uint32_t mergedBlocks;   // merged output blocks
+    uint32_t skippedBlocks;  // blocks skipped by the block check
+} mergeReader_t;
+
+char **GetMergeSlots(queue_t *fileList, uint32_t *numFiles);
+
+uint32_t SlotSize(char **fileList, uint32_t numFiles);
+
+mergeReader_t *OpenMergeReader(char **fileList, uint32_t numFiles);
+
+dataBlock_t *ReadMergedBlock(mergeReader_t *mergeReader, char **ident);
+
+void CloseMergeReader(mergeReader_t *mergeReader);
+
+#endif  //_NFMERGE_H
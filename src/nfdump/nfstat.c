@@ -37,6 +37,7 @@
 #include <errno.h>
 #include <inttypes.h>
 #include <netinet/in.h>
+#include <pthread.h>
 #include <signal.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -251,6 +252,7 @@ typedef struct StatRecord {
     uint64_t outBytes;
     uint64_t outPackets;
     uint64_t flows;
+    uint64_t flowCount;  // input record number of the first flow
 } StatRecord_t;
 
 /*
@@ -338,6 +340,11 @@ typedef struct {
 
 static ElementHash_t *ElementHashes[MaxStats] = {0};
 static uint32_t NumStats = 0;  // number of stats in StatRequest
+
+// private element hashes of the filter thread workers for parallel statistics
+// NumStats hashes per worker, merged by MergeElementStat()
+static ElementHash_t **WorkerHashes = NULL;
+static uint32_t NumStatWorkers = 0;
 static int HasGeoDB = 0;
 
 static ElementHash_t *elementHash_init(uint32_t bitSize) {
@@ -814,7 +821,8 @@ static inline void *JA4S_PreProcess(void *inPtr, recordHandle_t *recordHandle) {
 }  // End of JA4S_PreProcess
 #endif
 
-void AddElementStat(recordHandle_t *recordHandle) {
+// update the NumStats element hashes elementHashes with the flow of recordHandle
+static inline void UpdateElementStat(ElementHash_t **elementHashes, recordHandle_t *recordHandle) {
     EXgenericFlow_t *genericFlow = (EXgenericFlow_t *)recordHandle->extensionList[EXgenericFlowID];
     if (!genericFlow) return;
 
@@ -878,7 +886,7 @@ void AddElementStat(recordHandle_t *recordHandle) {
             }
 
             int insert;
-            StatRecord_t *record = elementHash_add(ElementHashes[i], &hashkey, &insert);
+            StatRecord_t *record = elementHash_add(elementHashes[i], &hashkey, &insert);
             if (insert == 0) {
                 record->inBytes += genericFlow->inBytes;
                 record->inPackets += genericFlow->inPackets;
@@ -901,11 +909,130 @@ void AddElementStat(recordHandle_t *recordHandle) {
                 record->msecFirst = genericFlow->msecFirst;
                 record->msecLast = genericFlow->msecLast;
                 record->flows = numFlows;
+                record->flowCount = recordHandle->flowCount;
             }
             index++;
         } while (StatParameters[index].HeaderInfo == NULL);
     }  // for every requested -s stat
-}  // AddElementStat
+}  // End of UpdateElementStat
+
+void AddElementStat(recordHandle_t *recordHandle) {
+    // main thread statistics
+    UpdateElementStat(ElementHashes, recordHandle);
+}  // End of AddElementStat
+
+// parallel statistics - called by the filter thread worker
+void AddElementStatWorker(uint32_t worker, recordHandle_t *recordHandle) {
+    UpdateElementStat(&WorkerHashes[worker * NumStats], recordHandle);
+}  // End of AddElementStatWorker
+
+int SetElementStatWorkers(uint32_t numWorkers) {
+    if (numWorkers == 0 || NumStats == 0) return 0;
+
+    WorkerHashes = (ElementHash_t **)calloc(numWorkers * NumStats, sizeof(ElementHash_t *));
+    if (!WorkerHashes) {
+        LogError("calloc() error in %s line %d: %s", __FILE__, __LINE__, strerror(errno));
+        return 0;
+    }
+
+    NumStatWorkers = numWorkers;
+    for (int i = 0; i < (numWorkers * NumStats); i++) {
+        WorkerHashes[i] = elementHash_init(InitStatHashBits);
+        if (!WorkerHashes[i]) {
+            LogError("calloc() error in %s line %d: %s", __FILE__, __LINE__, strerror(errno));
+            return 0;
+        }
+    }
+
+    return 1;
+
+}  // End of SetElementStatWorkers
+
+/*
+ * merge the worker hashes of a single stat into ElementHashes[stat]
+ * the records are added in order of their first flow in the input, so the final
+ * hash is filled in the same sequence as by the main thread statistics.
+ */
+static void *mergeStatThread(void *arg) {
+    uint32_t stat = (uint32_t)(uintptr_t)arg;
+
+    uint64_t numRecords = 0;
+    for (int i = 0; i < NumStatWorkers; i++) numRecords += WorkerHashes[i * NumStats + stat]->count;
+    if (numRecords == 0) return NULL;
+
+    SortElement_t *list = (SortElement_t *)malloc(numRecords * sizeof(SortElement_t));
+    if (!list) {
+        LogError("malloc() error in %s line %d: %s", __FILE__, __LINE__, strerror(errno));
+        exit(255);
+    }
+
+    uint64_t c = 0;
+    for (int i = 0; i < NumStatWorkers; i++) {
+        ElementHash_t *elementHash = WorkerHashes[i * NumStats + stat];
+        for (uint32_t j = 0; j < elementHash->capacity; j++) {
+            if (elementHash->keys[j].active) {
+                StatRecord_t *record = &(elementHash->records[j]);
+                record->hashkey = &(elementHash->keys[j].key);
+                list[c].record = (void *)record;
+                list[c].count = record->flowCount;
+                c++;
+            }
+        }
+    }
+    if (NumStatWorkers > 1) blocksort(list, numRecords);
+
+    ElementHash_t *elementHash = ElementHashes[stat];
+    for (uint64_t i = 0; i < numRecords; i++) {
+        StatRecord_t *src = (StatRecord_t *)list[i].record;
+        int insert;
+        StatRecord_t *record = elementHash_add(elementHash, src->hashkey, &insert);
+        if (insert) {
+            *record = *src;
+        } else {
+            record->inBytes += src->inBytes;
+            record->inPackets += src->inPackets;
+            record->outBytes += src->outBytes;
+            record->outPackets += src->outPackets;
+            record->flows += src->flows;
+            if (src->msecFirst < record->msecFirst) record->msecFirst = src->msecFirst;
+            if (src->msecLast > record->msecLast) record->msecLast = src->msecLast;
+        }
+    }
+    free(list);
+
+    for (int i = 0; i < NumStatWorkers; i++) {
+        elementHash_free(WorkerHashes[i * NumStats + stat]);
+        WorkerHashes[i * NumStats + stat] = NULL;
+    }
+
+    return NULL;
+
+}  // End of mergeStatThread
+
+// merge the element hashes of all filter thread workers - one thread per stat
+// must be called after all workers are done
+void MergeElementStat(void) {
+    if (!WorkerHashes) return;
+
+    pthread_t tid[MaxStats];
+    for (uint32_t i = 0; i < NumStats; i++) {
+        int err = pthread_create(&tid[i], NULL, mergeStatThread, (void *)(uintptr_t)i);
+        if (err) {
+            LogError("pthread_create() error in %s line %d: %s", __FILE__, __LINE__, strerror(err));
+            exit(255);
+        }
+    }
+    for (uint32_t i = 0; i < NumStats; i++) {
+        if (pthread_join(tid[i], NULL)) {
+            LogError("pthread_join() error in %s line %d: %s", __FILE__, __LINE__, strerror(errno));
+        }
+    }
+
+    free(WorkerHashes);
+    WorkerHashes = NULL;
+    NumStatWorkers = 0;
+
+}  // End of MergeElementStat
 
 static void PrintStatLine(stat_record_t *stat, outputParams_t *outputParams, SortElement_t *element, int type, int order_proto, int inout) {
     char valstr[64];
@@ -1494,7 +1621,8 @@ static SortElement_t *StatTopN(int topN, uint32_t *count, int hash_num, int orde
     *count = numCells;
     dbg_printf("Sort %u flows\n", c);
 
-    if (c > 1) blocksort((SortElement_t *)topN_list, c);
+    // select the topN elements only, if a limit is given
+    blocksort_topn((SortElement_t *)topN_list, c, topN, direction == ASCENDING);
 
     return topN_list;
 
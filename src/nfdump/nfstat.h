@@ -54,6 +54,12 @@ int SetElementStat(char *elementStat, char *orderBy);
 
 void AddElementStat(recordHandle_t *recordHandle);
 
+int SetElementStatWorkers(uint32_t numWorkers);
+
+void AddElementStatWorker(uint32_t worker, recordHandle_t *recordHandle);
+
+void MergeElementStat(void);
+
 void PrintElementStat(stat_record_t *sum_stat, outputParams_t *outputParams, RecordPrinter_t print_record);
 
 #endif  //_NFSTAT_H
@@ -46,6 +46,7 @@
 #include <unistd.h>
 
 #include "bookkeeper.h"
+#include "catalog.h"
 #include "collector.h"
 #include "config.h"
 #include "exporter.h"
@@ -345,6 +346,8 @@ static inline int CloseFlowFile(flowParam_t *flowParam, time_t timestamp) {
         // Update books
         stat(FullName, &fstat);
         UpdateBooks(fs->bookkeeper, timestamp, 512 * fstat.st_blocks);
+        // add file to the directory catalog
+        UpdateCatalog(FullName);
     }
 
     LogInfo("Ident: '%s' Flows: %llu, Packets: %llu, Bytes: %llu", fs->Ident, (unsigned long long)fs->nffile->stat_record->numflows,
@@ -117,13 +117,14 @@ static struct printerFunc_s {
     RecordPrinter_t func_record;  // prints the record
     PrologPrinter_t func_prolog;  // prints the output prolog
     PrologPrinter_t func_epilog;  // prints the output epilog
-} printFuncMap[] = {[MODE_NULL] = {null_record, null_prolog, null_epilog},
-                    [MODE_FMT] = {fmt_record, fmt_prolog, fmt_epilog},
-                    [MODE_RAW] = {raw_record, raw_prolog, raw_epilog},
-                    [MODE_CSV] = {csv_record, csv_prolog, csv_epilog},
-                    [MODE_CSV_FAST] = {csv_record_fast, csv_prolog_fast, csv_epilog_fast},
-                    [MODE_JSON] = {flow_record_to_json, json_prolog, json_epilog},
-                    [MODE_NDJSON] = {flow_record_to_ndjson, ndjson_prolog, ndjson_epilog}};
+    bool parallel;                // records may be printed by several threads
+} printFuncMap[] = {[MODE_NULL] = {null_record, null_prolog, null_epilog, false},
+                    [MODE_FMT] = {fmt_record, fmt_prolog, fmt_epilog, true},
+                    [MODE_RAW] = {raw_record, raw_prolog, raw_epilog, false},
+                    [MODE_CSV] = {csv_record, csv_prolog, csv_epilog, true},
+                    [MODE_CSV_FAST] = {csv_record_fast, csv_prolog_fast, csv_epilog_fast, true},
+                    [MODE_JSON] = {flow_record_to_json, json_prolog, json_epilog, true},
+                    [MODE_NDJSON] = {flow_record_to_ndjson, ndjson_prolog, ndjson_epilog, true}};
 
 static PrologPrinter_t print_prolog;  // prints the output prolog
 static PrologPrinter_t print_epilog;  // prints the output epilog
@@ -277,6 +278,7 @@ RecordPrinter_t SetupOutputMode(char *print_format, outputParams_t *outputParams
                     print_record = printFuncMap[outputParams->mode].func_record;
                     print_prolog = printFuncMap[outputParams->mode].func_prolog;
                     print_epilog = printFuncMap[outputParams->mode].func_epilog;
+                    outputParams->parallel = printFuncMap[outputParams->mode].parallel;
                 }
 
                 break;
@@ -294,6 +296,7 @@ RecordPrinter_t SetupOutputMode(char *print_format, outputParams_t *outputParams
         print_prolog = fmt_prolog;
         print_epilog = fmt_epilog;
         outputParams->mode = MODE_FMT;
+        outputParams->parallel = ParallelFMTOutput();
     }
 
     if (csvFormat) {
@@ -302,6 +305,7 @@ RecordPrinter_t SetupOutputMode(char *print_format, outputParams_t *outputParams
         print_prolog = csv_prolog;
         print_epilog = csv_epilog;
         outputParams->mode = MODE_CSV;
+        outputParams->parallel = ParallelCSVOutput();
     }
 
     return print_record;
@@ -44,10 +44,12 @@ typedef struct outputParams_s {
     bool quiet;
     bool hasGeoDB;
     bool hasTorDB;
+    bool parallel;  // records may be printed by several threads
     outputMode_t mode;
     int topN;
     char *ident;
     void *postFilter;
+    uint32_t recordCount;  // number of printed records
 } outputParams_t;
 
 typedef void (*RecordPrinter_t)(FILE *, recordHandle_t *, outputParams_t *);
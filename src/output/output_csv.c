@@ -87,7 +87,8 @@ typedef char *(*string_function_t)(char *, recordHandle_t *);
 #define STREAMLEN(ptr)                                \
     ((ptrdiff_t)STREAMBUFFSIZE - (ptr - streamBuff)); \
     assert((ptr - streamBuff) < STREAMBUFFSIZE)
-static char *streamBuff = NULL;
+// per thread output buffer - records may be printed by several threads
+static _Thread_local char streamBuff[STREAMBUFFSIZE];
 
 static struct token_list_s {
     string_function_t string_function;  // function printing result to stream
@@ -100,14 +101,14 @@ static int token_index = 0;
 
 static int max_format_index = 0;
 
-static double duration = 0;
+static _Thread_local double duration = 0;
 
 #define IP_STRING_LEN (INET6_ADDRSTRLEN)
 
 #define STRINGSIZE 10240
 static char header_string[STRINGSIZE] = {'\0'};
 
-static char *ident = NULL;
+static _Thread_local char *ident = NULL;
 
 /* prototypes */
 static char *ICMP_Port_decode(EXgenericFlow_t *genericFlow);
@@ -659,20 +660,12 @@ void csv_record(FILE *stream, recordHandle_t *recordHandle, outputParams_t *outp
 }  // End of csv_record
 
 void csv_prolog(outputParams_t *outputParam) {
-    streamBuff = malloc(STREAMBUFFSIZE);
-    if (!streamBuff) {
-        LogError("malloc() error in %s line %d: %s", __FILE__, __LINE__, strerror(errno));
-        exit(EXIT_FAILURE);
-    }
-    streamBuff[0] = '\0';
-
     // header
     printf("%s\n", header_string);
 }  // End of csv_prolog
 
 void csv_epilog(outputParams_t *outputParam) {
-    free(streamBuff);
-    streamBuff = NULL;
+    // empty epilog
 }  // End of csv_epilog
 
 static void InitFormatParser(void) {
@@ -691,7 +684,7 @@ static inline uint32_t ApplyV4NetMaskBits(uint32_t ip, uint32_t maskBits) {
 }  // End of ApplyV4NetMaskBits
 
 static inline uint64_t *ApplyV6NetMaskBits(uint64_t *ip, uint32_t maskBits) {
-    static uint64_t net[2];
+    static _Thread_local uint64_t net[2];
     uint64_t mask;
     if (maskBits > 64) {
         mask = 0xffffffffffffffffLL << (128 - maskBits);
@@ -790,9 +783,21 @@ int ParseCSVOutputFormat(char *format) {
 
 }  // End of ParseOutputFormat
 
+// returns true, if the records of the parsed format may be printed by several threads.
+// nbar, interface and vrf names are collected by the main thread while processing the records.
+int ParallelCSVOutput(void) {
+    for (int i = 0; i < token_index; i++) {
+        string_function_t func = token_list[i].string_function;
+        if (func == String_nbarName || func == String_InputName || func == String_OutputName || func == String_ivrfName ||
+            func == String_evrfName)
+            return 0;
+    }
+    return 1;
+}  // End of ParallelCSVOutput
+
 static char *ICMP_Port_decode(EXgenericFlow_t *genericFlow) {
 #define ICMPSTRLEN 16
-    static char icmpString[ICMPSTRLEN];
+    static _Thread_local char icmpString[ICMPSTRLEN];
     icmpString[0] = '\0';
 
     if (genericFlow == NULL) return "0";
@@ -1263,9 +1268,10 @@ static char *String_EventTime(char *streamPtr, recordHandle_t *recordHandle) {
 
     if (msecEvent) {
         time_t tt = msecEvent / 1000LL;
-        struct tm *ts = localtime(&tt);
+        struct tm ts;
+        localtime_r(&tt, &ts);
         char s[128];
-        strftime(s, 128, "%Y-%m-%d %H:%M:%S", ts);
+        strftime(s, 128, "%Y-%m-%d %H:%M:%S", &ts);
         s[127] = '\0';
         ptrdiff_t lenStream = STREAMLEN(streamPtr);
         size_t len = snprintf(streamPtr, lenStream, "%s.%03llu", s, msecEvent % 1000LL);
@@ -38,6 +38,8 @@
 
 int ParseCSVOutputFormat(char *format);
 
+int ParallelCSVOutput(void);
+
 void csv_prolog(outputParams_t *outputParam);
 
 void csv_epilog(outputParams_t *outputParam);
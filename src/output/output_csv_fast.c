@@ -48,9 +48,6 @@
 
 #define IP_STRING_LEN (INET6_ADDRSTRLEN)
 
-// record counter
-static uint32_t recordCount;
-
 #include "itoa.c"
 
 #define AddString(s)               \
@@ -74,24 +71,17 @@ static uint32_t recordCount;
     } while (0)
 
 #define STREAMBUFFSIZE 1014
-static char *streamBuff = NULL;
+// per thread output buffer - records may be printed by several threads
+static _Thread_local char streamBuff[STREAMBUFFSIZE];
 
 void csv_prolog_fast(outputParams_t *outputParam) {
-    // empty prolog
-    recordCount = 0;
-    streamBuff = malloc(STREAMBUFFSIZE);
-    if (!streamBuff) {
-        LogError("malloc() error in %s line %d: %s", __FILE__, __LINE__, strerror(errno));
-        exit(EXIT_FAILURE);
-    }
-    streamBuff[0] = '\0';
+    // reset record counter
+    outputParam->recordCount = 0;
     printf("cnt,af,firstSeen,lastSeen,proto,srcAddr,srcPort,dstAddr,dstPort,srcAS,dstAS,input,output,flags,srcTos,packets,bytes\n");
 }  // End of csv_prolog_fast
 
 void csv_epilog_fast(outputParams_t *outputParam) {
     // empty epilog
-    free(streamBuff);
-    streamBuff = NULL;
 }  // End of csv_epilog_fast
 
 void csv_record_fast(FILE *stream, recordHandle_t *recordHandle, outputParams_t *outputParam) {
@@ -115,6 +105,7 @@ void csv_record_fast(FILE *stream, recordHandle_t *recordHandle, outputParams_t
 
     int af = 0;
     char sa[IP_STRING_LEN], da[IP_STRING_LEN];
+    sa[0] = da[0] = '\0';
     if (ipv4Flow) {
         af = PF_INET;
         uint32_t src = htonl(ipv4Flow->srcAddr);
@@ -136,7 +127,7 @@ void csv_record_fast(FILE *stream, recordHandle_t *recordHandle, outputParams_t
         inet_ntop(AF_INET6, &dst, da, sizeof(da));
     }
 
-    AddU32(++recordCount);
+    AddU32(++outputParam->recordCount);
     AddU32(af);
     AddU64(genericFlow->msecFirst);
     AddU64(genericFlow->msecLast);
@@ -75,15 +75,16 @@ static int max_format_index = 0;
 
 static int long_v6 = 0;
 static int printPlain = 0;
-static uint64_t duration = 0;
+// per record state - records may be printed by several threads
+static _Thread_local uint64_t duration = 0;
 
 #define IP_STRING_LEN (INET6_ADDRSTRLEN)
 
 #define STRINGSIZE 10240
 static char header_string[STRINGSIZE] = {'\0'};
 
-static char *ident = NULL;
-static char tag_string[2] = {'\0'};
+static _Thread_local char *ident = NULL;
+static _Thread_local char tag_string[2] = {'\0'};
 
 /* prototypes */
 static char *ICMP_Port_decode(EXgenericFlow_t *genericFlow);
@@ -724,7 +725,7 @@ static inline uint32_t ApplyV4NetMaskBits(uint32_t ip, uint32_t maskBits) {
 }  // End of ApplyV4NetMaskBits
 
 static inline uint64_t *ApplyV6NetMaskBits(uint64_t *ip, uint32_t maskBits) {
-    static uint64_t net[2];
+    static _Thread_local uint64_t net[2];
     uint64_t mask;
     if (maskBits > 64) {
         mask = 0xffffffffffffffffLL << (128 - maskBits);
@@ -838,9 +839,21 @@ int ParseFMTOutputFormat(char *format, int plain_numbers) {
 
 }  // End of ParseOutputFormat
 
+// returns true, if the records of the parsed format may be printed by several threads.
+// nbar, interface and vrf names are collected by the main thread while processing the records.
+int ParallelFMTOutput(void) {
+    for (int i = 0; i < token_index; i++) {
+        string_function_t func = token_list[i].string_function;
+        if (func == String_nbarName || func == String_InputName || func == String_OutputName || func == String_ivrfName ||
+            func == String_evrfName)
+            return 0;
+    }
+    return 1;
+}  // End of ParallelFMTOutput
+
 static char *ICMP_Port_decode(EXgenericFlow_t *genericFlow) {
 #define ICMPSTRLEN 16
-    static char icmpString[ICMPSTRLEN];
+    static _Thread_local char icmpString[ICMPSTRLEN];
     icmpString[0] = '\0';
 
     if (genericFlow == NULL) return "0";
@@ -55,6 +55,8 @@ void CondenseV6(char *s);
 
 int ParseFMTOutputFormat(char *format, int printPlain);
 
+int ParallelFMTOutput(void);
+
 void fmt_record(FILE *stream, recordHandle_t *recordHandle, outputParams_t *outputParam);
 
 #define TAG_CHAR ''
@@ -57,9 +57,6 @@
 
 #define IP_STRING_LEN (INET6_ADDRSTRLEN)
 
-// record counter
-static uint32_t recordCount = 0;
-
 #include "itoa.c"
 
 #define AddElementString(e, s)       \
@@ -118,7 +115,8 @@ static uint32_t recordCount = 0;
 #define STREAMLEN(ptr)                                \
     ((ptrdiff_t)STREAMBUFFSIZE - (ptr - streamBuff)); \
     assert((ptr - streamBuff) < STREAMBUFFSIZE)
-static char *streamBuff = NULL;
+// per thread output buffer - records may be printed by several threads
+static _Thread_local char streamBuff[STREAMBUFFSIZE];
 
 static char *stringEXgenericFlow(char *streamPtr, void *extensionRecord) {
     EXgenericFlow_t *genericFlow = (EXgenericFlow_t *)extensionRecord;
@@ -645,8 +643,9 @@ static char *stringEXnselCommon(char *streamPtr, void *extensionRecord) {
     if (when == 0) {
         strncpy(datestr, "<unknown>", 63);
     } else {
-        struct tm *ts = localtime(&when);
-        strftime(datestr, 63, "%Y-%m-%dT%H:%M:%S", ts);
+        struct tm ts;
+        localtime_r(&when, &ts);
+        strftime(datestr, 63, "%Y-%m-%dT%H:%M:%S", &ts);
     }
 
     AddElementU32("connect_id", nselCommon->connID);
@@ -734,8 +733,9 @@ static char *stringEXnatCommon(char *streamPtr, void *extensionRecord) {
     if (when == 0) {
         strncpy(datestr, "<unknown>", 63);
     } else {
-        struct tm *ts = localtime(&when);
-        strftime(datestr, 63, "%Y-%m-%dT%H:%M:%S", ts);
+        struct tm ts;
+        localtime_r(&when, &ts);
+        strftime(datestr, 63, "%Y-%m-%dT%H:%M:%S", &ts);
     }
 
     AddElementU32("nat_event_id", natCommon->natEvent);
@@ -787,13 +787,6 @@ static char *stringEXnokiaNatString(char *streamPtr, void *extensionRecord) {
 }  // End of String_natString
 
 void json_prolog(outputParams_t *outputParam) {
-    streamBuff = malloc(STREAMBUFFSIZE);
-    if (!streamBuff) {
-        LogError("malloc() error in %s line %d: %s", __FILE__, __LINE__, strerror(errno));
-        exit(EXIT_FAILURE);
-    }
-    streamBuff[0] = '\0';
-
     // open json array
     printf("[\n");
 }  // End of json_prolog
@@ -801,8 +794,6 @@ void json_prolog(outputParams_t *outputParam) {
 void json_epilog(outputParams_t *outputParam) {
     // close json array
     printf("\n]\n");
-    free(streamBuff);
-    streamBuff = NULL;
 }  // End of json_epilog
 
 void flow_record_to_json(FILE *stream, recordHandle_t *recordHandle, outputParams_t *outputParam) {
@@ -816,7 +807,7 @@ void flow_record_to_json(FILE *stream, recordHandle_t *recordHandle, outputParam
     streamBuff[0] = '\0';
     char *streamPtr = streamBuff;
 
-    if (recordCount != 0) {
+    if (outputParam->recordCount != 0) {
         *streamPtr++ = ',';
         *streamPtr++ = '\n';
     }
@@ -826,7 +817,7 @@ void flow_record_to_json(FILE *stream, recordHandle_t *recordHandle, outputParam
     *streamPtr++ = '\n';
 
     char *typeString = TestFlag(recordHeaderV3->flags, V3_FLAG_EVENT) ? "EVENT" : "FLOW";
-    AddElementU32("cnt", ++recordCount);
+    AddElementU32("cnt", ++outputParam->recordCount);
     AddElementString("type", typeString);
     if (outputParam->ident != NULL) AddElementString("ident", outputParam->ident);
 
@@ -57,9 +57,6 @@
 
 #define IP_STRING_LEN (INET6_ADDRSTRLEN)
 
-// record counter
-static uint32_t recordCount = 0;
-
 #include "itoa.c"
 
 #define AddElementString(e, s)     \
@@ -106,7 +103,8 @@ static uint32_t recordCount = 0;
 #define STREAMLEN(ptr)                                \
     ((ptrdiff_t)STREAMBUFFSIZE - (ptr - streamBuff)); \
     assert((ptr - streamBuff) < STREAMBUFFSIZE)
-static char *streamBuff = NULL;
+// per thread output buffer - records may be printed by several threads
+static _Thread_local char streamBuff[STREAMBUFFSIZE];
 
 static char *stringEXgenericFlow(char *streamPtr, void *extensionRecord) {
     EXgenericFlow_t *genericFlow = (EXgenericFlow_t *)extensionRecord;
@@ -633,8 +631,9 @@ static char *stringEXnselCommon(char *streamPtr, void *extensionRecord) {
     if (when == 0) {
         strncpy(datestr, "<unknown>", 63);
     } else {
-        struct tm *ts = localtime(&when);
-        strftime(datestr, 63, "%Y-%m-%dT%H:%M:%S", ts);
+        struct tm ts;
+        localtime_r(&when, &ts);
+        strftime(datestr, 63, "%Y-%m-%dT%H:%M:%S", &ts);
     }
 
     AddElementU32("connect_id", nselCommon->connID);
@@ -722,8 +721,9 @@ static char *stringEXnatCommon(char *streamPtr, void *extensionRecord) {
     if (when == 0) {
         strncpy(datestr, "<unknown>", 63);
     } else {
-        struct tm *ts = localtime(&when);
-        strftime(datestr, 63, "%Y-%m-%dT%H:%M:%S", ts);
+        struct tm ts;
+        localtime_r(&when, &ts);
+        strftime(datestr, 63, "%Y-%m-%dT%H:%M:%S", &ts);
     }
 
     AddElementU32("nat_event_id", natCommon->natEvent);
@@ -775,18 +775,11 @@ static char *stringEXnokiaNatString(char *streamPtr, void *extensionRecord) {
 }  // End of String_natString
 
 void ndjson_prolog(outputParams_t *outputParam) {
-    streamBuff = malloc(STREAMBUFFSIZE);
-    if (!streamBuff) {
-        LogError("malloc() error in %s line %d: %s", __FILE__, __LINE__, strerror(errno));
-        exit(EXIT_FAILURE);
-    }
-    streamBuff[0] = '\0';
-
+    // empty prolog
 }  // End of ndjson_prolog
 
 void ndjson_epilog(outputParams_t *outputParam) {
-    free(streamBuff);
-    streamBuff = NULL;
+    // empty epilog
 }  // End of ndjson_epilog
 
 enum { FORMAT_NDJSON = 0, FORMAT_JSON };
@@ -805,7 +798,7 @@ void flow_record_to_ndjson(FILE *stream, recordHandle_t *recordHandle, outputPar
     *streamPtr++ = '{';
 
     char *typeString = TestFlag(recordHeaderV3->flags, V3_FLAG_EVENT) ? "EVENT" : "FLOW";
-    AddElementU32("cnt", ++recordCount);
+    AddElementU32("cnt", ++outputParam->recordCount);
     AddElementString("type", typeString);
     if (outputParam->ident != NULL) AddElementString("ident", outputParam->ident);
 
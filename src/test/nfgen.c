@@ -43,6 +43,7 @@
 #include <time.h>
 #include <unistd.h>
 
+#include "exporter.h"
 #include "nfdump.h"
 #include "nffile.h"
 #include "nfnet.h"
@@ -76,6 +77,8 @@ static void UpdateRecord(recordHandle_t *recordHandle);
 
 static dataBlock_t *StoreRecord(recordHandle_t *recordHandle, nffile_t *nffile, dataBlock_t *dataBlock);
 
+static void WriteLegacyFile(char *filename);
+
 static void DumpRecord(recordHeaderV3_t *recordHeaderV3) {
     printf("V3Record: %u size: %u\n", recordHeaderV3->type, recordHeaderV3->size);
     printf(" Elements    : %u\n", recordHeaderV3->numElements);
@@ -263,6 +266,58 @@ static void RemoveExtension(recordHandle_t *recordHandle, int extID) {
 
 }  // end of RemoveExtension
 
+// write a nfdump 1.6.x layout file with an exporter and a legacy sampler record
+static void WriteLegacyFile(char *filename) {
+    fileHeaderV1_t fileHeader = {0};
+    fileHeader.magic = MAGIC;
+    fileHeader.version = LAYOUT_VERSION_1;
+    fileHeader.flags = FLAG_NOT_COMPRESSED;
+    fileHeader.NumBlocks = 1;
+    strncpy(fileHeader.ident, "TestFlows", IDENTLEN - 1);
+
+    stat_recordV1_t statRecord = {0};
+
+    exporter_info_record_t exporterInfo = {0};
+    exporterInfo.header.type = ExporterInfoRecordType;
+    exporterInfo.header.size = sizeof(exporter_info_record_t);
+    exporterInfo.version = 9;
+    uint32_t ip;
+    inet_pton(PF_INET, "172.16.1.1", &ip);
+    exporterInfo.ip.V4 = ntohl(ip);
+    exporterInfo.sa_family = PF_INET;
+    exporterInfo.sysid = 1;
+    exporterInfo.id = 1;
+
+    samplerV0_record_t sampler = {0};
+    sampler.type = SamplerLegacyRecordType;
+    sampler.size = sizeof(samplerV0_record_t);
+    sampler.id = 1;
+    sampler.interval = 10;
+    sampler.algorithm = 1;
+    sampler.exporter_sysid = 1;
+
+    dataBlock_t dataBlock = {0};
+    dataBlock.NumRecords = 2;
+    dataBlock.size = sizeof(exporter_info_record_t) + sizeof(samplerV0_record_t);
+    dataBlock.type = DATA_BLOCK_TYPE_2;
+
+    int fd = open(filename, O_CREAT | O_TRUNC | O_WRONLY, 0644);
+    if (fd < 0) {
+        perror("open() failed:");
+        exit(255);
+    }
+    if (write(fd, (void *)&fileHeader, sizeof(fileHeader)) != sizeof(fileHeader) ||
+        write(fd, (void *)&statRecord, sizeof(statRecord)) != sizeof(statRecord) ||
+        write(fd, (void *)&dataBlock, sizeof(dataBlock)) != sizeof(dataBlock) ||
+        write(fd, (void *)&exporterInfo, sizeof(exporterInfo)) != sizeof(exporterInfo) ||
+        write(fd, (void *)&sampler, sizeof(sampler)) != sizeof(sampler)) {
+        perror("write() failed:");
+        exit(255);
+    }
+    close(fd);
+
+}  // End of WriteLegacyFile
+
 int main(int argc, char **argv) {
     when = ISO2UNIX(strdup("201907111030"));
 
@@ -600,5 +655,7 @@ int main(int argc, char **argv) {
 
     FlushBlock(nffile, dataBlock);
     CloseUpdateFile(nffile);
+
+    WriteLegacyFile("legacy_flows.nf");
     return 0;
 }
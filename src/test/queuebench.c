@@ -0,0 +1,193 @@
+/*
+ *  Copyright (c) 2024, Peter Haag
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *	 this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright notice,
+ *	 this list of conditions and the following disclaimer in the documentation
+ *	 and/or other materials provided with the distribution.
+ *   * Neither the name of the author nor the names of its contributors may be
+ *	 used to endorse or promote products derived from this software without
+ *	 specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*
+ * queue throughput benchmark
+ * producer threads push numbered elements through a queue_t to consumer threads.
+ * The consumers check, that every element is delivered exactly once.
+ *
+ * queuebench [-p producers] [-c consumers] [-n elements] [-l queue length]
+ */
+
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "queue.h"
+
+typedef struct benchArgs_s {
+    queue_t *queue;
+    uint64_t first;  // first element of a producer
+    uint64_t count;  // elements of a producer
+    uint64_t sum;    // sum of consumed elements
+    uint64_t numPopped;
+} benchArgs_t;
+
+static void *producer(void *arg) {
+    benchArgs_t *benchArgs = (benchArgs_t *)arg;
+
+    for (uint64_t i = benchArgs->first; i < (benchArgs->first + benchArgs->count); i++) {
+        // element 0 would be NULL
+        if (queue_push(benchArgs->queue, (void *)(uintptr_t)(i + 1)) == QUEUE_CLOSED) {
+            fprintf(stderr, "Queue closed while pushing\n");
+            break;
+        }
+    }
+    queue_close(benchArgs->queue);
+
+    return NULL;
+
+}  // End of producer
+
+static void *consumer(void *arg) {
+    benchArgs_t *benchArgs = (benchArgs_t *)arg;
+
+    while (1) {
+        void *data = queue_pop(benchArgs->queue);
+        if (data == QUEUE_CLOSED) break;
+        benchArgs->sum += (uintptr_t)data - 1;
+        benchArgs->numPopped++;
+    }
+
+    return NULL;
+
+}  // End of consumer
+
+static void usage(char *name) {
+    printf(
+        "usage %s [options] \n"
+        "-h\t\tthis text you see right here\n"
+        "-p <num>\tNumber of producer threads. Default 4\n"
+        "-c <num>\tNumber of consumer threads. Default 4\n"
+        "-n <num>\tNumber of elements. Default 1000000\n"
+        "-l <num>\tQueue length, power of 2. Default 32\n",
+        name);
+}  // End of usage
+
+int main(int argc, char **argv) {
+    unsigned numProducers = 4;
+    unsigned numConsumers = 4;
+    uint64_t numElements = 1000000;
+    size_t queueLength = 32;
+
+    int c;
+    while ((c = getopt(argc, argv, "hp:c:n:l:")) != EOF) {
+        switch (c) {
+            case 'h':
+                usage(argv[0]);
+                exit(EXIT_SUCCESS);
+                break;
+            case 'p':
+                numProducers = atoi(optarg);
+                break;
+            case 'c':
+                numConsumers = atoi(optarg);
+                break;
+            case 'n':
+                numElements = strtoull(optarg, NULL, 10);
+                break;
+            case 'l':
+                queueLength = atoi(optarg);
+                break;
+            default:
+                usage(argv[0]);
+                exit(EXIT_FAILURE);
+        }
+    }
+    if (numProducers == 0 || numConsumers == 0 || numProducers > 256 || numConsumers > 256) {
+        fprintf(stderr, "Number of threads out of range 1..256\n");
+        exit(EXIT_FAILURE);
+    }
+
+    queue_t *queue = queue_init(queueLength);
+    if (!queue) exit(EXIT_FAILURE);
+    queue_producers(queue, numProducers);
+
+    benchArgs_t *producerArgs = calloc(numProducers, sizeof(benchArgs_t));
+    benchArgs_t *consumerArgs = calloc(numConsumers, sizeof(benchArgs_t));
+    pthread_t *tid = calloc(numProducers + numConsumers, sizeof(pthread_t));
+    if (!producerArgs || !consumerArgs || !tid) {
+        perror("calloc() failed:");
+        exit(EXIT_FAILURE);
+    }
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (unsigned i = 0; i < numConsumers; i++) {
+        consumerArgs[i].queue = queue;
+        pthread_create(&tid[i], NULL, consumer, (void *)&consumerArgs[i]);
+    }
+    uint64_t first = 0;
+    for (unsigned i = 0; i < numProducers; i++) {
+        producerArgs[i].queue = queue;
+        producerArgs[i].first = first;
+        producerArgs[i].count = numElements / numProducers + (i < (numElements % numProducers) ? 1 : 0);
+        first += producerArgs[i].count;
+        pthread_create(&tid[numConsumers + i], NULL, producer, (void *)&producerArgs[i]);
+    }
+    for (unsigned i = 0; i < (numProducers + numConsumers); i++) {
+        pthread_join(tid[i], NULL);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double duration = (double)(end.tv_sec - start.tv_sec) + (double)(end.tv_nsec - start.tv_nsec) / 1e9;
+
+    uint64_t sum = 0;
+    uint64_t numPopped = 0;
+    for (unsigned i = 0; i < numConsumers; i++) {
+        sum += consumerArgs[i].sum;
+        numPopped += consumerArgs[i].numPopped;
+    }
+
+    printf("producers: %u, consumers: %u, queue length: %zu, elements: %" PRIu64 "\n", numProducers, numConsumers, queueLength, numElements);
+    printf("time: %.3fs, %.0f elements/s\n", duration, duration > 0 ? (double)numPopped / duration : 0.0);
+
+    uint64_t expected = numElements ? numElements * (numElements - 1) / 2 : 0;
+    if (numPopped != numElements || sum != expected) {
+        printf("Error: popped %" PRIu64 " elements, sum: %" PRIu64 ", expected %" PRIu64 " elements, sum: %" PRIu64 "\n", numPopped, sum,
+               numElements, expected);
+        exit(EXIT_FAILURE);
+    }
+
+    queue_free(queue);
+    free(producerArgs);
+    free(consumerArgs);
+    free(tid);
+
+    return 0;
+
+}  // End of main
@@ -67,9 +67,71 @@ $NFDUMP -r test.5.flows.nf -i TestFlows
 $NFDUMP -r test.5.flows.nf -q -o raw >test.5-2.out
 diff -u test.5.out test.5-2.out
 
+# columnar data blocks must read back as the row format records
+$NFDUMP -r dummy_flows.nf -Y -w test.13.flows.nf
+$NFDUMP -v test.13.flows.nf | grep -q 'Type 5 blocks'
+$NFDUMP -r test.13.flows.nf -q -o raw >test.13.out
+diff -u test.13.out nftest.1.out
+$NFDUMP -r test.13.flows.nf -Y -z=lz4 -w test.13-2.flows.nf
+$NFDUMP -r test.13-2.flows.nf -q -o raw >test.13-2.out
+diff -u test.13-2.out nftest.1.out
+
+# a corrupt data block is skipped and reading continues with the next block
+mkdir blockdir
+i=0
+while [ $i -lt 1000 ]; do
+	cp dummy_flows.nf blockdir/nfcapd.$i
+	i=$((i + 1))
+done
+$NFDUMP -R blockdir -w test.14.flows.nf
+rm -rf blockdir
+$NFDUMP -v test.14.flows.nf >test.14-1.out
+grep -q 'Type 3 blocks : 3' test.14-1.out
+# flip a byte in the first data block
+cp test.14.flows.nf test.14-2.flows.nf
+byte=$(od -An -tu1 -j 100000 -N1 test.14-2.flows.nf)
+printf "\\$(printf %o $((byte ^ 255)))" | dd of=test.14-2.flows.nf bs=1 seek=100000 conv=notrunc 2>/dev/null
+$NFDUMP -r test.14-2.flows.nf -q -o 'fmt:%pr' >test.14-2.out 2>test.14-3.out
+grep -q 'Skip corrupt block 0' test.14-3.out
+records=$(wc -l <test.14-2.out)
+[ $records -gt 0 ]
+[ $records -lt 35000 ]
+# the checksum verify must fail on the damaged file
+if $NFDUMP -v test.14-2.flows.nf >test.14-4.out; then
+	echo verify does not detect the corrupt block
+	exit 1
+fi
+grep -q 'Checking data block checksums' test.14-4.out
+grep -q 'Corrupt blocks: 1' test.14-4.out
+
+# the flows aggregated by several workers must match a single worker
+$NFDUMP -r test.14.flows.nf -W 1 -q -A srcip,dstip -O bytes >test.15-1.out
+$NFDUMP -r test.14.flows.nf -W 4 -q -A srcip,dstip -O bytes >test.15-2.out
+diff -u test.15-1.out test.15-2.out
+$NFDUMP -r test.14.flows.nf -W 1 -q -s record/bytes >test.15-3.out
+$NFDUMP -r test.14.flows.nf -W 4 -q -s record/bytes >test.15-4.out
+diff -u test.15-3.out test.15-4.out
+
+# the element statistics of several workers must match a single worker
+$NFDUMP -r test.14.flows.nf -W 1 -q -s srcip/bytes -s dstport >test.16-1.out
+$NFDUMP -r test.14.flows.nf -W 4 -q -s srcip/bytes -s dstport >test.16-2.out
+diff -u test.16-1.out test.16-2.out
+
+# records rendered by several workers must match the records printed by the main thread
+# -c disables rendering in the workers. Interface names are always printed by the main thread
+for format in csv-fast json ndjson 'fmt:%ts %inam %onam %sa %da'; do
+	$NFDUMP -r test.14.flows.nf -W 1 -c 100000 -q -o "$format" >test.17-1.out
+	$NFDUMP -r test.14.flows.nf -W 4 -q -o "$format" >test.17-2.out
+	diff -u test.17-1.out test.17-2.out
+done
+
+# exporter and legacy sampler records of a nfdump 1.6.x file pass the filter workers to the main thread
+$NFDUMP -r legacy_flows.nf -W 4 -q -o raw >test.18-1.out 2>test.18-2.out
+[ ! -s test.18-2.out ]
+
 # create testdir dir for flow replay
 if [ -d testdir ]; then
-	rm -f testdir/*
+	rm -f testdir/* testdir/.nfcatalog
 	rmdir testdir
 fi
 mkdir testdir
@@ -140,6 +202,13 @@ fi
 
 $NFDUMP -X -v testdir/nfcapd.* >/dev/null
 
+# stat info from the directory catalog must match the stat records of the files
+[ -f testdir/.nfcatalog ]
+$NFDUMP -I -R testdir >test.10.out
+rm -f testdir/.nfcatalog
+$NFDUMP -I -R testdir >test.10-2.out
+diff -u test.10.out test.10-2.out
+
 mkdir memck.$$
 # OpenBSD
 export MALLOC_OPTIONS=AFGJS
@@ -158,7 +227,31 @@ $NFDUMP -r dummy_flows.nf -O tstart -w test.8.flows.nf 'host 172.16.2.66'
 ../nfanon/nfanon -K abcdefghijklmnopqrstuvwxyz012345 -r dummy_flows.nf -w test.9.flows.nf
 $NFDUMP -q -r test.9.flows.nf -o raw >test.9.out
 $NFDUMP -r testdir/nfcapd.* -i NewIdent
-rm -f testdir/nfcapd.* test*.out test*.flows.nf dummy_flows.nf
+
+# merge interval files into an hourly file
+mkdir compactdir
+cp dummy_flows.nf compactdir/nfcapd.201907111030
+cp dummy_flows.nf compactdir/nfcapd.201907111035
+$NFDUMP -R compactdir -q -o raw >test.11.out
+../nfcompact/nfcompact -l compactdir -a 0
+[ -f compactdir/nfcapd.201907111000 ]
+[ ! -f compactdir/nfcapd.201907111035 ]
+$NFDUMP -R compactdir -q -o raw >test.11-2.out
+diff -u test.11.out test.11-2.out
+rm -rf compactdir
+
+# time ordered merge of multiple sources
+mkdir -p mergedir/src1 mergedir/src2
+$NFDUMP -r dummy_flows.nf -O tstart -w mergedir/src1/nfcapd.201907111030 'proto tcp'
+$NFDUMP -r dummy_flows.nf -O tstart -w mergedir/src2/nfcapd.201907111030 'not proto tcp'
+$NFDUMP -M mergedir/src1:src2 -R . -q -o 'fmt:%tfs %pr %sa %da %sp %dp' >test.12.out
+sort -c test.12.out
+for src in src1 src2; do
+	$NFDUMP -r mergedir/$src/nfcapd.201907111030 -q -o 'fmt:%tfs %pr %sa %da %sp %dp'
+done | sort >test.12-2.out
+sort test.12.out | diff -u - test.12-2.out
+rm -rf mergedir
+rm -f testdir/nfcapd.* testdir/.nfcatalog test*.out test*.flows.nf dummy_flows.nf legacy_flows.nf
 [ -d testdir ] && rmdir testdir
 [ -d memck.$$ ] && rm -rf memck.$$
 
@@ -0,0 +1,232 @@
+/*
+ *  Copyright (c) 2025, Peter Haag
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *	 this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright notice,
+ *	 this list of conditions and the following disclaimer in the documentation
+ *	 and/or other materials provided with the distribution.
+ *   * Neither the name of the author nor the names of its contributors may be
+ *	 used to endorse or promote products derived from this software without
+ *	 specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*
+ * sort strategy benchmark
+ * sorts arrays of SortElement_t with count distributions as found in flow data
+ * with each of the blocksort strategies and checks the result.
+ *
+ * sortbench [-n elements] [-t topN] [-r rounds]
+ */
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "blocksort.h"
+
+// insertion sort is quadratic - skip it for larger arrays
+#define MAX_INSERT 4096
+
+static uint64_t seed = 0x9E3779B97F4A7C15ULL;
+
+static inline uint64_t xorshift64(void) {
+    seed ^= seed << 13;
+    seed ^= seed >> 7;
+    seed ^= seed << 17;
+    return seed;
+}  // End of xorshift64
+
+// heavy tailed number of packets per flow - half of the flows have 1 packet and
+// each doubling of the number of packets is half as likely
+static inline uint64_t heavyTail(void) {
+    int bits = __builtin_ctzll(xorshift64() | (1ULL << 32));
+    return (1ULL << bits) + (xorshift64() & ((1ULL << bits) - 1));
+}  // End of heavyTail
+
+// packet counts of flows
+static uint64_t genPackets(uint64_t i) { return heavyTail(); }
+
+// byte counts of flows - packets * packet size 40 .. 1500 bytes
+static uint64_t genBytes(uint64_t i) { return heavyTail() * (40 + xorshift64() % 1461); }
+
+// msec first seen time stamps - records in file order, exported up to 5 min out of order
+static uint64_t genTstart(uint64_t i) { return 1562826600000ULL + i / 10 + xorshift64() % 300000; }
+
+// random 64bit keys
+static uint64_t genUniform(uint64_t i) { return xorshift64(); }
+
+typedef struct distribution_s {
+    char *name;
+    uint64_t (*gen)(uint64_t);
+} distribution_t;
+
+static distribution_t distribution[] = {
+    {"packets", genPackets}, {"bytes", genBytes}, {"tstart", genTstart}, {"uniform", genUniform}, {NULL, NULL}};
+
+typedef struct strategy_s {
+    char *name;
+    void (*sort)(SortElement_t *, int);
+} strategy_t;
+
+static strategy_t strategy[] = {{"insert", blocksort_insert},
+                                {"quick", blocksort_quick},
+                                {"radix", blocksort_radix},
+                                {"blocksort", blocksort},
+                                {NULL, NULL}};
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}  // End of now
+
+// check data is sorted and still holds all records 0..len-1 of the original array
+static int checkSorted(SortElement_t *data, SortElement_t *orig, int len) {
+    uint8_t *seen = calloc(len, 1);
+    if (!seen) {
+        perror("calloc() failed:");
+        exit(EXIT_FAILURE);
+    }
+    int ok = 1;
+    for (int i = 0; i < len && ok; i++) {
+        uintptr_t index = (uintptr_t)data[i].record;
+        if (index >= (uintptr_t)len || seen[index] || orig[index].count != data[i].count) ok = 0;
+        if (i && data[i - 1].count > data[i].count) ok = 0;
+        if (ok) seen[index] = 1;
+    }
+    free(seen);
+    return ok;
+}  // End of checkSorted
+
+// check the topN largest elements at the end of data
+static int checkTopN(SortElement_t *data, SortElement_t *sorted, int len, int topN) {
+    if (topN > len) topN = len;
+    for (int i = len - topN; i < len; i++) {
+        if (data[i].count != sorted[i].count) return 0;
+    }
+    return 1;
+}  // End of checkTopN
+
+static void usage(char *name) {
+    printf(
+        "usage %s [options] \n"
+        "-h\t\tthis text you see right here\n"
+        "-n <num>\tNumber of elements. Default 1000000\n"
+        "-t <num>\tTop N for blocksort_topn(). Default 10\n"
+        "-r <num>\tNumber of rounds for each sort. Default 1\n",
+        name);
+}  // End of usage
+
+int main(int argc, char **argv) {
+    int numElements = 1000000;
+    int topN = 10;
+    int rounds = 1;
+
+    int c;
+    while ((c = getopt(argc, argv, "hn:t:r:")) != EOF) {
+        switch (c) {
+            case 'h':
+                usage(argv[0]);
+                exit(EXIT_SUCCESS);
+                break;
+            case 'n':
+                numElements = atoi(optarg);
+                break;
+            case 't':
+                topN = atoi(optarg);
+                break;
+            case 'r':
+                rounds = atoi(optarg);
+                break;
+            default:
+                usage(argv[0]);
+                exit(EXIT_FAILURE);
+        }
+    }
+    if (numElements <= 0 || topN <= 0 || rounds <= 0) {
+        fprintf(stderr, "Number of elements, top N and rounds must be > 0\n");
+        exit(EXIT_FAILURE);
+    }
+
+    SortElement_t *orig = malloc(numElements * sizeof(SortElement_t));
+    SortElement_t *data = malloc(numElements * sizeof(SortElement_t));
+    SortElement_t *sorted = malloc(numElements * sizeof(SortElement_t));
+    if (!orig || !data || !sorted) {
+        perror("malloc() failed:");
+        exit(EXIT_FAILURE);
+    }
+
+    int failed = 0;
+    printf("elements: %d, rounds: %d\n", numElements, rounds);
+    printf("%-10s %-10s %10s %14s\n", "keys", "strategy", "time", "elements/s");
+    for (int d = 0; distribution[d].name != NULL; d++) {
+        for (int i = 0; i < numElements; i++) {
+            orig[i].record = (void *)(uintptr_t)i;
+            orig[i].count = distribution[d].gen(i);
+        }
+
+        for (int s = 0; strategy[s].name != NULL; s++) {
+            if (strategy[s].sort == blocksort_insert && numElements > MAX_INSERT) continue;
+
+            double duration = 0;
+            for (int r = 0; r < rounds; r++) {
+                memcpy(data, orig, numElements * sizeof(SortElement_t));
+                double start = now();
+                strategy[s].sort(data, numElements);
+                duration += now() - start;
+            }
+
+            int ok = checkSorted(data, orig, numElements);
+            if (!ok) failed++;
+            printf("%-10s %-10s %9.3fs %14.0f%s\n", distribution[d].name, strategy[s].name, duration,
+                   duration > 0 ? (double)numElements * rounds / duration : 0.0, ok ? "" : " - not sorted");
+            if (strategy[s].sort == blocksort) memcpy(sorted, data, numElements * sizeof(SortElement_t));
+        }
+
+        double duration = 0;
+        for (int r = 0; r < rounds; r++) {
+            memcpy(data, orig, numElements * sizeof(SortElement_t));
+            double start = now();
+            blocksort_topn(data, numElements, topN, 0);
+            duration += now() - start;
+        }
+
+        int ok = checkTopN(data, sorted, numElements, topN);
+        if (!ok) failed++;
+        printf("%-10s top %-6d %9.3fs %14.0f%s\n", distribution[d].name, topN, duration,
+               duration > 0 ? (double)numElements * rounds / duration : 0.0, ok ? "" : " - wrong top N");
+    }
+
+    free(orig);
+    free(data);
+    free(sorted);
+
+    if (failed) {
+        printf("Error: %d sorts failed\n", failed);
+        exit(EXIT_FAILURE);
+    }
+    return 0;
+
+}  // End of main